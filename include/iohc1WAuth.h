@@ -0,0 +1,120 @@
+#ifndef IOHC_1W_AUTH_H
+#define IOHC_1W_AUTH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcFrame.h>
+#include <iohcKeyCache.h>
+
+// Number of 1W remotes tracked
+#ifndef IOHC_1W_AUTH_SIZE
+    #define IOHC_1W_AUTH_SIZE 16
+#endif
+// MACs precomputed ahead of the last accepted sequence number
+#ifndef IOHC_1W_AUTH_WINDOW
+    #define IOHC_1W_AUTH_WINDOW 4
+#endif
+// Sequence numbers further ahead than this are treated as replays of an old capture
+#ifndef IOHC_1W_MAX_SEQUENCE_JUMP
+    #define IOHC_1W_MAX_SEQUENCE_JUMP 1024
+#endif
+// The snapshot is written once every that many accepted sequence numbers of a remote, a restored remote
+// skips as many so the frames after the last write are not accepted again
+#ifndef IOHC_1W_SEQUENCE_STEP
+    #define IOHC_1W_SEQUENCE_STEP 8
+#endif
+// Max authenticated data (command ID + parameters) of a 1W frame
+#define IOHC_1W_MAX_DATA 21
+
+namespace IOHC {
+    enum class authResult : uint8_t {
+        unknownRemote, // No key learned for this address
+        accepted,      // Verified with a full AES pass
+        fastAccepted,  // Verified against a precomputed MAC
+        repeated,      // Retransmission of the last accepted frame
+        replayed,      // Sequence number not newer than the last accepted one
+        badMac,
+    };
+    const char *authResultName(authResult result);
+
+    // What survives a reboot, see iohcSnapshot
+    struct __attribute__((packed)) iohcRemoteState {
+        uint8_t address[3];
+        uint8_t key[16];
+        uint16_t lastSequence; // Saved mark, accepted ones stay below it + IOHC_1W_SEQUENCE_STEP
+        uint8_t hasSequence;
+    };
+
+    struct iohcRemoteAuth {
+        uint8_t address[3];
+        uint8_t clearKey[16]; // Kept for the snapshot, the schedule is rebuilt from it at boot
+        iohcAesKey key;
+        uint16_t lastSequence = 0;
+        uint16_t savedSequence = 0; // Mark for the snapshot, moved every IOHC_1W_SEQUENCE_STEP
+        bool hasSequence = false;
+        uint8_t lastMac[6];
+        // Look-ahead for the next rolling codes of the last accepted command
+        uint8_t data[IOHC_1W_MAX_DATA];
+        uint8_t dataLen = 0;
+        struct {
+            uint16_t sequence;
+            bool valid;
+            uint8_t mac[6];
+        } window[IOHC_1W_AUTH_WINDOW];
+        bool used = false;
+    };
+
+    /**
+     * Per 1W remote authentication state: expanded key learned from 0x30, last accepted sequence number
+     * and MACs precomputed for the next rolling codes. A remote repeating its last command is verified
+     * with one comparison, retransmissions and replays are sorted out before any AES pass.
+     */
+    class iohc1WAuth {
+    public:
+        static iohc1WAuth *getInstance();
+        virtual ~iohc1WAuth() = default;
+
+        void learn(const uint8_t *address, const uint8_t *key);
+        bool knows(const uint8_t *address) { return find(address) != nullptr; }
+        // data starts at the command ID and ends before the sequence number
+        authResult verify(const uint8_t *address, const uint8_t *sequence, const uint8_t *data, size_t len,
+                          const uint8_t *mac);
+        // Sequence number and MAC taken from the end of the frame, whatever the command length
+        authResult verify(const iohcFrameView &frame) {
+            const iohcBytes data = frame.authenticated();
+            return verify(frame.source(), frame.sequence(), data.data, data.size, frame.mac());
+        }
+        void forget(const uint8_t *address);
+
+        // Copies the remotes out for the snapshot, safe from another task than the dispatch one
+        size_t save(iohcRemoteState *out, size_t room) const;
+        void restore(const iohcRemoteState &state);
+        // Changes with every learned key and every IOHC_1W_SEQUENCE_STEP accepted sequence numbers
+        uint32_t revision() const { return _saved.load(std::memory_order_acquire); }
+
+        uint32_t fastHits() const { return _fastHits; }
+        uint32_t rejected() const { return _rejected; }
+
+    private:
+        iohc1WAuth() = default;
+        static iohc1WAuth *_iohc1WAuth;
+        iohcRemoteAuth *find(const uint8_t *address);
+        static void computeMac(const iohcRemoteAuth &remote, uint16_t sequence, const uint8_t *data, size_t len,
+                               uint8_t *mac);
+        static void refill(iohcRemoteAuth &remote);
+        // Odd while the remotes change, save() copies again when it moved
+        void beginChange() { _revision.fetch_add(1, std::memory_order_acq_rel); }
+        void endChange() { _revision.fetch_add(1, std::memory_order_release); }
+
+        iohcRemoteAuth _remotes[IOHC_1W_AUTH_SIZE];
+        size_t _next = 0; // Round robin replacement once full
+        uint32_t _fastHits = 0;
+        uint32_t _rejected = 0;
+        std::atomic<uint32_t> _revision{0};
+        std::atomic<uint32_t> _saved{0}; // Bumped when the snapshot is out of date
+    };
+}
+
+#endif // IOHC_1W_AUTH_H
@@ -0,0 +1,17 @@
+#ifndef IOHC_BENCH_H
+#define IOHC_BENCH_H
+
+#include <cstdint>
+
+/*
+ * Microbenchmarks, run from the console on the device and by scripts/native/bench.cpp on the host
+ */
+namespace IOHC {
+    // CRC16-KERMIT: bitwise reference vs lookup table vs ROM, over max size frames
+    void crcBench(uint32_t rounds = 10000);
+    // Crypto helpers on the authenticated frames path, checked against scripts/Iown-ioCrypto.py vectors.
+    // Returns false when a result differs from its vector.
+    bool cryptoBench(uint32_t rounds = 1000);
+}
+
+#endif // IOHC_BENCH_H
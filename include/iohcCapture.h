@@ -0,0 +1,107 @@
+#ifndef IOHC_CAPTURE_H
+#define IOHC_CAPTURE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcFrame.h>
+
+/*
+ * Binary capture format for recorded traffic, shared by the packet archive, the native replay harness,
+ * the host decoder and the Python tools (scripts/Iown-Capture.py).
+ *
+ * A capture is a sequence of fixed size blocks: a 96 bytes block header then up to recordsPerBlock
+ * iohcRxRecord of 48 bytes, little endian. Block n starts at n * blockSize, so the file can be mapped and
+ * any block reached directly. The block header is also the index of its records: first and last stamp,
+ * a bitmap of the command IDs and a small bloom filter of the addresses, readers skip the blocks
+ * that cannot match a filter without touching the records.
+ * Blocks are ordered by sequence, not by position: the archive writes them in a circular file.
+ * The last block may be partially filled, it is rewritten in place when more records come.
+ * Stamps count from the boot of the writer and only compare between blocks of the same boot; origin
+ * places them in wall clock time when the writer knew it.
+ */
+namespace IOHC {
+    static constexpr uint32_t captureMagic = 0x50414349; // "ICAP"
+    static constexpr uint8_t captureVersion = 1;
+
+    enum iohcRxFlags : uint8_t {
+        rxCrcError = 0x01, // Kept by the host decoder, the firmware only archives valid frames
+    };
+
+    struct __attribute__((packed)) iohcCaptureBlock {
+        uint32_t magic;
+        uint32_t sequence;    // Increases with every new block, gives the order of a circular file
+        uint16_t count;
+        uint16_t recordSize;
+        uint16_t blockSize;
+        uint8_t version;
+        uint8_t flags;
+        uint64_t firstStamp;  // us, stamps of the records
+        uint64_t lastStamp;
+        uint64_t origin;      // us since the Unix epoch at stamp 0, 0 when unknown (us since boot)
+        uint8_t addresses[16]; // Bloom filter of sources and targets
+        uint8_t commands[32];  // Bitmap of command IDs
+        uint32_t boot;         // Boot count of the writer, a block holds the records of one boot
+        uint8_t reserved[4];
+    };
+    static_assert(sizeof(iohcCaptureBlock) == 96, "Capture block header is fixed size");
+
+    namespace capture {
+        static constexpr size_t recordsPerBlock(size_t blockSize) {
+            return (blockSize - sizeof(iohcCaptureBlock)) / sizeof(iohcRxRecord);
+        }
+
+        inline uint32_t addressHash(const uint8_t *address) {
+            return ((uint32_t(address[0]) << 16) | (uint32_t(address[1]) << 8) | address[2]) * 0x9E3779B1u;
+        }
+
+        inline void addAddress(iohcCaptureBlock &block, const uint8_t *address) {
+            const uint32_t h = addressHash(address);
+            block.addresses[(h >> 25) / 8] |= 1 << ((h >> 25) & 7);
+            block.addresses[((h >> 18) & 0x7F) / 8] |= 1 << ((h >> 18) & 7);
+        }
+
+        // False only when no record of the block has that address as source or target
+        inline bool mayHaveAddress(const iohcCaptureBlock &block, const uint8_t *address) {
+            const uint32_t h = addressHash(address);
+            return (block.addresses[(h >> 25) / 8] & (1 << ((h >> 25) & 7))) &&
+                   (block.addresses[((h >> 18) & 0x7F) / 8] & (1 << ((h >> 18) & 7)));
+        }
+
+        inline bool hasCommand(const iohcCaptureBlock &block, uint8_t cmd) {
+            return block.commands[cmd / 8] & (1 << (cmd % 8));
+        }
+
+        // Empty block header, records are then added with index()
+        inline iohcCaptureBlock block(uint32_t sequence, size_t blockSize, uint64_t origin = 0, uint32_t boot = 0) {
+            iohcCaptureBlock header{};
+            header.magic = captureMagic;
+            header.sequence = sequence;
+            header.recordSize = sizeof(iohcRxRecord);
+            header.blockSize = static_cast<uint16_t>(blockSize);
+            header.version = captureVersion;
+            header.origin = origin;
+            header.boot = boot;
+            return header;
+        }
+
+        inline void index(iohcCaptureBlock &block, const iohcRxRecord &record) {
+            if (!block.count || record.stamp < block.firstStamp) block.firstStamp = record.stamp;
+            if (!block.count || record.stamp > block.lastStamp) block.lastStamp = record.stamp;
+            block.count++;
+            const iohcFrameView frame = record.view();
+            if (record.length < frameHeaderSize) return;
+            block.commands[frame.cmd() / 8] |= 1 << (frame.cmd() % 8);
+            addAddress(block, frame.source());
+            addAddress(block, frame.target());
+        }
+
+        inline bool valid(const iohcCaptureBlock &block, size_t blockSize) {
+            return block.magic == captureMagic && block.version == captureVersion &&
+                   block.recordSize == sizeof(iohcRxRecord) && block.blockSize == blockSize &&
+                   block.count <= recordsPerBlock(blockSize);
+        }
+    }
+}
+
+#endif // IOHC_CAPTURE_H
@@ -0,0 +1,33 @@
+#ifndef IOHC_COMMANDS_H
+#define IOHC_COMMANDS_H
+
+#include <string_view>
+
+#include <iohcPerfectHash.h>
+
+namespace IOHC {
+    /**
+     * Console command names known at build time, hashed by the compiler into consoleCommandHash.
+     * A handler registered under one of these names takes its fixed slot, other names still work
+     * but are looked up one by one. Add new commands here.
+     */
+    static constexpr std::string_view consoleCommandNames[] = {
+        "help",
+        // Cozybox Kizbox Conexoon 2W
+        "powerOn", "setTemp", "setMode", "setPresence", "setWindow", "midnight", "associate", "custom", "custom60",
+        // 1W
+        "pair", "add", "remove", "open", "close", "stop", "vent", "force", "testKey", "mode1", "mode2", "mode3", "mode4",
+        // Other 2W
+        "discovery", "getName",
+        // Utils
+        "dump", "list1W", "save", "nodes", "snapshot", "erase", "archive", "send", "verbose", "trace", "ls", "cat", "rm",
+        "list2W", "discover28", "discover2A", "fake0", "ack", "pairMode", "scanMode", "scanDump", "scan", "scanStop",
+        "scanResults", "group", "groupStop", "groupStatus", "duty", "tasks", "stats", "crcBench", "cryptoBench",
+    };
+
+    static constexpr size_t consoleCommandCount = sizeof(consoleCommandNames) / sizeof(consoleCommandNames[0]);
+    static constexpr auto consoleCommandHash = makePerfectHash(consoleCommandNames);
+    static_assert(consoleCommandHash.complete, "Duplicate console command name");
+}
+
+#endif // IOHC_COMMANDS_H
@@ -0,0 +1,130 @@
+#ifndef IOHC_CONSOLE_H
+#define IOHC_CONSOLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <interact.h>
+#include <iohcCommands.h>
+#include <iohcEventLoop.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+    #include "freertos/queue.h"
+}
+
+// Commands registered under a name missing from iohcCommands.h
+#ifndef IOHC_CONSOLE_COMMANDS
+    #define IOHC_CONSOLE_COMMANDS 16
+#endif
+// Longer input lines are cut
+#ifndef IOHC_CONSOLE_LINE
+    #define IOHC_CONSOLE_LINE 128
+#endif
+// Tokens past this one are dropped
+#ifndef IOHC_CONSOLE_ARGS
+    #define IOHC_CONSOLE_ARGS 24
+#endif
+// Lines waiting for the command task, behind a background command
+#ifndef IOHC_CONSOLE_PENDING
+    #define IOHC_CONSOLE_PENDING 4
+#endif
+
+namespace IOHC {
+    /**
+     * Tokens of a command line, pointing into the line itself: the separators are overwritten in place,
+     * nothing is copied or allocated. Valid while the handler runs.
+     */
+    class iohcArgs {
+    public:
+        size_t size() const { return _count; }
+        // Empty past the last token
+        std::string_view at(size_t n) const { return n < _count ? std::string_view(_tokens[n], _lengths[n]) : std::string_view(); }
+        const char *c_str(size_t n) const { return n < _count ? _tokens[n] : ""; }
+        // Copy for the handlers still taking Tokens
+        Tokens tokens() const;
+
+    private:
+        friend class iohcConsole;
+        void split(char *line);
+
+        const char *_tokens[IOHC_CONSOLE_ARGS];
+        uint8_t _lengths[IOHC_CONSOLE_ARGS];
+        size_t _count = 0;
+    };
+
+    enum class commandMode : uint8_t {
+        foreground, // On the calling task, the console loop for typed lines, queued while another command runs
+        background, // On the command task: for handlers that take seconds
+    };
+
+    /**
+     * Serial console on the event loop: the UART receive callback posts loopEvent::console, the loop task
+     * reads what arrived, assembles the line and runs the matching command with its space separated tokens.
+     * Names listed in iohcCommands.h are found through the compile time perfect hash, help texts stay in flash.
+     * MQTT or HTTP front ends go through execute() and get the same commands.
+     * Commands run one at a time whatever the task, the handlers share the device objects unlocked.
+     */
+    class iohcConsole {
+    public:
+        using argsFunc = void (*)(const iohcArgs *cmd);
+        using handlerFunc = void (*)(Tokens *cmd);
+
+        static iohcConsole *getInstance();
+        virtual ~iohcConsole() = default;
+
+        bool addHandler(const char *name, const char *help, argsFunc handler, commandMode mode = commandMode::foreground);
+        bool addHandler(const char *name, const char *help, handlerFunc handler, commandMode mode = commandMode::foreground);
+        // Hooks the UART callback and the loop event, call before iohcEventLoop::start()
+        bool begin(iohcEventLoop *loop, BaseType_t core = IOHC_COMMAND_TASK_CORE,
+                   UBaseType_t priority = IOHC_COMMAND_TASK_PRIORITY, uint32_t stackSize = IOHC_COMMAND_TASK_STACK);
+        // Runs or queues one command line, false for an unknown command or a full queue
+        bool execute(const char *line);
+        void help() const;
+        void dump() const;
+
+    private:
+        iohcConsole() = default;
+        static iohcConsole *_iohcConsole;
+        static void onInput(void *arg);
+        static void task(void *arg);
+        void read();
+
+        struct command {
+            const char *name;
+            const char *help;
+            argsFunc args;
+            handlerFunc tokens;
+            commandMode mode;
+        };
+        bool add(const command &c);
+        const command *find(std::string_view name) const;
+        static void run(const command &c, const iohcArgs &args);
+        // Ends a run, the command task takes what was queued meanwhile
+        void release();
+
+        command _commands[consoleCommandCount]{};  // By position in consoleCommandNames
+        command _extra[IOHC_CONSOLE_COMMANDS]{};
+        size_t _extraCount = 0;
+        char _line[IOHC_CONSOLE_LINE];
+        size_t _len = 0;
+        iohcEventLoop *_loop = nullptr;
+
+        // Held by whichever task runs a command
+        std::atomic<bool> _busy{false};
+        // Lines for the command task, _job is the one it runs
+        QueueHandle_t _jobs = nullptr;
+        char _job[IOHC_CONSOLE_LINE];
+        std::atomic<const command *> _jobCommand{nullptr};
+        TaskHandle_t _task = nullptr;
+        std::atomic<uint32_t> _executed{0};
+        std::atomic<uint32_t> _background{0};
+        std::atomic<uint32_t> _rejected{0};
+    };
+}
+
+#endif // IOHC_CONSOLE_H
@@ -0,0 +1,63 @@
+#ifndef IOHC_CRC_H
+#define IOHC_CRC_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * CRC16-KERMIT (poly 0x8408 reflected, init 0, no final xor) used as io-homecontrol frame FCS.
+ * Computing it over a whole frame including its FCS gives 0.
+ * Header only and free of Arduino dependencies so host tools build it as is.
+ */
+#if defined(ESP32) && __has_include(<esp_rom_crc.h>)
+    #include <esp_rom_crc.h>
+    #define IOHC_ROM_CRC16
+#endif
+
+namespace IOHC {
+    // Reference implementation, one bit at a time
+    constexpr uint16_t crc16KermitBitwise(const uint8_t *data, size_t len, uint16_t crc = 0) {
+        for (size_t i = 0; i < len; i++) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+        return crc;
+    }
+
+    constexpr std::array<uint16_t, 256> crc16KermitTable() {
+        std::array<uint16_t, 256> table{};
+        for (uint16_t i = 0; i < 256; i++) {
+            uint8_t byte = i;
+            table[i] = crc16KermitBitwise(&byte, 1);
+        }
+        return table;
+    }
+
+    inline constexpr std::array<uint16_t, 256> crc16KermitLut = crc16KermitTable();
+
+    // Table driven, one lookup per byte
+    constexpr uint16_t crc16KermitTableDriven(const uint8_t *data, size_t len, uint16_t crc = 0) {
+        for (size_t i = 0; i < len; i++)
+            crc = (crc >> 8) ^ crc16KermitLut[(crc ^ data[i]) & 0xFF];
+        return crc;
+    }
+
+    // Fastest available: ESP32 ROM routine when present, the lookup table otherwise
+    inline uint16_t crc16Kermit(const uint8_t *data, size_t len, uint16_t crc = 0) {
+#if defined(IOHC_ROM_CRC16)
+        return ~esp_rom_crc16_le((uint16_t) ~crc, data, len);
+#else
+        return crc16KermitTableDriven(data, len, crc);
+#endif
+    }
+
+    namespace crcCheck {
+        constexpr uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+        static_assert(crc16KermitBitwise(check, sizeof(check)) == 0x2189, "CRC16-KERMIT check value");
+        static_assert(crc16KermitTableDriven(check, sizeof(check)) == 0x2189, "CRC16-KERMIT table mismatch");
+    }
+}
+
+#endif // IOHC_CRC_H
@@ -0,0 +1,60 @@
+#ifndef IOHC_DISPATCHER_H
+#define IOHC_DISPATCHER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#include <iohcMessages.h>
+#include <iohcPacket.h>
+
+namespace IOHC {
+    using iohcHandler = bool (*)(iohcPacket *iohc);
+
+    /**
+     * Received frames dispatcher: one handler per command byte, looked up in O(1).
+     * Every entry starts on the unknown command handler, devices register theirs at startup.
+     * Handlers registered with a message of iohcMessages.h only see frames long enough for it.
+     */
+    class iohcDispatcher {
+    public:
+        static iohcDispatcher *getInstance();
+        virtual ~iohcDispatcher() = default;
+
+        void registerHandler(uint8_t cmd, iohcHandler handler) { _handlers[cmd] = handler ? handler : unknownCommand; }
+        void registerHandler(std::initializer_list<uint8_t> cmds, iohcHandler handler) {
+            for (uint8_t cmd : cmds) registerHandler(cmd, handler);
+        }
+        template<class Message>
+        void registerHandler(iohcHandler handler) {
+            registerHandler(Message::cmd, handler);
+            _minLength[Message::cmd] = Message::frameSize;
+        }
+        // The only length check of the typed messages, their fields are read unchecked by the handlers
+        bool dispatch(iohcPacket *iohc) const {
+            const uint8_t cmd = iohc->payload.packet.header.cmd;
+            if (iohc->buffer_length < _minLength[cmd]) return shortFrame(iohc);
+            return _handlers[cmd](iohc);
+        }
+
+        static bool unknownCommand(iohcPacket *iohc);
+        static bool shortFrame(iohcPacket *iohc);
+        // Handler for known commands that need no processing
+        static bool ignoreCommand(iohcPacket *) { return true; }
+
+    private:
+        iohcDispatcher() = default;
+        static iohcDispatcher *_iohcDispatcher;
+
+        static constexpr std::array<iohcHandler, 256> defaultTable() {
+            std::array<iohcHandler, 256> table{};
+            for (auto &handler : table) handler = unknownCommand;
+            return table;
+        }
+        std::array<iohcHandler, 256> _handlers = defaultTable();
+        std::array<uint8_t, 256> _minLength{};
+    };
+}
+
+#endif // IOHC_DISPATCHER_H
@@ -0,0 +1,63 @@
+#ifndef IOHC_EVENT_LOOP_H
+#define IOHC_EVENT_LOOP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+
+namespace IOHC {
+    // One notification bit each
+    enum class loopEvent : uint8_t {
+        console, // Bytes received on the console UART
+        user,    // First id free for other sources
+        count = 32
+    };
+
+    /**
+     * Gateway event loop: one task blocked on its notification value, woken by the event sources
+     * (UART receive callback, GPIO interrupts, timers) setting their bit. Nothing is polled, the task
+     * costs no CPU between events and the core can idle.
+     */
+    class iohcEventLoop {
+    public:
+        using eventFunc = void (*)(void *arg);
+
+        static iohcEventLoop *getInstance();
+        virtual ~iohcEventLoop() = default;
+
+        bool start(BaseType_t core = IOHC_LOOP_TASK_CORE, UBaseType_t priority = IOHC_LOOP_TASK_PRIORITY,
+                   uint32_t stackSize = IOHC_LOOP_TASK_STACK);
+        // func runs on the loop task once per wakeup for every posted event. Register before start().
+        bool on(loopEvent event, eventFunc func, void *arg = nullptr);
+        // Events posted several times before the loop runs are handled once
+        void post(loopEvent event);
+        void IRAM_ATTR postFromISR(loopEvent event);
+
+        void dump() const;
+
+    private:
+        iohcEventLoop() = default;
+        static iohcEventLoop *_iohcEventLoop;
+        static void task(void *arg);
+
+        static constexpr size_t events = static_cast<size_t>(loopEvent::count);
+        struct handler {
+            eventFunc func;
+            void *arg;
+        };
+
+        handler _handlers[events]{};
+        TaskHandle_t _task = nullptr;
+        std::atomic<uint32_t> _wakeups{0};
+        std::atomic<uint32_t> _handled{0};
+    };
+}
+
+#endif // IOHC_EVENT_LOOP_H
@@ -0,0 +1,109 @@
+#ifndef IOHC_FRAME_H
+#define IOHC_FRAME_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Non-owning views over a received frame, so handlers read header, command and parameters
+ * straight from the radio buffer instead of copying them into vectors.
+ * Only the iohcPacket overloads need the radio library, host tools include this header as is.
+ */
+namespace IOHC {
+    static constexpr size_t frameHeaderSize = 9; // Control bytes, target, source, command ID
+    static constexpr size_t frameMaxSize = 32;   // Without the CRC
+    static constexpr size_t frame1WFooterSize = 8; // Sequence number and MAC
+
+    // Byte range inside a frame
+    struct iohcBytes {
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+
+        constexpr const uint8_t *begin() const { return data; }
+        constexpr const uint8_t *end() const { return data + size; }
+        constexpr uint8_t operator[](size_t i) const { return data[i]; }
+        constexpr bool empty() const { return size == 0; }
+        // Clamped to the range, never reads past it
+        constexpr iohcBytes sub(size_t offset, size_t len = SIZE_MAX) const {
+            offset = std::min(offset, size);
+            return {data + offset, std::min(len, size - offset)};
+        }
+    };
+
+    class iohcFrameView {
+    public:
+        constexpr iohcFrameView(const uint8_t *buffer, size_t len) : _buffer(buffer), _len(std::min(len, frameMaxSize)) {}
+        template<class Packet>
+        explicit iohcFrameView(const Packet *iohc) : iohcFrameView(iohc->payload.buffer, iohc->buffer_length) {}
+
+        constexpr bool valid() const { return _len >= frameHeaderSize + (oneWay() ? frame1WFooterSize : 0); }
+        constexpr uint8_t ctrl1() const { return _buffer[0]; }
+        constexpr uint8_t ctrl2() const { return _buffer[1]; }
+        constexpr bool oneWay() const { return _buffer[0] & 0x20; }
+        constexpr bool startFrame() const { return _buffer[0] & 0x40; }
+        constexpr bool endFrame() const { return _buffer[0] & 0x80; }
+        constexpr const uint8_t *target() const { return _buffer + 2; }
+        constexpr const uint8_t *source() const { return _buffer + 5; }
+        constexpr uint8_t cmd() const { return _buffer[8]; }
+
+        // Command parameters, without the 1W sequence number and MAC
+        constexpr iohcBytes params() const { return bytes().sub(frameHeaderSize, paramsEnd() - frameHeaderSize); }
+        // Command ID followed by its parameters, as hashed into the initial value
+        constexpr iohcBytes authenticated() const { return bytes().sub(frameHeaderSize - 1, paramsEnd() - frameHeaderSize + 1); }
+        // 1W only
+        constexpr const uint8_t *sequence() const { return _buffer + _len - frame1WFooterSize; }
+        constexpr const uint8_t *mac() const { return _buffer + _len - 6; }
+        constexpr iohcBytes bytes() const { return {_buffer, _len}; }
+
+    private:
+        constexpr size_t paramsEnd() const {
+            return oneWay() && _len >= frameHeaderSize + frame1WFooterSize ? _len - frame1WFooterSize : _len;
+        }
+
+        const uint8_t *_buffer;
+        size_t _len;
+    };
+
+    /**
+     * Compact received frame: what the receive path keeps of an iohcPacket.
+     * Queued by the RX pipeline and stored as is by the packet archive.
+     */
+    struct __attribute__((packed)) iohcRxRecord {
+        uint64_t stamp;     // us since boot, radio callback time
+        uint32_t frequency;
+        int8_t rssi;        // dBm
+        uint8_t length;
+        uint8_t radio;      // Transceiver the frame came from, see iohcRadioSet
+        uint8_t flags;      // iohcRxFlags, see iohcCapture.h
+        uint8_t buffer[frameMaxSize];
+
+        iohcFrameView view() const { return {buffer, length}; }
+
+        template<class Packet>
+        void set(const Packet *iohc, uint64_t at, uint8_t from) {
+            stamp = at;
+            frequency = iohc->frequency;
+            rssi = static_cast<int8_t>(iohc->rssi);
+            length = std::min<size_t>(iohc->buffer_length, sizeof(buffer));
+            radio = from;
+            flags = 0;
+            memcpy(buffer, iohc->payload.buffer, length);
+        }
+
+        // Fills a packet reused from frame to frame: every field the record does not hold is cleared,
+        // the buffer past length and the TX settings (repeat, delayed, lock...) included
+        template<class Packet>
+        void toPacket(Packet *iohc) const {
+            *iohc = Packet{};
+            iohc->buffer_length = length;
+            iohc->frequency = frequency;
+            iohc->rssi = rssi;
+            memcpy(iohc->payload.buffer, buffer, length);
+        }
+    };
+    static_assert(sizeof(iohcRxRecord) == 48, "RX records are fixed size");
+}
+
+#endif // IOHC_FRAME_H
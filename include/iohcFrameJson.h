@@ -0,0 +1,91 @@
+#ifndef IOHC_FRAME_JSON_H
+#define IOHC_FRAME_JSON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <iohcFrame.h>
+#include <iohcPacket.h>
+
+/*
+ * Streaming JSON serializer for received frames.
+ * Fields are described once at compile time, values are hex encoded straight into the caller buffer:
+ * no JsonDocument, no intermediate strings, no heap.
+ */
+namespace IOHC {
+    using bytesView = iohcBytes;
+
+    struct frameField {
+        enum kind_t : uint8_t { text, hex };
+
+        const char *key;
+        kind_t kind;
+        const char *value;                       // kind == text
+        bytesView (*bytes)(const iohcPacket *);  // kind == hex
+        size_t maxBytes;                         // kind == hex, upper bound used to size the buffer
+    };
+
+    inline constexpr frameField frameSchema[] = {
+        {"type", frameField::text, "Cozy", nullptr, 0},
+        {"from", frameField::hex, nullptr, [](const iohcPacket *iohc) { return bytesView{iohc->payload.packet.header.target, 3}; }, 3},
+        {"to", frameField::hex, nullptr, [](const iohcPacket *iohc) { return bytesView{iohc->payload.packet.header.source, 3}; }, 3},
+        {"cmd", frameField::hex, nullptr, [](const iohcPacket *iohc) { return bytesView{&iohc->payload.packet.header.cmd, 1}; }, 1},
+        {"_data", frameField::hex, nullptr, [](const iohcPacket *iohc) {
+            return bytesView{iohc->payload.buffer + 9, iohc->buffer_length > 9 ? iohc->buffer_length - 9u : 0u};
+        }, 32 - 9},
+    };
+
+    constexpr size_t frameJsonMaxSize() {
+        size_t size = 2 + 1; // {} and terminator
+        for (const auto &field : frameSchema) {
+            size += std::char_traits<char>::length(field.key) + 6; // "key":"value",
+            size += field.kind == frameField::text ? std::char_traits<char>::length(field.value) : 2 * field.maxBytes;
+        }
+        return size;
+    }
+
+    /**
+     * Writes the frame as {"type":"Cozy","from":"..","to":"..","cmd":"..","_data":".."} into out.
+     * Returns the length written (without terminator), 0 if out is too small.
+     */
+    inline size_t serializeFrame(char *out, size_t room, const iohcPacket *iohc) {
+        static constexpr char digits[] = "0123456789abcdef";
+        size_t pos = 0;
+        auto put = [&](char c) {
+            if (pos < room) out[pos] = c;
+            pos++;
+        };
+        auto puts = [&](const char *str) {
+            while (*str) put(*str++);
+        };
+
+        put('{');
+        for (size_t f = 0; f < sizeof(frameSchema) / sizeof(frameSchema[0]); f++) {
+            const frameField &field = frameSchema[f];
+            if (f) put(',');
+            put('"');
+            puts(field.key);
+            puts("\":\"");
+            if (field.kind == frameField::text) {
+                puts(field.value);
+            } else {
+                bytesView view = field.bytes(iohc);
+                if (view.size > field.maxBytes) view.size = field.maxBytes;
+                for (size_t i = 0; i < view.size; i++) {
+                    put(digits[view.data[i] >> 4]);
+                    put(digits[view.data[i] & 0x0F]);
+                }
+            }
+            put('"');
+        }
+        put('}');
+
+        if (pos >= room) return 0;
+        out[pos] = '\0';
+        return pos;
+    }
+}
+
+#endif // IOHC_FRAME_JSON_H
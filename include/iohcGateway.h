@@ -0,0 +1,40 @@
+#ifndef IOHC_GATEWAY_H
+#define IOHC_GATEWAY_H
+
+#include <board-config.h>
+#include <user_config.h>
+
+#include <iohcRadio.h>
+#include <iohcRemote1W.h>
+#include <iohcCozyDevice2W.h>
+#include <iohcOtherDevice2W.h>
+#include <iohcPacketPool.h>
+#include <iohcDispatcher.h>
+
+/*
+ * Gateway state shared by main and the received frames handlers (defined in main.cpp)
+ */
+using outboundPoolType = IOHC::iohcPacketPool<IOHC_OUTBOUND_MAX_PACKETS>;
+using outboundList = IOHC::iohcPacketList<outboundPoolType, 2>;
+
+extern bool verbosity;
+extern bool pairMode;
+extern bool scanMode;
+extern uint8_t keyCap[16];
+
+extern IOHC::iohcRadio* radioInstance;
+// Filled by the handlers, dispatch task only: other tasks build their frames on their own
+extern outboundList packets2send;
+
+extern IOHC::iohcRemote1W* remote1W;
+extern IOHC::iohcCozyDevice2W* cozyDevice2W;
+extern IOHC::iohcOtherDevice2W* otherDevice2W;
+
+namespace IOHC {
+    // Each device family registers its received frames handlers
+    void registerCozyDevice2WHandlers(iohcDispatcher* dispatcher);
+    void registerOtherDevice2WHandlers(iohcDispatcher* dispatcher);
+    void registerRemote1WHandlers(iohcDispatcher* dispatcher);
+}
+
+#endif // IOHC_GATEWAY_H
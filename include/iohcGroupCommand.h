@@ -0,0 +1,118 @@
+#ifndef IOHC_GROUP_COMMAND_H
+#define IOHC_GROUP_COMMAND_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcFrame.h>
+#include <iohcPacket.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+    #include "freertos/semphr.h"
+}
+
+// Devices addressed by one group command
+#ifndef IOHC_GROUP_TARGETS
+    #define IOHC_GROUP_TARGETS 16
+#endif
+// Extra transmissions per device, sent in rounds over all devices
+#ifndef IOHC_GROUP_REPEAT
+    #define IOHC_GROUP_REPEAT 2
+#endif
+// Least time between two transmissions to the same device
+#ifndef IOHC_GROUP_REPEAT_MS
+    #define IOHC_GROUP_REPEAT_MS 30
+#endif
+// A device still silent this long after its last transmission failed
+#ifndef IOHC_GROUP_TIMEOUT_MS
+    #define IOHC_GROUP_TIMEOUT_MS 1500
+#endif
+#ifndef IOHC_GROUP_TICK_MS
+    #define IOHC_GROUP_TICK_MS 10
+#endif
+// TX queue jobs left to the 2W answers while a group is sent
+#define IOHC_GROUP_TX_RESERVE 2
+// Command parameters of a group command
+#define IOHC_GROUP_MAX_DATA (frameMaxSize - frameHeaderSize)
+
+namespace IOHC {
+    enum class groupResult : uint8_t {
+        pending,
+        acked,   // Answered, challenge included
+        refused, // 0xFE from the device
+        failed,  // No answer after every transmission
+    };
+    const char *groupResultName(groupResult result);
+
+    struct iohcGroupTarget {
+        uint8_t address[3];
+        groupResult result;
+        uint8_t answer;     // Command ID of the answer, refused command for 0xFE
+        uint8_t sent;       // Transmissions so far
+        bool heard;         // Challenged or answered, no more repeats
+        bool reported;      // Result handed to the done callback
+        int64_t lastSent;
+        int64_t doneAt;
+    };
+
+    /**
+     * One 2W command to many devices as a pipelined group, for scenes from the console or MQTT.
+     * Every device gets a single transmission per round so repeats of different devices interleave,
+     * all of them go through the TX queue at the interactive class, and 2W answers keep their priority.
+     * Each device has an iohcSession2W exchange, so its challenge is answered while the others are sent.
+     * A device stops being repeated once heard, its result comes with its answer or after IOHC_GROUP_TIMEOUT_MS.
+     * Results are reported from the group task, never from the RX dispatch task.
+     */
+    class iohcGroupCommand {
+    public:
+        using resultFunc = void (*)(const iohcGroupTarget &target);
+
+        static iohcGroupCommand *getInstance();
+        virtual ~iohcGroupCommand() = default;
+
+        // gateway is the source address, targets are 3 bytes addresses. done is called per device.
+        bool start(const uint8_t *gateway, const uint8_t (*targets)[3], size_t count, uint8_t cmd, const uint8_t *data,
+                   size_t len, uint32_t frequency, resultFunc done = nullptr);
+        void stop();
+        bool running() const { return _running.load(std::memory_order_relaxed); }
+        void received(const iohcPacket *iohc);
+        void dump();
+
+    private:
+        iohcGroupCommand() = default;
+        static iohcGroupCommand *_iohcGroupCommand;
+        static void task(void *arg);
+
+        void step();
+        bool send(iohcGroupTarget &target, int64_t now);
+        void finish(iohcGroupTarget &target, groupResult result, uint8_t answer);
+        // Copies the results not reported yet, under _lock
+        size_t unreported(iohcGroupTarget *out);
+
+        uint8_t _gateway[3];
+        iohcGroupTarget _targets[IOHC_GROUP_TARGETS];
+        size_t _count = 0;
+        uint8_t _cmd = 0;
+        uint8_t _data[IOHC_GROUP_MAX_DATA];
+        uint8_t _dataLen = 0;
+        uint32_t _frequency = 0;
+        resultFunc _done = nullptr;
+        // Next transmission: round then target, a round sends once to every device not heard yet
+        uint8_t _round = 0;
+        size_t _next = 0;
+        int64_t _started = 0;
+        std::atomic<bool> _running{false};
+        SemaphoreHandle_t _lock = nullptr;
+        TaskHandle_t _task = nullptr;
+        std::atomic<uint32_t> _groups{0};
+        std::atomic<uint32_t> _frames{0};
+        std::atomic<uint32_t> _acked{0};
+        std::atomic<uint32_t> _failed{0};
+    };
+}
+
+#endif // IOHC_GROUP_COMMAND_H
@@ -0,0 +1,50 @@
+#ifndef IOHC_INITIAL_VALUE_H
+#define IOHC_INITIAL_VALUE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * AES initial value used by io-homecontrol authentication and key exchange.
+ * Same result as constructInitialValue but works on plain byte ranges, so frames can be used in
+ * place without building vectors. Portable, host tools include it as is.
+ */
+namespace IOHC {
+    constexpr void initialValueChecksum(uint8_t frameByte, uint8_t &chksum1, uint8_t &chksum2) {
+        uint8_t tmp = frameByte ^ chksum2;
+        uint8_t next = (chksum1 & 0x7F) << 1;
+        if (tmp & 0x80) next |= 1;
+        if (chksum1 & 0x80) {
+            chksum1 = next ^ 0x55;
+            chksum2 = (tmp << 1) ^ 0x5B;
+        } else {
+            chksum1 = next;
+            chksum2 = tmp << 1;
+        }
+    }
+
+    /**
+     * frame starts at the command ID. 2W uses the 6 bytes challenge, 1W the 2 bytes sequence number
+     * (challenge == nullptr).
+     */
+    constexpr void initialValue(const uint8_t *frame, size_t len, const uint8_t *challenge, const uint8_t *sequence,
+                                uint8_t *iv) {
+        iv[8] = 0;
+        iv[9] = 0;
+        for (size_t i = 0; i < len; i++) {
+            initialValueChecksum(frame[i], iv[8], iv[9]);
+            if (i < 8) iv[i] = frame[i];
+        }
+        for (size_t i = len; i < 8; i++) iv[i] = 0x55;
+
+        if (challenge) {
+            for (size_t i = 0; i < 6; i++) iv[10 + i] = challenge[i];
+        } else {
+            iv[10] = sequence[0];
+            iv[11] = sequence[1];
+            for (size_t i = 12; i < 16; i++) iv[i] = 0x55;
+        }
+    }
+}
+
+#endif // IOHC_INITIAL_VALUE_H
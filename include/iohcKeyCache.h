@@ -0,0 +1,110 @@
+#ifndef IOHC_KEY_CACHE_H
+#define IOHC_KEY_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <crypto2Wutils.h>
+
+#if defined(ESP32) && __has_include(<aes/esp_aes.h>)
+    #include <aes/esp_aes.h>
+    #define IOHC_HW_AES
+#endif
+
+// Number of 2W devices whose key schedules are kept
+#ifndef IOHC_KEY_CACHE_SIZE
+    #define IOHC_KEY_CACHE_SIZE 32
+#endif
+
+namespace IOHC {
+    /**
+     * AES-128 key with its schedule prepared once.
+     * Uses the ESP32 AES peripheral when available, the software key expansion otherwise.
+     * encrypt() only reads the context so one key can be shared between tasks.
+     */
+    class iohcAesKey {
+    public:
+        iohcAesKey();
+        ~iohcAesKey();
+        iohcAesKey(const iohcAesKey &) = delete;
+        iohcAesKey &operator=(const iohcAesKey &) = delete;
+
+        void setKey(const uint8_t *key);
+        void encrypt(uint8_t *block) const; // ECB, in place
+        bool isSet() const { return _set; }
+
+    private:
+#if defined(IOHC_HW_AES)
+        mutable esp_aes_context _ctx;
+#else
+        AES_ctx _ctx;
+#endif
+        bool _set = false;
+    };
+
+    struct iohcDeviceKeys {
+        uint8_t address[3];
+        uint8_t key[16];   // As sent in the key transfer, for the next one
+        iohcAesKey system; // Stack/system key, used to answer challenges
+        std::atomic<uint8_t> pins{0}; // Schedules in use, never replaced meanwhile
+        bool used = false;
+    };
+
+    /**
+     * Expanded keys per paired 2W device, built at pairing or load time instead of on every challenge.
+     * The transfer key is the same for every device and is expanded once.
+     * Schedules are handed out pinned: a full cache replaces the next entry nobody holds.
+     */
+    class iohcKeyCache {
+    public:
+        // A device key schedule, pinned while in scope
+        class pinnedKey {
+        public:
+            pinnedKey(const pinnedKey &) = delete;
+            pinnedKey &operator=(const pinnedKey &) = delete;
+            ~pinnedKey() {
+                if (_device) _device->pins.fetch_sub(1, std::memory_order_release);
+            }
+            const iohcAesKey &key() const { return _device ? _device->system : _transfer; }
+
+        private:
+            friend class iohcKeyCache;
+            pinnedKey(iohcDeviceKeys *device, const iohcAesKey &transfer) : _device(device), _transfer(transfer) {}
+            iohcDeviceKeys *_device;
+            const iohcAesKey &_transfer;
+        };
+
+        static iohcKeyCache *getInstance();
+        virtual ~iohcKeyCache() = default;
+
+        const iohcAesKey &transfer() const { return _transfer; }
+        // Key schedule for a device, defaults to the transfer key until a system key is set
+        pinnedKey system(const uint8_t *address);
+        // Key negotiated with a device, false when none was set
+        bool key(const uint8_t *address, uint8_t *out);
+        // False when every entry is pinned, or the device key is pinned and differs
+        bool setSystemKey(const uint8_t *address, const uint8_t *key);
+        void forget(const uint8_t *address);
+        size_t size() const;
+
+    private:
+        iohcKeyCache();
+        static iohcKeyCache *_iohcKeyCache;
+        iohcDeviceKeys *find(const uint8_t *address);
+
+        iohcAesKey _transfer;
+        iohcDeviceKeys _devices[IOHC_KEY_CACHE_SIZE];
+        size_t _next = 0; // Round robin replacement once full
+    };
+
+    /*
+     * 2W helpers working on prepared keys. frame starts at the command ID, challenge is 6 bytes.
+     * Both write a full 16 bytes block, a challenge answer only sends the first 6 bytes of the MAC.
+     */
+    void create2WHmac(uint8_t *mac, const uint8_t *frame, size_t len, const uint8_t *challenge, const iohcAesKey &key);
+    void encrypt2WKey(uint8_t *encrypted, const uint8_t *frame, size_t len, const uint8_t *challenge, const uint8_t *key);
+}
+
+#endif // IOHC_KEY_CACHE_H
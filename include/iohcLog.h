@@ -0,0 +1,138 @@
+#ifndef IOHC_LOG_H
+#define IOHC_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcTasks.h>
+
+#if !defined(IOHC_NATIVE)
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+#endif
+
+#define IOHC_LOG_NONE 0
+#define IOHC_LOG_ERROR 1
+#define IOHC_LOG_INFO 2
+#define IOHC_LOG_DEBUG 3 // Keys, MACs, frame contents
+#define IOHC_LOG_TRACE 4 // Intermediate crypto values
+
+// Messages above this level are not compiled in, their arguments are not even evaluated
+#ifndef IOHC_LOG_LEVEL
+    #define IOHC_LOG_LEVEL IOHC_LOG_DEBUG
+#endif
+// Chunks waiting for the UART. Must be a power of two.
+#ifndef IOHC_LOG_SLOTS
+    #define IOHC_LOG_SLOTS 64
+#endif
+// Longer messages are truncated
+#ifndef IOHC_LOG_LINE
+    #define IOHC_LOG_LINE 96
+#endif
+// Trace records at boot: 0 text, 1 binary on the console, 2 binary to IOHC_TRACE_FILE
+#ifndef IOHC_TRACE_MODE
+    #define IOHC_TRACE_MODE 0
+#endif
+#ifndef IOHC_TRACE_FILE
+    #define IOHC_TRACE_FILE "/trace.bin"
+#endif
+// Records past this size are dropped, the file is restarted when the file mode is selected again
+#ifndef IOHC_TRACE_FILE_MAX
+    #define IOHC_TRACE_FILE_MAX (256 * 1024)
+#endif
+
+namespace IOHC {
+    enum class traceEvent : uint8_t;
+    enum class traceMode : uint8_t;
+
+    /**
+     * Buffered log sink: producers format into their own stack and copy the text into a lock-free ring,
+     * a low priority task drains it to the console. A message that does not fit is dropped and counted,
+     * so the receive path never waits for the UART.
+     * Until start() and on the host the text goes straight to stdout.
+     */
+    class iohcLog {
+    public:
+        static iohcLog *getInstance();
+        virtual ~iohcLog() = default;
+
+#if defined(IOHC_NATIVE)
+        bool start() { return true; }
+#else
+        bool start(BaseType_t core = IOHC_LOG_TASK_CORE, UBaseType_t priority = IOHC_LOG_TASK_PRIORITY,
+                   uint32_t stackSize = IOHC_LOG_TASK_STACK);
+#endif
+        // Any task, several producers at once
+        bool write(const char *text, size_t len);
+        bool printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+        // prefix, then data as %02X separated by sep, then a new line
+        bool hex(const char *prefix, const uint8_t *data, size_t len, const char *sep = " ");
+        // Byte dump of a trace event (iohcTrace.h): hex text or binary record depending on the trace mode
+        bool trace(traceEvent event, const uint8_t *data, size_t len);
+        void setTraceMode(traceMode mode);
+        traceMode getTraceMode() const;
+
+        uint32_t written() const { return _written.load(std::memory_order_relaxed); }
+        uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+        void dump() const;
+
+    private:
+        iohcLog();
+        static iohcLog *_iohcLog;
+        static void task(void *arg);
+        bool push(const char *text, size_t len, bool wake);
+        bool drain();
+        void output(const char *text, size_t len);
+
+        // Bounded queue with a sequence per slot: producers claim a slot with one CAS on _enqueue
+        struct slot {
+            std::atomic<size_t> sequence;
+            uint8_t len;
+            char text[IOHC_LOG_LINE];
+        };
+
+        slot _slots[IOHC_LOG_SLOTS];
+        std::atomic<size_t> _enqueue{0};
+        size_t _dequeue = 0; // Log task only
+        bool _started = false;
+#if !defined(IOHC_NATIVE)
+        TaskHandle_t _task = nullptr;
+#endif
+        std::atomic<uint32_t> _written{0};
+        std::atomic<uint32_t> _dropped{0};
+        uint32_t _reported = 0; // Drops already announced on the console
+        std::atomic<uint8_t> _traceMode{IOHC_TRACE_MODE};
+        uint8_t _fileMode = 0; // Trace mode the log task has opened the file for
+        uint32_t _fileSize = 0;
+    };
+}
+
+#if IOHC_LOG_LEVEL >= IOHC_LOG_ERROR
+    #define IOHC_LOGE(...) IOHC::iohcLog::getInstance()->printf(__VA_ARGS__)
+#else
+    #define IOHC_LOGE(...) ((void) 0)
+#endif
+#if IOHC_LOG_LEVEL >= IOHC_LOG_INFO
+    #define IOHC_LOGI(...) IOHC::iohcLog::getInstance()->printf(__VA_ARGS__)
+#else
+    #define IOHC_LOGI(...) ((void) 0)
+#endif
+#if IOHC_LOG_LEVEL >= IOHC_LOG_DEBUG
+    #define IOHC_LOGD(...) IOHC::iohcLog::getInstance()->printf(__VA_ARGS__)
+    #define IOHC_LOGD_HEX(...) IOHC::iohcLog::getInstance()->hex(__VA_ARGS__)
+#else
+    #define IOHC_LOGD(...) ((void) 0)
+    #define IOHC_LOGD_HEX(...) ((void) 0)
+#endif
+#if IOHC_LOG_LEVEL >= IOHC_LOG_TRACE
+    #define IOHC_LOGT(...) IOHC::iohcLog::getInstance()->printf(__VA_ARGS__)
+    #define IOHC_LOGT_HEX(...) IOHC::iohcLog::getInstance()->hex(__VA_ARGS__)
+#else
+    #define IOHC_LOGT(...) ((void) 0)
+    #define IOHC_LOGT_HEX(...) ((void) 0)
+#endif
+
+#endif // IOHC_LOG_H
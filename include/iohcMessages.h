@@ -0,0 +1,116 @@
+#ifndef IOHC_MESSAGES_H
+#define IOHC_MESSAGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <iohcFrame.h>
+#include <iohcPacket.h>
+
+/*
+ * Compile-time catalogue of the io-homecontrol messages handled by the gateway.
+ * Every message has a fixed parameter size and named fields at constexpr offsets after the command ID.
+ * The dispatcher checks the frame length once for handlers registered with a message (see
+ * iohcDispatcher::registerHandler<message>), so fields are read without any further bounds check.
+ * scripts/io-homecontrol.ksy only describes the header: new fields go here first.
+ */
+namespace IOHC {
+    template<size_t Offset, size_t Size>
+    struct iohcField {
+        static constexpr size_t offset = Offset;
+        static constexpr size_t size = Size;
+
+        static constexpr const uint8_t *in(const iohcFrameView &frame) { return frame.bytes().data + frameHeaderSize + Offset; }
+        static const uint8_t *in(const iohcPacket *iohc) { return iohc->payload.buffer + frameHeaderSize + Offset; }
+        static uint8_t *in(iohcPacket *iohc) { return iohc->payload.buffer + frameHeaderSize + Offset; }
+    };
+
+    template<uint8_t Cmd, size_t Size>
+    struct iohcMessage {
+        static constexpr uint8_t cmd = Cmd;
+        static constexpr size_t size = Size; // Parameters after the command ID
+        // Shortest frame the fields can be read from, a 1W sequence number and MAC come on top
+        static constexpr size_t frameSize = frameHeaderSize + Size;
+        // Control byte 1 of a single frame message: length after the first byte, no start/end flag
+        static constexpr uint8_t ctrlByte1 = frameHeaderSize - 1 + Size;
+        static_assert(frameSize <= frameMaxSize, "Message does not fit in a frame");
+
+        template<class... Fields>
+        static constexpr bool holds() { return ((Fields::offset + Fields::size <= Size) && ...); }
+
+        static constexpr bool fits(const iohcFrameView &frame) { return frame.bytes().size >= frameSize; }
+    };
+
+    namespace msg {
+        // 2W discovery and pairing
+        struct discover : iohcMessage<0x28, 0> {};
+        struct discoverAnswer : iohcMessage<0x29, 9> {
+            using data = iohcField<0, 9>; // Node type, manufacturer and capabilities of the device
+        };
+        static_assert(discoverAnswer::holds<discoverAnswer::data>());
+        struct discoverActuator : iohcMessage<0x2C, 0> {};
+        struct discoverActuatorAck : iohcMessage<0x2D, 0> {};
+
+        // 2W key exchange and authentication
+        struct askChallenge : iohcMessage<0x31, 0> {};
+        struct keyTransfert : iohcMessage<0x32, 16> {
+            using key = iohcField<0, 16>; // System key encrypted with the challenge
+        };
+        static_assert(keyTransfert::holds<keyTransfert::key>());
+        struct launchKeyTransfert : iohcMessage<0x38, 6> {
+            using challenge = iohcField<0, 6>;
+        };
+        static_assert(launchKeyTransfert::holds<launchKeyTransfert::challenge>());
+        struct challengeRequest : iohcMessage<0x3C, 6> {
+            using challenge = iohcField<0, 6>;
+        };
+        static_assert(challengeRequest::holds<challengeRequest::challenge>());
+        struct challengeAnswer : iohcMessage<0x3D, 6> {
+            using mac = iohcField<0, 6>; // First 6 bytes of the AES block
+        };
+        static_assert(challengeAnswer::holds<challengeAnswer::mac>());
+
+        // 2W device information
+        struct nameAnswer : iohcMessage<0x51, 16> {
+            using name = iohcField<0, 16>; // Space padded, not terminated
+        };
+        static_assert(nameAnswer::holds<nameAnswer::name>());
+        struct unknownAnswer : iohcMessage<0xFE, 1> {
+            using refused = iohcField<0, 1>; // Command the device does not know
+        };
+        static_assert(unknownAnswer::holds<unknownAnswer::refused>());
+
+        // 1W
+        struct keyPush : iohcMessage<0x30, 16> {
+            using key = iohcField<0, 16>; // Controller key encrypted with the node address
+        };
+        static_assert(keyPush::holds<keyPush::key>());
+    }
+
+    /**
+     * Fills reply as an answer to request: control bytes for a len bytes payload, source and target swapped,
+     * data copied after the command byte, radio parameters set and IOHC::packetStamp taken.
+     */
+    void buildReply(iohcPacket *reply, const iohcPacket *request, uint8_t cmd, const uint8_t *data, size_t len,
+                    uint32_t frequency, uint16_t repeatTime, uint8_t repeat, uint16_t delayed = 0);
+
+    /**
+     * Typed buildReply: the parameter size comes from the message, data must hold at least that many bytes.
+     */
+    template<class Message, size_t N>
+    void buildReply(iohcPacket *reply, const iohcPacket *request, const uint8_t (&data)[N], uint32_t frequency,
+                    uint16_t repeatTime, uint8_t repeat, uint16_t delayed = 0) {
+        static_assert(N >= Message::size, "Not enough data for the message");
+        buildReply(reply, request, Message::cmd, data, Message::size, frequency, repeatTime, repeat, delayed);
+    }
+
+    template<class Message>
+    void buildReply(iohcPacket *reply, const iohcPacket *request, uint32_t frequency, uint16_t repeatTime,
+                    uint8_t repeat, uint16_t delayed = 0) {
+        static_assert(Message::size == 0, "Message has parameters");
+        buildReply(reply, request, Message::cmd, nullptr, 0, frequency, repeatTime, repeat, delayed);
+    }
+}
+
+#endif // IOHC_MESSAGES_H
@@ -0,0 +1,112 @@
+#ifndef IOHC_NODE_INDEX_H
+#define IOHC_NODE_INDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+    #include "freertos/semphr.h"
+}
+
+#ifndef IOHC_NODE_INDEX_FILE
+    #define IOHC_NODE_INDEX_FILE "/nodes.bin"
+#endif
+#ifndef IOHC_NODE_JOURNAL_FILE
+    #define IOHC_NODE_JOURNAL_FILE "/nodes.jnl"
+#endif
+// JSON table of iohcSystemTable, imported once when there is neither index nor journal
+#ifndef IOHC_SYS_TABLE
+    #define IOHC_SYS_TABLE "/sysTable.json"
+#endif
+// Paired nodes kept in the index
+#ifndef IOHC_NODE_INDEX_SIZE
+    #define IOHC_NODE_INDEX_SIZE 256
+#endif
+// Journal entries appended before the index file is rewritten
+#ifndef IOHC_NODE_JOURNAL_MAX
+    #define IOHC_NODE_JOURNAL_MAX 64
+#endif
+
+namespace IOHC {
+    struct __attribute__((packed)) iohcNodeRecord {
+        enum : uint8_t { discovered = 0x01, hasKey = 0x02, hasName = 0x04, dirty = 0x80 };
+
+        uint8_t node[3];
+        uint8_t backbone[3];
+        uint8_t actuator[2];
+        uint8_t manufacturer;
+        uint8_t info;
+        uint8_t flags;
+        uint8_t generation; // Journal entries: index generation they apply to, 0 in the index
+        uint8_t key[16];
+        char name[16];
+    };
+    static_assert(sizeof(iohcNodeRecord) == 44, "Node records are stored as is");
+
+    /**
+     * Paired nodes as a flat array of packed records sorted by the 3 bytes node address.
+     * Lookups are a branchless binary search. Changes only mark the record, a low priority task appends
+     * them to a journal and rewrites the index file once IOHC_NODE_JOURNAL_MAX entries piled up,
+     * so the dispatch task never waits on flash. Each rewrite bumps the index generation, journal entries of
+     * an older one are left out of the replay.
+     */
+    class iohcNodeIndex {
+    public:
+        using nodeFunc = void (*)(const iohcNodeRecord &record);
+
+        static iohcNodeIndex *getInstance();
+        virtual ~iohcNodeIndex() = default;
+
+        // Loads the index file then replays the journal, on first boot imports IOHC_SYS_TABLE
+        bool begin(BaseType_t core = IOHC_NODE_TASK_CORE, UBaseType_t priority = IOHC_NODE_TASK_PRIORITY,
+                   uint32_t stackSize = IOHC_NODE_TASK_STACK);
+
+        // Returns false when nothing changed, a repeated 0x2B costs no flash write
+        bool upsert(const uint8_t *node, const uint8_t *backbone, const uint8_t *actuator, uint8_t manufacturer,
+                    uint8_t info);
+        bool setKey(const uint8_t *node, const uint8_t *key);
+        bool setName(const uint8_t *node, const char *name, size_t len);
+        // Copies the record out, the table may move while the caller uses it
+        bool find(const uint8_t *node, iohcNodeRecord &record);
+        bool contains(const uint8_t *node) { iohcNodeRecord record; return find(node, record); }
+        void forEach(nodeFunc func);
+
+        // Writes pending changes; with compact the index file is rewritten and the journal dropped
+        void save(bool compact = false);
+        size_t size() const { return _count; }
+        void dump();
+
+    private:
+        iohcNodeIndex() = default;
+        static iohcNodeIndex *_iohcNodeIndex;
+        static void task(void *arg);
+
+        static uint32_t key(const uint8_t *node) { return (node[0] << 16) | (node[1] << 8) | node[2]; }
+        size_t lowerBound(uint32_t node) const;
+        iohcNodeRecord *insert(const uint8_t *node);
+        void apply(const iohcNodeRecord &record);
+        bool load();
+        bool replay();
+        size_t importSystemTable();
+        void writeJournal();
+        bool compact();
+        void changed(iohcNodeRecord &record);
+
+        iohcNodeRecord _records[IOHC_NODE_INDEX_SIZE]{};
+        size_t _count = 0;
+        SemaphoreHandle_t _lock = nullptr;
+        SemaphoreHandle_t _fileLock = nullptr;
+        TaskHandle_t _task = nullptr;
+        uint32_t _journaled = 0;
+        uint8_t _generation = 0;
+        std::atomic<uint32_t> _compactions{0};
+        std::atomic<uint32_t> _full{0};
+    };
+}
+
+#endif // IOHC_NODE_INDEX_H
@@ -0,0 +1,112 @@
+#ifndef IOHC_PACKET_ARCHIVE_H
+#define IOHC_PACKET_ARCHIVE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <LittleFS.h>
+#include <iohcCapture.h>
+#include <iohcFrame.h>
+#include <iohcPacket.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+    #include "freertos/semphr.h"
+}
+
+#ifndef IOHC_ARCHIVE_FILE
+    #define IOHC_ARCHIVE_FILE "/archive.bin"
+#endif
+// Flash page written at once, matches the LittleFS block size
+#ifndef IOHC_ARCHIVE_PAGE_SIZE
+    #define IOHC_ARCHIVE_PAGE_SIZE 4096
+#endif
+// Pages kept in the circular file, the oldest one is overwritten when full
+#ifndef IOHC_ARCHIVE_PAGES
+    #define IOHC_ARCHIVE_PAGES 32
+#endif
+// A partially filled page is written after this delay without traffic
+#ifndef IOHC_ARCHIVE_FLUSH_MS
+    #define IOHC_ARCHIVE_FLUSH_MS 10000
+#endif
+
+namespace IOHC {
+    // Frames are archived as received
+    using iohcArchiveRecord = iohcRxRecord;
+
+    // Pages are capture blocks, the archive file can be read as is by the host tools
+    using iohcArchivePageHeader = iohcCaptureBlock;
+
+    static constexpr size_t IOHC_ARCHIVE_RECORDS_PER_PAGE = capture::recordsPerBlock(IOHC_ARCHIVE_PAGE_SIZE);
+
+    /**
+     * Circular packet archive on LittleFS.
+     * The file is preallocated to IOHC_ARCHIVE_PAGES pages. Records are collected in RAM and a low priority task
+     * writes each full page in one go at its page aligned offset, so the dispatch task only pays a memcpy.
+     * Page order is recovered at boot from the page sequence numbers, no separate index is rewritten.
+     * Every boot starts a new page numbered with the next boot count, so the stamps of a page always share
+     * the same zero. Its origin is set once the wall clock is known.
+     * The file follows the capture format of iohcCapture.h, each page header indexes its records.
+     * Readers stream one record at a time and never load the archive in memory.
+     */
+    class iohcPacketArchive {
+    public:
+        using recordFunc = void (*)(const iohcArchiveRecord &record);
+
+        static iohcPacketArchive *getInstance();
+        virtual ~iohcPacketArchive() = default;
+
+        bool begin(BaseType_t core = IOHC_ARCHIVE_TASK_CORE, UBaseType_t priority = IOHC_ARCHIVE_TASK_PRIORITY,
+                   uint32_t stackSize = IOHC_ARCHIVE_TASK_STACK);
+        bool append(const iohcPacket *iohc);
+        bool append(const iohcRxRecord &record);
+        // Writes the page being filled, it is rewritten at the same place once full
+        void flush();
+        void clear();
+        // Oldest first, records not yet on flash included
+        void forEach(recordFunc func);
+        static void toPacket(const iohcArchiveRecord &record, iohcPacket *iohc);
+
+        uint32_t size();
+        static constexpr uint32_t capacity() { return IOHC_ARCHIVE_PAGES * IOHC_ARCHIVE_RECORDS_PER_PAGE; }
+        uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+        uint32_t pageWrites() const { return _pageWrites.load(std::memory_order_relaxed); }
+        uint32_t boot() const { return _boot; }
+        void dump();
+
+    private:
+        iohcPacketArchive() = default;
+        static iohcPacketArchive *_iohcPacketArchive;
+        static void task(void *arg);
+
+        struct page {
+            uint32_t sequence;
+            iohcArchiveRecord records[IOHC_ARCHIVE_RECORDS_PER_PAGE];
+        };
+
+        static constexpr size_t offset(uint32_t sequence) { return (sequence % IOHC_ARCHIVE_PAGES) * IOHC_ARCHIVE_PAGE_SIZE; }
+        bool preallocate();
+        void recover();
+        bool writePage(uint32_t sequence, const iohcArchiveRecord *records, uint16_t count);
+        bool readHeader(uint32_t sequence, iohcArchivePageHeader &header);
+
+        File _file;
+        SemaphoreHandle_t _fileLock = nullptr;
+        // Double buffer: one page filled by append(), the other one written by the task
+        page _pages[2]{};
+        uint8_t _filling = 0;
+        uint16_t _filled = 0;
+        uint32_t _boot = 0;
+        bool _writing = false;
+        bool _dirty = false;
+        portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+        TaskHandle_t _task = nullptr;
+        std::atomic<uint32_t> _dropped{0};
+        std::atomic<uint32_t> _pageWrites{0};
+    };
+}
+
+#endif // IOHC_PACKET_ARCHIVE_H
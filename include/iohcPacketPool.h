@@ -0,0 +1,143 @@
+#ifndef IOHC_PACKET_POOL_H
+#define IOHC_PACKET_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <iohcPacket.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+}
+
+namespace IOHC {
+    /**
+     * Fixed capacity iohcPacket pool. All packets live in the pool for the whole uptime,
+     * acquire/release only move an index on a free list so steady state does no heap allocation.
+     */
+    template<size_t N>
+    class iohcPacketPool {
+        static_assert(N > 0 && N <= UINT16_MAX, "iohcPacketPool indexes packets with uint16_t");
+
+    public:
+        // Move-only owner of a pooled packet, returns it to the pool when destroyed
+        class handle {
+        public:
+            handle() = default;
+            handle(const handle &) = delete;
+            handle &operator=(const handle &) = delete;
+            handle(handle &&other) noexcept : _pool(std::exchange(other._pool, nullptr)), _idx(other._idx) {}
+            handle &operator=(handle &&other) noexcept {
+                if (this != &other) {
+                    release();
+                    _pool = std::exchange(other._pool, nullptr);
+                    _idx = other._idx;
+                }
+                return *this;
+            }
+            ~handle() { release(); }
+
+            iohcPacket *get() const { return _pool ? &_pool->_packets[_idx] : nullptr; }
+            iohcPacket *operator->() const { return get(); }
+            iohcPacket &operator*() const { return *get(); }
+            explicit operator bool() const { return _pool != nullptr; }
+
+            void release() {
+                if (_pool) _pool->put(_idx);
+                _pool = nullptr;
+            }
+
+        private:
+            friend class iohcPacketPool;
+            handle(iohcPacketPool *pool, uint16_t idx) : _pool(pool), _idx(idx) {}
+            iohcPacketPool *_pool = nullptr;
+            uint16_t _idx = 0;
+        };
+
+        iohcPacketPool() {
+            for (size_t i = 0; i < N; i++) _free[i] = N - 1 - i;
+        }
+        iohcPacketPool(const iohcPacketPool &) = delete;
+        iohcPacketPool &operator=(const iohcPacketPool &) = delete;
+
+        // Returns an empty handle when the pool is exhausted, the packet is reset to its default state
+        handle acquire() {
+            portENTER_CRITICAL(&_mux);
+            if (!_freeCount) {
+                _failures++;
+                portEXIT_CRITICAL(&_mux);
+                return {};
+            }
+            uint16_t idx = _free[--_freeCount];
+            size_t used = N - _freeCount;
+            if (used > _highWater) _highWater = used;
+            portEXIT_CRITICAL(&_mux);
+
+            _packets[idx] = iohcPacket();
+            return {this, idx};
+        }
+
+        size_t inUse() const { return N - _freeCount; }
+        size_t highWater() const { return _highWater; }
+        uint32_t failures() const { return _failures; }
+        static constexpr size_t capacity() { return N; }
+
+    private:
+        void put(uint16_t idx) {
+            portENTER_CRITICAL(&_mux);
+            _free[_freeCount++] = idx;
+            portEXIT_CRITICAL(&_mux);
+        }
+
+        iohcPacket _packets[N];
+        uint16_t _free[N];
+        size_t _freeCount = N;
+        size_t _highWater = 0;
+        uint32_t _failures = 0;
+        portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+    };
+
+    /**
+     * Packets queued for one iohcRadio::send call.
+     * Keeps the pool handles alive until the list is reused and exposes the raw pointer vector
+     * iohcRadio::send expects. The vector is reserved once so adding packets never reallocates.
+     */
+    template<typename Pool, size_t Capacity>
+    class iohcPacketList {
+    public:
+        explicit iohcPacketList(Pool &pool) : _pool(pool) { _packets.reserve(Capacity); }
+
+        // Releases the previous train back to the pool
+        void clear() {
+            _packets.clear();
+            for (size_t i = 0; i < _count; i++) _handles[i].release();
+            _count = 0;
+        }
+
+        // Acquires a fresh packet at the end of the list, nullptr when the list or the pool is full
+        iohcPacket *add() {
+            if (_count >= Capacity) return nullptr;
+            typename Pool::handle h = _pool.acquire();
+            if (!h) return nullptr;
+            _handles[_count++] = std::move(h);
+            _packets.push_back(_handles[_count - 1].get());
+            return _packets.back();
+        }
+
+        iohcPacket *back() const { return _packets.back(); }
+        iohcPacket *operator[](size_t idx) const { return _packets[idx]; }
+        size_t size() const { return _count; }
+        bool empty() const { return _count == 0; }
+        std::vector<iohcPacket *> &pointers() { return _packets; }
+
+    private:
+        Pool &_pool;
+        typename Pool::handle _handles[Capacity];
+        size_t _count = 0;
+        std::vector<iohcPacket *> _packets;
+    };
+}
+
+#endif // IOHC_PACKET_POOL_H
@@ -0,0 +1,103 @@
+#ifndef IOHC_PERFECT_HASH_H
+#define IOHC_PERFECT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace IOHC {
+    // FNV-1a, seeded, with the high bits folded down for the power of two masks
+    constexpr uint32_t nameHash(std::string_view s, uint32_t seed) {
+        uint32_t h = 2166136261u ^ (seed * 0x9E3779B1u);
+        for (char c : s) {
+            h ^= static_cast<uint8_t>(c);
+            h *= 16777619u;
+        }
+        return h ^ (h >> 15);
+    }
+
+    constexpr size_t perfectHashSlots(size_t names) {
+        size_t slots = 1;
+        while (slots < 2 * names) slots <<= 1;
+        return slots;
+    }
+
+    /**
+     * Minimal hash and displace table over a fixed name list, built by the compiler.
+     * A first hash picks the bucket, the bucket displacement seeds the second hash giving the slot,
+     * and the slot holds the name position in the list. Lookups cost two hashes and one compare,
+     * whatever the number of names. Everything lives in flash.
+     */
+    template<size_t N>
+    struct iohcPerfectHash {
+        static constexpr size_t slots = perfectHashSlots(N);
+        static constexpr size_t buckets = (N + 3) / 4;
+        static constexpr uint8_t empty = 0xFF;
+        static_assert(N < empty, "Names are indexed on a byte");
+
+        const std::string_view *names = nullptr;
+        uint16_t displace[buckets]{};
+        uint8_t index[slots]{};
+        bool complete = false;
+
+        constexpr size_t slot(std::string_view s) const {
+            return nameHash(s, displace[nameHash(s, 0) % buckets] + 1u) & (slots - 1);
+        }
+        // Position of s in the list, -1 for other names
+        constexpr int find(std::string_view s) const {
+            const uint8_t i = index[slot(s)];
+            return i != empty && names[i] == s ? i : -1;
+        }
+    };
+
+    // complete stays false when the names hold a duplicate
+    template<size_t N>
+    constexpr iohcPerfectHash<N> makePerfectHash(const std::string_view (&names)[N]) {
+        using table = iohcPerfectHash<N>;
+        table t{};
+        t.names = names;
+        for (uint8_t &i : t.index) i = table::empty;
+
+        size_t bucket[N]{};
+        size_t sizes[table::buckets]{};
+        for (size_t i = 0; i < N; i++) sizes[bucket[i] = nameHash(names[i], 0) % table::buckets]++;
+
+        bool used[table::slots]{};
+        bool placed[table::buckets]{};
+        for (size_t round = 0; round < table::buckets; round++) {
+            // Largest bucket left first, the small ones fit in the gaps
+            size_t b = table::buckets;
+            for (size_t c = 0; c < table::buckets; c++)
+                if (!placed[c] && (b == table::buckets || sizes[c] > sizes[b])) b = c;
+            placed[b] = true;
+            if (!sizes[b]) continue;
+
+            bool fits = false;
+            for (uint32_t d = 0; d < UINT16_MAX && !fits; d++) {
+                size_t taken[N]{};
+                size_t count = 0;
+                fits = true;
+                for (size_t i = 0; i < N && fits; i++) {
+                    if (bucket[i] != b) continue;
+                    const size_t s = nameHash(names[i], d + 1) & (table::slots - 1);
+                    if (used[s]) fits = false;
+                    for (size_t k = 0; k < count && fits; k++) fits = taken[k] != s;
+                    taken[count++] = s;
+                }
+                if (!fits) continue;
+                t.displace[b] = d;
+                for (size_t i = 0; i < N; i++) {
+                    if (bucket[i] != b) continue;
+                    const size_t s = nameHash(names[i], d + 1) & (table::slots - 1);
+                    used[s] = true;
+                    t.index[s] = i;
+                }
+            }
+            if (!fits) return t;
+        }
+        t.complete = true;
+        return t;
+    }
+}
+
+#endif // IOHC_PERFECT_HASH_H
@@ -0,0 +1,111 @@
+#ifndef IOHC_PUBLISHER_H
+#define IOHC_PUBLISHER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcPacket.h>
+#include <iohcSpscRing.h>
+#include <iohcFrameJson.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+
+// Frames waiting for the publisher task. Must be a power of two.
+#ifndef IOHC_PUBLISH_QUEUE_SIZE
+    #define IOHC_PUBLISH_QUEUE_SIZE 32
+#endif
+// Max frames per published message
+#ifndef IOHC_PUBLISH_BATCH_MAX
+    #define IOHC_PUBLISH_BATCH_MAX 8
+#endif
+// Time the first frame of a batch waits for company
+#ifndef IOHC_PUBLISH_BATCH_MS
+    #define IOHC_PUBLISH_BATCH_MS 50
+#endif
+// Largest report built on the publisher task, see report()
+#ifndef IOHC_PUBLISH_REPORT_SIZE
+    #define IOHC_PUBLISH_REPORT_SIZE 3072
+#endif
+// Identical frames inside this window are published once (1W remotes resend every ~140 ms)
+#ifndef IOHC_PUBLISH_DEDUP_MS
+    #define IOHC_PUBLISH_DEDUP_MS 500
+#endif
+
+namespace IOHC {
+    /**
+     * Publisher stage between the dispatch task and the broker.
+     * Retransmissions are coalesced, frames are batched into one JSON array per message and the radio
+     * side never waits: when the broker is slow the queue fills up and new frames are dropped and counted.
+     * Periodic reports (stats) go through the same task, so the broker client is only called from it.
+     */
+    class iohcPublisher {
+    public:
+        // Returns false when the message could not be handed to the broker, it is retried later
+        using publishFunc = bool (*)(const char *topic, const char *payload, size_t len);
+        // Writes a report into out, its length or 0 when it does not fit
+        using buildFunc = size_t (*)(char *out, size_t size);
+
+        static iohcPublisher *getInstance();
+        virtual ~iohcPublisher() = default;
+
+        bool start(publishFunc publish, const char *topic, BaseType_t core = IOHC_PUBLISH_TASK_CORE,
+                   UBaseType_t priority = IOHC_PUBLISH_TASK_PRIORITY, uint32_t stackSize = IOHC_PUBLISH_TASK_STACK);
+        // Single producer: the dispatch task
+        bool offer(const iohcPacket *iohc);
+        void setDedupWindow(uint32_t ms) { _dedupUs = (int64_t) ms * 1000; }
+        // Any task: build runs on the publisher task and its output is published to topic.
+        // One report pending at a time, a newer one replaces it.
+        void report(const char *topic, buildFunc build);
+
+        uint32_t published() const { return _published.load(std::memory_order_relaxed); }
+        uint32_t coalesced() const { return _coalesced.load(std::memory_order_relaxed); }
+        uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+        uint32_t messages() const { return _messages.load(std::memory_order_relaxed); }
+        void dump() const;
+
+    private:
+        iohcPublisher() = default;
+        static iohcPublisher *_iohcPublisher;
+        static void task(void *arg);
+        bool isRepeat(const iohcPacket *iohc, int64_t now);
+        void flush();
+        void flushReport();
+
+        struct entry {
+            uint16_t len;
+            char json[frameJsonMaxSize()];
+        };
+        struct recent {
+            uint32_t key;
+            int64_t stamp;
+        };
+
+        spscRing<entry, IOHC_PUBLISH_QUEUE_SIZE> _queue;
+        recent _recent[8]{};
+        uint8_t _nextRecent = 0;
+        int64_t _dedupUs = (int64_t) IOHC_PUBLISH_DEDUP_MS * 1000;
+
+        // Batch being built or waiting for the broker: "[" + entries + "]"
+        char _batch[2 + IOHC_PUBLISH_BATCH_MAX * (frameJsonMaxSize() + 1)];
+        size_t _batchLen = 0;
+        uint8_t _batchCount = 0;
+
+        publishFunc _publish = nullptr;
+        const char *_topic = nullptr;
+        std::atomic<const char *> _reportTopic{nullptr};
+        std::atomic<buildFunc> _reportBuild{nullptr};
+        char _report[IOHC_PUBLISH_REPORT_SIZE];
+        TaskHandle_t _task = nullptr;
+        std::atomic<uint32_t> _published{0};
+        std::atomic<uint32_t> _coalesced{0};
+        std::atomic<uint32_t> _dropped{0};
+        std::atomic<uint32_t> _messages{0};
+    };
+}
+
+#endif // IOHC_PUBLISHER_H
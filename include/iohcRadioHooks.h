@@ -0,0 +1,38 @@
+#ifndef IOHC_RADIO_HOOKS_H
+#define IOHC_RADIO_HOOKS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Preamble sent in front of every frame (docs/LinkLayer.md) and bit rate
+#ifndef IOHC_PREAMBLE_BITS
+    #define IOHC_PREAMBLE_BITS 256
+#endif
+#ifndef IOHC_BITRATE
+    #define IOHC_BITRATE 38400
+#endif
+
+namespace IOHC {
+    // Preamble, then sync, frame and CRC bytes sent with a start and a stop bit
+    constexpr uint32_t frameAirtimeUs(size_t length) {
+        return (uint64_t(IOHC_PREAMBLE_BITS) + (2 + length + 2) * 10) * 1000000 / IOHC_BITRATE;
+    }
+
+    /**
+     * Transceiver operations the gateway stages need beyond iohcRadio::send/start.
+     * Filled by the board code for the fitted transceiver, any hook left null disables the matching feature.
+     */
+    struct iohcRadioHooks {
+        // Instant RSSI in dBm on frequency, the receiver returns to its scan list afterwards
+        float (*readRssi)(uint32_t frequency) = nullptr;
+        // Transceiver to sleep, and back to the receive scan set up by iohcRadio::start
+        void (*sleep)() = nullptr;
+        void (*resume)() = nullptr;
+        // Preamble detector armed on frequency for windowUs, true when a preamble was seen
+        bool (*detectPreamble)(uint32_t frequency, uint32_t windowUs) = nullptr;
+        // True while the transceiver is still sending, without it the frames air time is waited
+        bool (*txBusy)() = nullptr;
+    };
+}
+
+#endif // IOHC_RADIO_HOOKS_H
@@ -0,0 +1,53 @@
+#ifndef IOHC_RADIO_SET_H
+#define IOHC_RADIO_SET_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <board-config.h>
+#include <iohcPacket.h>
+#include <iohcRxPipeline.h>
+
+namespace IOHC {
+    /**
+     * Extra transceiver of the board, parked on one io-homecontrol channel (separate SPI chip select).
+     * Board code fills IOHC_RADIO_PORTS in board-config.h with one entry per extra radio.
+     */
+    struct iohcRadioPort {
+        uint32_t frequency;
+        // Starts continuous RX on frequency, received frames go to rxCallback
+        bool (*start)(uint32_t frequency, bool (*rxCallback)(iohcPacket *iohc));
+        void (*send)(std::vector<iohcPacket *> &packets);
+    };
+
+    /**
+     * Radios of the gateway. Radio 0 is iohcRadio, scanning its frequency list (leave out the channels owned
+     * by the other radios). Each radio feeds its own RX ring, frames are sent by the radio owning their channel.
+     */
+    class iohcRadioSet {
+    public:
+        static iohcRadioSet *getInstance();
+        virtual ~iohcRadioSet() = default;
+
+        bool add(const iohcRadioPort &port);
+        // Starts the extra radios, after iohcRadio::start
+        bool start();
+        // Radio owning the channel, 0 when no extra radio is parked there
+        uint8_t owner(uint32_t frequency) const;
+        void send(std::vector<iohcPacket *> &packets);
+        size_t size() const { return _count; }
+        void dump() const;
+
+    private:
+        iohcRadioSet() = default;
+        static iohcRadioSet *_iohcRadioSet;
+
+        iohcRadioPort _ports[IOHC_RADIO_COUNT]{}; // Entry 0 unused, iohcRadio
+        size_t _count = 1;
+        std::atomic<uint32_t> _sent[IOHC_RADIO_COUNT]{};
+    };
+}
+
+#endif // IOHC_RADIO_SET_H
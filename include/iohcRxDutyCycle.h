@@ -0,0 +1,122 @@
+#ifndef IOHC_RX_DUTY_CYCLE_H
+#define IOHC_RX_DUTY_CYCLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcPacket.h>
+#include <iohcRadioHooks.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+
+// Transceiver sleep to RX ready, and preamble detector window per channel
+#ifndef IOHC_DUTY_WAKE_US
+    #define IOHC_DUTY_WAKE_US 300
+#endif
+#ifndef IOHC_DUTY_DETECT_US
+    #define IOHC_DUTY_DETECT_US 500
+#endif
+// Full RX kept after a detection, ended early by the frame
+#ifndef IOHC_DUTY_HOLD_MS
+    #define IOHC_DUTY_HOLD_MS 30
+#endif
+// Full RX kept after a transmission, for the answer of the device
+#ifndef IOHC_DUTY_TX_HOLD_MS
+    #define IOHC_DUTY_TX_HOLD_MS 100
+#endif
+// Used when the board has no preamble detector hook
+#ifndef IOHC_DUTY_RSSI_DBM
+    #define IOHC_DUTY_RSSI_DBM -90
+#endif
+// Current estimate, SX127x datasheet values
+#ifndef IOHC_RADIO_RX_UA
+    #define IOHC_RADIO_RX_UA 11500
+#endif
+#ifndef IOHC_RADIO_SLEEP_UA
+    #define IOHC_RADIO_SLEEP_UA 1
+#endif
+// 1W remotes whose sequence numbers are followed to count missed frames
+#ifndef IOHC_DUTY_REMOTES
+    #define IOHC_DUTY_REMOTES 16
+#endif
+
+namespace IOHC {
+    /**
+     * Duty cycled reception: the transceiver sleeps and wakes often enough to catch any preamble on every
+     * scanned channel, stays in full RX only when a preamble is detected and goes back to sleep otherwise.
+     * The task sleeps on the scheduler in between, so with power management enabled the ESP32 light sleeps too.
+     * The TX queue keeps the receiver on for a while after each transmission, and open 2W sessions keep it on
+     * until they close or time out, so the answers they wait for are not slept through.
+     * Needs the sleep, resume and detectPreamble (or readRssi) radio hooks.
+     */
+    class iohcRxDutyCycle {
+    public:
+        static iohcRxDutyCycle *getInstance();
+        virtual ~iohcRxDutyCycle() = default;
+
+        static constexpr uint32_t preambleUs() { return (uint64_t) IOHC_PREAMBLE_BITS * 1000000 / IOHC_BITRATE; }
+        // Sleep between two sniffs so that a preamble starting right after a sniff is still caught by the next one
+        static constexpr uint32_t sleepUs(size_t channels) {
+            return preambleUs() > IOHC_DUTY_WAKE_US + channels * IOHC_DUTY_DETECT_US
+                       ? preambleUs() - IOHC_DUTY_WAKE_US - channels * IOHC_DUTY_DETECT_US : 0;
+        }
+
+        void setHooks(const iohcRadioHooks &hooks) { _hooks = hooks; }
+        bool start(const uint32_t *frequencies, size_t count, BaseType_t core = IOHC_DUTY_TASK_CORE,
+                   UBaseType_t priority = IOHC_DUTY_TASK_PRIORITY, uint32_t stackSize = IOHC_DUTY_TASK_STACK);
+        // False when the hooks are missing or the preamble is too short for the channel count
+        bool enable(bool on);
+        bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+        // Dispatch task, every received frame
+        void received(const iohcPacket *iohc);
+        // Full RX for at least ms from now, after a transmission
+        void awake(uint32_t ms);
+        // Full RX while on, for the open 2W sessions
+        void hold(bool on);
+        void dump() const;
+
+    private:
+        iohcRxDutyCycle() = default;
+        static iohcRxDutyCycle *_iohcRxDutyCycle;
+        static void task(void *arg);
+        bool sniff();
+        bool keptAwake() const;
+        void track1W(const iohcPacket *iohc);
+
+        struct remote {
+            uint8_t address[3];
+            uint16_t sequence;
+            bool used;
+        };
+
+        iohcRadioHooks _hooks;
+        const uint32_t *_frequencies = nullptr;
+        size_t _channels = 0;
+        TaskHandle_t _task = nullptr;
+        std::atomic<bool> _enabled{false};
+        std::atomic<bool> _holding{false};
+        std::atomic<bool> _held{false};
+        std::atomic<int64_t> _awakeUntil{0};
+
+        remote _remotes[IOHC_DUTY_REMOTES]{};
+        uint8_t _nextRemote = 0;
+
+        // Time per radio state, written by the duty task and read by dump()
+        std::atomic<uint64_t> _sleepUs{0};
+        std::atomic<uint64_t> _detectUs{0};
+        std::atomic<uint64_t> _rxUs{0};
+        std::atomic<uint32_t> _wakeups{0};
+        std::atomic<uint32_t> _detections{0};
+        std::atomic<uint32_t> _falseWakes{0}; // Detection without frame
+        std::atomic<uint32_t> _frames{0};
+        std::atomic<uint32_t> _commands{0}; // Distinct 1W sequence numbers received
+        std::atomic<uint32_t> _missed{0}; // 1W sequence numbers never received
+    };
+}
+
+#endif // IOHC_RX_DUTY_CYCLE_H
@@ -0,0 +1,100 @@
+#ifndef IOHC_RX_PIPELINE_H
+#define IOHC_RX_PIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <board-config.h>
+#include <iohcFrame.h>
+#include <iohcPacket.h>
+#include <iohcSpscRing.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+
+// Number of frames buffered between the radio and the dispatch task. Must be a power of two.
+#ifndef IOHC_RX_QUEUE_SIZE
+    #define IOHC_RX_QUEUE_SIZE 16
+#endif
+// Transceivers feeding the pipeline, one ring each (board-config.h, see iohcRadioSet.h)
+#ifndef IOHC_RADIO_COUNT
+    #define IOHC_RADIO_COUNT 1
+#endif
+// The same frame heard by two radios within this window is dispatched once
+#ifndef IOHC_RX_DEDUP_US
+    #define IOHC_RX_DEDUP_US 20000
+#endif
+
+namespace IOHC {
+    /**
+     * Receive pipeline: the radio callback only copies the frame into the ring of its radio as a 48 bytes
+     * iohcRxRecord, a pinned task drains the rings and runs the command dispatch.
+     * With several radios a frame also heard on another radio is dropped as duplicate.
+     */
+    class iohcRxPipeline {
+    public:
+        using dispatchFunc = bool (*)(iohcPacket *iohc);
+
+        static iohcRxPipeline *getInstance();
+        virtual ~iohcRxPipeline() = default;
+
+        bool start(dispatchFunc dispatch, BaseType_t core = IOHC_RX_TASK_CORE,
+                   UBaseType_t priority = IOHC_RX_TASK_PRIORITY, uint32_t stackSize = IOHC_RX_TASK_STACK);
+        // One producer per radio
+        bool IRAM_ATTR enqueue(const iohcPacket *iohc, uint8_t radio = 0);
+        // Frames are queued but not dispatched until release(), while the device handlers load
+        void hold() { _held.store(true, std::memory_order_release); }
+        void release();
+
+        // esp_timer stamp of the first frame queued since boot, 0 until then
+        int64_t firstRx() const { return _firstRx.load(std::memory_order_relaxed); }
+
+        size_t depth() const;
+        size_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+        uint32_t received() const { return _received.load(std::memory_order_relaxed); }
+        uint32_t overflows() const { return _overflows.load(std::memory_order_relaxed); }
+        uint32_t duplicates() const { return _duplicates.load(std::memory_order_relaxed); }
+        // Dispatch task only: record of the frame being dispatched
+        const iohcRxRecord *current() const { return _current; }
+        static constexpr size_t capacity() { return IOHC_RX_QUEUE_SIZE * IOHC_RADIO_COUNT; }
+        void dump() const;
+
+    private:
+        iohcRxPipeline() = default;
+        static iohcRxPipeline *_iohcRxPipeline;
+        static void task(void *arg);
+        bool duplicate(const iohcRxRecord &record);
+
+        struct recent {
+            uint32_t hash;
+            int64_t stamp;
+            uint8_t radio;
+        };
+
+        spscRing<iohcRxRecord, IOHC_RX_QUEUE_SIZE> _rings[IOHC_RADIO_COUNT];
+        iohcPacket _packet{}; // Handlers get the frame back as a packet, rebuilt here from the record
+        const iohcRxRecord *_current = nullptr;
+        recent _recent[4]{};
+        uint8_t _nextRecent = 0;
+        dispatchFunc _dispatch = nullptr;
+        TaskHandle_t _task = nullptr;
+        std::atomic<bool> _held{false};
+        std::atomic<int64_t> _firstRx{0};
+        std::atomic<size_t> _highWater{0};
+        std::atomic<uint32_t> _received{0};
+        std::atomic<uint32_t> _overflows{0};
+        std::atomic<uint32_t> _duplicates{0};
+    };
+
+    // Radio callback feeding the ring of one radio
+    template<uint8_t radio>
+    bool IRAM_ATTR rxEnqueueOn(iohcPacket *iohc) {
+        return iohcRxPipeline::getInstance()->enqueue(iohc, radio);
+    }
+}
+
+#endif // IOHC_RX_PIPELINE_H
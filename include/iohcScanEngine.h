@@ -0,0 +1,105 @@
+#ifndef IOHC_SCAN_ENGINE_H
+#define IOHC_SCAN_ENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcPacket.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+    #include "freertos/semphr.h"
+}
+
+#ifndef IOHC_SCAN_FILE
+    #define IOHC_SCAN_FILE "/scan.bin"
+#endif
+// Devices probed in parallel, one command in flight per device
+#ifndef IOHC_SCAN_TARGETS
+    #define IOHC_SCAN_TARGETS 4
+#endif
+// Time a device has to answer a probe
+#ifndef IOHC_SCAN_TIMEOUT_MS
+    #define IOHC_SCAN_TIMEOUT_MS 300
+#endif
+// Probes between two checkpoints
+#ifndef IOHC_SCAN_CHECKPOINT
+    #define IOHC_SCAN_CHECKPOINT 16
+#endif
+#ifndef IOHC_SCAN_TICK_MS
+    #define IOHC_SCAN_TICK_MS 10
+#endif
+
+namespace IOHC {
+    struct __attribute__((packed)) iohcScanTarget {
+        uint8_t address[3];
+        uint8_t nextCmd;       // Next command ID to probe
+        uint8_t done;          // All 256 command IDs probed
+        uint8_t answer[256];   // Answer command per probed ID (0x3C challenge, error code for 0xFE)
+        uint8_t tested[32];    // Bitmaps by command ID
+        uint8_t answered[32];
+    };
+
+    /**
+     * Command discovery without lastSendCmd: one probe in flight per target device, several devices
+     * probed at once, answers matched by source address and the pending command of that source.
+     * Progress is checkpointed to IOHC_SCAN_FILE so resume() continues an interrupted sweep, written by the
+     * scan task through a temporary file. A probe times out IOHC_SCAN_TIMEOUT_MS after the radio sent it.
+     */
+    class iohcScanEngine {
+    public:
+        static iohcScanEngine *getInstance();
+        virtual ~iohcScanEngine() = default;
+
+        // gateway is the probes source address, targets are 3 bytes addresses
+        bool start(const uint8_t *gateway, const uint8_t (*targets)[3], size_t count, uint32_t frequency);
+        bool resume(uint32_t frequency);
+        void stop();
+        bool running() const { return _running.load(std::memory_order_relaxed); }
+        // True while address is being probed, its challenges must not be answered
+        bool scanning(const uint8_t *address);
+        void received(const iohcPacket *iohc);
+        void dump();
+
+    private:
+        iohcScanEngine() = default;
+        static iohcScanEngine *_iohcScanEngine;
+        static void task(void *arg);
+        static void sent(const iohcPacket *frame, void *arg);
+
+        struct probe {
+            bool pending;
+            uint8_t cmd;
+            int64_t sentAt; // 0 while still queued for the radio
+        };
+
+        bool launch();
+        void step();
+        bool send(size_t target, uint8_t cmd);
+        void record(size_t target, uint8_t cmd, bool answered, uint8_t answer);
+        // Scan task, outside _lock: writes the copy taken in _saved
+        bool checkpoint(size_t count);
+        bool load();
+
+        uint8_t _gateway[3];
+        iohcScanTarget _targets[IOHC_SCAN_TARGETS];
+        probe _probes[IOHC_SCAN_TARGETS];
+        size_t _count = 0;
+        uint32_t _frequency = 0;
+        uint32_t _sinceCheckpoint = 0;
+        bool _flush = false; // Checkpoint at the next task round whatever _sinceCheckpoint
+        iohcScanTarget _saved[IOHC_SCAN_TARGETS];
+        uint8_t _savedGateway[3];
+        std::atomic<bool> _running{false};
+        SemaphoreHandle_t _lock = nullptr;
+        TaskHandle_t _task = nullptr;
+        std::atomic<uint32_t> _sent{0};
+        std::atomic<uint32_t> _answers{0};
+        std::atomic<uint32_t> _silent{0};
+    };
+}
+
+#endif // IOHC_SCAN_ENGINE_H
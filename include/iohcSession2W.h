@@ -0,0 +1,126 @@
+#ifndef IOHC_SESSION_2W_H
+#define IOHC_SESSION_2W_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <esp_timer.h>
+#include <iohcPacket.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/semphr.h"
+    #include "freertos/task.h"
+}
+
+// 2W exchanges in flight at once
+#ifndef IOHC_SESSION_COUNT
+    #define IOHC_SESSION_COUNT 16
+#endif
+// Memorized command parameters kept per session, longer ones are cut and counted
+#define IOHC_SESSION_MAX_DATA 21
+// Time a peer has to answer before the command is sent again
+#ifndef IOHC_SESSION_TIMEOUT_MS
+    #define IOHC_SESSION_TIMEOUT_MS 500
+#endif
+#ifndef IOHC_SESSION_RETRIES
+    #define IOHC_SESSION_RETRIES 2
+#endif
+// Timer wheel resolution and size, timeouts longer than one turn wait extra rounds
+#ifndef IOHC_SESSION_TICK_MS
+    #define IOHC_SESSION_TICK_MS 20
+#endif
+#define IOHC_SESSION_WHEEL_SLOTS 32
+
+namespace IOHC {
+    struct iohcSession {
+        enum state_t : uint8_t { free, sent, challenged };
+
+        uint8_t peer[3];
+        state_t state = free;
+        uint8_t cmd;
+        uint8_t data[IOHC_SESSION_MAX_DATA];
+        uint8_t dataLen;
+        uint8_t challenge[6];
+        uint8_t retries;  // Left, only with a frame to resend
+        int64_t opened;
+        int64_t lastActivity;
+        iohcPacket frame; // Resent on timeout while retries remain
+        // Timer wheel
+        uint8_t next;
+        uint8_t slot;
+        uint16_t rounds;
+    };
+
+    /**
+     * 2W exchanges keyed by peer address: memorized command and data, last challenge, timestamps and
+     * retry budget for every device we talk to, so answers to several devices can be pipelined.
+     * Timeouts run on a wheel: the esp_timer only wakes the session task, which resends the command to a
+     * peer silent past IOHC_SESSION_TIMEOUT_MS while retries remain, then closes the session. The timer
+     * runs only while a session is open.
+     */
+    class iohcSession2W {
+    public:
+        static iohcSession2W *getInstance();
+        virtual ~iohcSession2W() = default;
+
+        bool start(BaseType_t core = IOHC_SESSION_TASK_CORE, UBaseType_t priority = IOHC_SESSION_TASK_PRIORITY,
+                   uint32_t stackSize = IOHC_SESSION_TASK_STACK);
+        // frame is copied and resent on timeout, nullptr to only keep the context (no retries then).
+        // A full table drops the least recently active exchange, or fails without evict.
+        bool open(const uint8_t *peer, uint8_t cmd, const uint8_t *data, size_t len, const iohcPacket *frame = nullptr,
+                  uint8_t retries = IOHC_SESSION_RETRIES, bool evict = true);
+        // Updates the memorized command of an open session, opens one otherwise
+        void remember(const uint8_t *peer, uint8_t cmd, const uint8_t *data, size_t len);
+        // Records the challenge and writes the command ID followed by its data, as hashed for the answer.
+        // ivData holds 1 + IOHC_SESSION_MAX_DATA bytes.
+        bool challenge(const uint8_t *peer, const uint8_t *challenge, uint8_t *ivData, size_t &len);
+        // The peer answer to the memorized command (command + 1, or 0xFE refused) ends its exchange
+        void received(const iohcPacket *iohc);
+        void close(const uint8_t *peer);
+
+        size_t size();
+        void dump();
+
+    private:
+        iohcSession2W() = default;
+        static iohcSession2W *_iohcSession2W;
+        static constexpr uint8_t none = 0xFF;
+
+        // Bytes of len kept in a session, warns when parameters are cut
+        size_t keep(const uint8_t *peer, uint8_t cmd, size_t len);
+
+        static void tick(void *arg);
+        static void task(void *arg);
+        void advance(uint32_t ticks);
+        // Under _lock
+        void wake();
+        iohcSession *find(const uint8_t *peer);
+        void arm(uint8_t index, uint32_t timeoutMs);
+        void disarm(uint8_t index);
+        void release(uint8_t index);
+
+        iohcSession _sessions[IOHC_SESSION_COUNT];
+        uint8_t _wheel[IOHC_SESSION_WHEEL_SLOTS];
+        uint8_t _cursor = 0;
+        size_t _open = 0;
+        bool _ticking = false;
+        esp_timer_handle_t _timer = nullptr;
+        SemaphoreHandle_t _lock = nullptr;
+        TaskHandle_t _task = nullptr;
+        // Frames to resend, copied out of the sessions so the TX queue is called without _lock
+        iohcPacket _resend[IOHC_SESSION_COUNT];
+        std::atomic<uint32_t> _opened{0};
+        std::atomic<uint32_t> _completed{0};
+        std::atomic<uint32_t> _retried{0};
+        std::atomic<uint32_t> _timedOut{0};
+        std::atomic<uint32_t> _full{0};
+        std::atomic<uint32_t> _refused{0}; // Table full, opened without evict
+        std::atomic<uint32_t> _truncated{0}; // Parameters past IOHC_SESSION_MAX_DATA, the answer MAC will be wrong
+    };
+}
+
+#endif // IOHC_SESSION_2W_H
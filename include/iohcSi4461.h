@@ -0,0 +1,64 @@
+#ifndef IOHC_SI4461_H
+#define IOHC_SI4461_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <driver/spi_master.h>
+
+#include <iohcSi4461Config.h>
+
+#ifndef IOHC_SI4461_SPI_HOST
+    #define IOHC_SI4461_SPI_HOST SPI2_HOST
+#endif
+// Si446x SPI runs up to 10 MHz
+#ifndef IOHC_SI4461_SPI_HZ
+    #define IOHC_SI4461_SPI_HZ 10000000
+#endif
+// Longest CTS wait, POWER_UP and IRCAL are the slow ones
+#ifndef IOHC_SI4461_CTS_US
+    #define IOHC_SI4461_CTS_US 50000
+#endif
+
+namespace IOHC {
+    /**
+     * Si4461 transceiver, as in the CozyTouch boxes. The WDS configuration extracted from their firmware
+     * (scripts/IDAPro/Somfy-CozyTouch-Si4461-RadioConfig.h) is compiled into merged SET_PROPERTY bursts
+     * at build time, together with the FREQ_CONTROL writes between the three io-homecontrol channels.
+     * Commands go out of a DMA capable buffer filled once by begin(), each padded to a word.
+     * Not locked, call from one task.
+     */
+    class iohcSi4461 {
+    public:
+        static iohcSi4461 *getInstance();
+        virtual ~iohcSi4461() = default;
+
+        // Reset through SDN and run the init table, the radio ends in RX on the channel of the table
+        bool begin(spi_host_device_t host, int sck, int miso, int mosi, int nsel, int sdn);
+        // Writes the FREQ_CONTROL bytes differing from the current channel and restarts RX
+        bool retune(uint32_t frequency);
+        bool startRx();
+        uint32_t frequency() const { return _frequency; }
+        void dump() const;
+
+    private:
+        iohcSi4461() = default;
+        static iohcSi4461 *_iohcSi4461;
+
+        bool waitCts();
+        // len bytes at offset in the DMA buffer, once the previous command released CTS
+        bool send(size_t offset, size_t len);
+
+        spi_device_handle_t _spi = nullptr;
+        uint8_t *_dma = nullptr;
+        size_t _channel = 0;
+        uint32_t _frequency = 0;
+        uint32_t _bringUpUs = 0;
+        std::atomic<uint32_t> _hops{0};
+        std::atomic<uint32_t> _fullWrites{0};
+        std::atomic<uint32_t> _ctsTimeouts{0};
+    };
+}
+
+#endif // IOHC_SI4461_H
@@ -0,0 +1,251 @@
+#ifndef IOHC_SI4461_CONFIG_H
+#define IOHC_SI4461_CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Properties of the chip state not written in a burst, but rewritten to join two bursts: a command costs
+// 5 more bytes and one more CTS wait
+#ifndef IOHC_SI4461_JOIN_GAP
+    #define IOHC_SI4461_JOIN_GAP 4
+#endif
+
+namespace IOHC {
+    // Si446x API commands (AN625)
+    static constexpr uint8_t si4461Nop = 0x00;
+    static constexpr uint8_t si4461PowerUp = 0x02;
+    static constexpr uint8_t si4461SetProperty = 0x11;
+    static constexpr uint8_t si4461StartRx = 0x32;
+    static constexpr uint8_t si4461ReadCmdBuff = 0x44;
+    // 16 byte command buffer: SET_PROPERTY, group, count, start and up to 12 values
+    static constexpr size_t si4461MaxCommand = 16;
+    static constexpr size_t si4461MaxProperties = si4461MaxCommand - 4;
+    static constexpr uint8_t si4461GroupModem = 0x20;
+    static constexpr uint8_t si4461ModemClkgenBand = 0x51;
+    static constexpr uint8_t si4461GroupFreqControl = 0x40;
+
+    // FREQ_CONTROL_INTE and FRAC_2..0
+    struct si4461FreqControl {
+        uint8_t bytes[4]{};
+
+        constexpr bool operator==(const si4461FreqControl &o) const {
+            return bytes[0] == o.bytes[0] && bytes[1] == o.bytes[1] && bytes[2] == o.bytes[2] && bytes[3] == o.bytes[3];
+        }
+    };
+
+    /**
+     * PLL setting of a frequency: f = (INTE + FRAC / 2^19) * NPRESC * XO / OUTDIV, with FRAC in [2^19, 2^20)
+     * as WDS writes it. NPRESC and OUTDIV come from MODEM_CLKGEN_BAND.
+     */
+    constexpr si4461FreqControl si4461Frequency(uint32_t frequency, uint32_t xo, uint8_t clkgenBand) {
+        constexpr uint8_t outdivs[] = {4, 6, 8, 12, 16, 24, 24, 24};
+        const uint64_t divider = uint64_t(clkgenBand & 0x08 ? 2 : 4) * xo;
+        // Truncated, as WDS does
+        const uint64_t fc = (uint64_t(frequency) * outdivs[clkgenBand & 0x07] << 19) / divider;
+        const uint32_t inte = uint32_t(fc >> 19) - 1;
+        const uint32_t frac = uint32_t(fc - (uint64_t(inte) << 19));
+        return {{uint8_t(inte), uint8_t(frac >> 16), uint8_t(frac >> 8), uint8_t(frac)}};
+    }
+
+    /**
+     * Init sequence in the WDS layout: a length byte then the command, ending on a 0 length.
+     * bytes holds size used bytes, the other members describe the chip state once it ran.
+     */
+    template<size_t N>
+    struct si4461Table {
+        uint8_t bytes[N]{};
+        size_t size = 0;
+        size_t commands = 0;
+        size_t properties = 0;
+        // Each command padded to 4 bytes, for word aligned DMA transfers
+        size_t aligned = 0;
+        uint32_t xo = 0;
+        uint8_t clkgenBand = 0;
+        si4461FreqControl freqControl{};
+        bool valid = true;
+    };
+
+    /**
+     * Rewrites a WDS configuration array (RADIO_CONFIGURATION_DATA_ARRAY) with as few SET_PROPERTY commands
+     * as possible. The properties set between two other commands are collected, later values override
+     * earlier ones, values the chip already holds are dropped and the rest goes out in bursts of up to
+     * 12 adjacent properties, group by group. Other commands stay in place, so the image rejection
+     * calibration still runs on the properties set before it. NOP commands are dropped.
+     */
+    template<size_t N>
+    constexpr si4461Table<N> si4461Compile(const uint8_t (&wds)[N]) {
+        constexpr size_t groupCount = 16;
+        constexpr size_t propertyCount = 128;
+        struct property {
+            uint8_t value = 0;
+            bool known = false; // Chip state
+            bool dirty = false; // To write before the next command
+        };
+
+        si4461Table<N> t{};
+        uint8_t groups[groupCount]{};
+        size_t groupsUsed = 0;
+        property state[groupCount][propertyCount]{};
+
+        auto emit = [&](const uint8_t *command, size_t len) -> void {
+            if (t.size + len + 2 > N) {
+                t.valid = false;
+                return;
+            }
+            t.bytes[t.size++] = len;
+            for (size_t i = 0; i < len; i++) t.bytes[t.size++] = command[i];
+            t.commands++;
+            t.aligned += (len + 3) & ~size_t(3);
+        };
+        auto flush = [&]() -> void {
+            for (size_t g = 0; g < groupsUsed; g++) {
+                property *p = state[g];
+                size_t at = 0;
+                while (at < propertyCount) {
+                    if (!p[at].dirty) {
+                        at++;
+                        continue;
+                    }
+                    // Longest burst from at, through known gaps when a dirty property follows them
+                    size_t end = at + 1;
+                    for (size_t q = at + 1; q < propertyCount && q - at < si4461MaxProperties; q++) {
+                        if (p[q].dirty) end = q + 1;
+                        else if (!p[q].known || q + 1 - end > IOHC_SI4461_JOIN_GAP) break;
+                    }
+                    uint8_t command[si4461MaxCommand]{si4461SetProperty, groups[g], uint8_t(end - at), uint8_t(at)};
+                    for (size_t q = at; q < end; q++) {
+                        command[4 + q - at] = p[q].value;
+                        p[q].dirty = false;
+                    }
+                    emit(command, 4 + end - at);
+                    t.properties += end - at;
+                    at = end;
+                }
+            }
+        };
+
+        size_t at = 0;
+        while (at < N && wds[at]) {
+            const size_t len = wds[at];
+            const uint8_t *command = &wds[at + 1];
+            at += len + 1;
+            if (at > N || len > si4461MaxCommand) {
+                t.valid = false;
+                break;
+            }
+            if (command[0] == si4461Nop) continue;
+            if (command[0] != si4461SetProperty) {
+                flush();
+                emit(command, len);
+                if (command[0] == si4461PowerUp && len >= 7) {
+                    // Chip back to its defaults, XO frequency big endian
+                    for (auto &group : state)
+                        for (property &p : group) p = {};
+                    t.xo = uint32_t(command[3]) << 24 | uint32_t(command[4]) << 16 | uint32_t(command[5]) << 8 | command[6];
+                }
+                continue;
+            }
+
+            const uint8_t count = command[2], start = command[3];
+            if (len < 4 || count != len - 4 || count > si4461MaxProperties || start + count > propertyCount) {
+                t.valid = false;
+                break;
+            }
+            size_t g = 0;
+            while (g < groupsUsed && groups[g] != command[1]) g++;
+            if (g == groupsUsed) {
+                if (groupsUsed == groupCount) {
+                    t.valid = false;
+                    break;
+                }
+                groups[groupsUsed++] = command[1];
+            }
+            for (uint8_t i = 0; i < count; i++) {
+                property &p = state[g][start + i];
+                const uint8_t value = command[4 + i];
+                // Once dirty in this round it stays so, the chip value is no longer kept
+                p.dirty = !p.known || p.value != value || p.dirty;
+                p.value = value;
+                p.known = true;
+            }
+        }
+        flush();
+        if (t.size >= N) t.valid = false;
+        else t.bytes[t.size++] = 0;
+
+        for (size_t g = 0; g < groupsUsed; g++) {
+            if (groups[g] == si4461GroupModem) t.clkgenBand = state[g][si4461ModemClkgenBand].value;
+            if (groups[g] == si4461GroupFreqControl)
+                for (size_t i = 0; i < 4; i++) t.freqControl.bytes[i] = state[g][i].value;
+        }
+        return t;
+    }
+
+    // Same table in exactly the bytes it uses, for flash
+    template<size_t Size, size_t N>
+    constexpr si4461Table<Size> si4461Trim(const si4461Table<N> &in) {
+        si4461Table<Size> t{};
+        for (size_t i = 0; i < Size && i < in.size; i++) t.bytes[i] = in.bytes[i];
+        t.size = in.size;
+        t.commands = in.commands;
+        t.properties = in.properties;
+        t.aligned = in.aligned;
+        t.xo = in.xo;
+        t.clkgenBand = in.clkgenBand;
+        t.freqControl = in.freqControl;
+        t.valid = in.valid && in.size == Size;
+        return t;
+    }
+
+    // Shortest SET_PROPERTY moving FREQ_CONTROL from one channel to another: the bytes that differ
+    struct si4461Hop {
+        uint8_t command[4 + sizeof(si4461FreqControl)]{};
+        uint8_t len = 0;
+    };
+
+    constexpr si4461Hop si4461MakeHop(const si4461FreqControl &from, const si4461FreqControl &to, bool full) {
+        si4461Hop hop{};
+        size_t first = 0, last = sizeof(to.bytes);
+        if (!full) {
+            while (first < last && from.bytes[first] == to.bytes[first]) first++;
+            while (last > first && from.bytes[last - 1] == to.bytes[last - 1]) last--;
+        }
+        if (first == last) return hop;
+        hop.command[0] = si4461SetProperty;
+        hop.command[1] = si4461GroupFreqControl;
+        hop.command[2] = last - first;
+        hop.command[3] = first;
+        for (size_t i = first; i < last; i++) hop.command[4 + i - first] = to.bytes[i];
+        hop.len = 4 + last - first;
+        return hop;
+    }
+
+    /**
+     * Retune commands between the channels, row channels for an unknown current setting (full write).
+     * Converts with the XO and band of the init table.
+     */
+    template<size_t C>
+    struct si4461HopTable {
+        si4461FreqControl channels[C]{};
+        si4461Hop hops[C + 1][C]{};
+
+        // Channel holding this setting, C for none
+        constexpr size_t find(const si4461FreqControl &f) const {
+            size_t c = 0;
+            while (c < C && !(channels[c] == f)) c++;
+            return c;
+        }
+    };
+
+    template<size_t C, size_t N>
+    constexpr si4461HopTable<C> si4461MakeHops(const uint32_t (&frequencies)[C], const si4461Table<N> &table) {
+        si4461HopTable<C> t{};
+        for (size_t c = 0; c < C; c++) t.channels[c] = si4461Frequency(frequencies[c], table.xo, table.clkgenBand);
+        for (size_t from = 0; from <= C; from++)
+            for (size_t to = 0; to < C; to++)
+                t.hops[from][to] = si4461MakeHop(from < C ? t.channels[from] : si4461FreqControl{}, t.channels[to], from == C);
+        return t;
+    }
+}
+
+#endif // IOHC_SI4461_CONFIG_H
@@ -0,0 +1,90 @@
+#ifndef IOHC_SNAPSHOT_H
+#define IOHC_SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <iohc1WAuth.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+
+#ifndef IOHC_SNAPSHOT_FILE
+    #define IOHC_SNAPSHOT_FILE "/snapshot.bin"
+#endif
+// Other changes are looked for this often, a learned key or an accepted sequence number is written right away
+#ifndef IOHC_SNAPSHOT_PERIOD_MS
+    #define IOHC_SNAPSHOT_PERIOD_MS 60000
+#endif
+
+namespace IOHC {
+    static constexpr uint16_t snapshotVersion = 1;
+
+    struct __attribute__((packed)) iohcSnapshotHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t sections;
+        uint32_t length;   // Bytes after the header
+        uint16_t crc;      // CRC-16/KERMIT of those bytes
+        uint16_t reserved;
+    };
+
+    enum class snapshotSection : uint16_t {
+        remotes1W = 1, // iohcRemoteState records
+    };
+
+    struct __attribute__((packed)) iohcSnapshotSection {
+        snapshotSection type;
+        uint16_t recordSize;
+        uint16_t count;
+        uint16_t reserved;
+    };
+
+    /**
+     * Binary boot snapshot of the receive path state that is otherwise only rebuilt from the air:
+     * learned 1W keys with their last sequence number. The paired 2W nodes and their keys come from
+     * the node index, itself a binary file read in one go.
+     * The file is read with a single call into a static buffer, checked and applied before the radio starts.
+     * Unknown sections are skipped and a version or CRC mismatch discards the whole file, so the
+     * gateway then starts as before and learns again. JSON is only an export, see exportJson().
+     */
+    class iohcSnapshot {
+    public:
+        static iohcSnapshot *getInstance();
+        virtual ~iohcSnapshot() = default;
+
+        bool load();
+        // Writer task, saves when the state changed
+        bool begin(BaseType_t core = IOHC_SNAPSHOT_TASK_CORE, UBaseType_t priority = IOHC_SNAPSHOT_TASK_PRIORITY,
+                   uint32_t stackSize = IOHC_SNAPSHOT_TASK_STACK);
+        // Wakes the writer, for changes that must not wait for the next period
+        void changed();
+        void exportJson();
+
+        bool loaded() const { return _loaded; }
+        uint32_t loadUs() const { return _loadUs; }
+        void dump();
+
+    private:
+        iohcSnapshot() = default;
+        static iohcSnapshot *_iohcSnapshot;
+        static void task(void *arg);
+        bool save();
+
+        TaskHandle_t _task = nullptr;
+        uint32_t _savedRevision = 0;
+        bool _loaded = false;
+        uint32_t _loadUs = 0;
+        uint32_t _size = 0;
+        uint16_t _remotes = 0;
+        std::atomic<bool> _pending{false};
+        std::atomic<uint32_t> _saves{0};
+        std::atomic<uint32_t> _failures{0};
+    };
+}
+
+#endif // IOHC_SNAPSHOT_H
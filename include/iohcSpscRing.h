@@ -0,0 +1,50 @@
+#ifndef IOHC_SPSC_RING_H
+#define IOHC_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+#if !defined(IRAM_ATTR)
+    #define IRAM_ATTR
+#endif
+
+namespace IOHC {
+    /**
+     * Lock-free single-producer / single-consumer ring.
+     * The producer fills a slot in place, the consumer reads it in place and releases it afterwards,
+     * so an entry is copied exactly once, by whoever fills it.
+     */
+    template<typename T, size_t N>
+    class spscRing {
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "spscRing size must be a power of two");
+
+    public:
+        // Producer side
+        T *IRAM_ATTR back() {
+            size_t head = _head.load(std::memory_order_relaxed);
+            if (head - _tail.load(std::memory_order_acquire) >= N) return nullptr;
+            return &_slots[head & (N - 1)];
+        }
+        void IRAM_ATTR push() { _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+        // Consumer side
+        T *front() {
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) return nullptr;
+            return &_slots[tail & (N - 1)];
+        }
+        void pop() { _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+        size_t size() const {
+            return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+        }
+        static constexpr size_t capacity() { return N; }
+
+    private:
+        T _slots[N]{};
+        std::atomic<size_t> _head{0};
+        std::atomic<size_t> _tail{0};
+    };
+}
+
+#endif // IOHC_SPSC_RING_H
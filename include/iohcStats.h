@@ -0,0 +1,111 @@
+#ifndef IOHC_STATS_H
+#define IOHC_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_timer.h>
+
+// Cores writing counters, one slot each so updates never contend
+#ifndef IOHC_STATS_CORES
+    #define IOHC_STATS_CORES 2
+#endif
+// Log2 latency buckets in us: bucket b holds [2^(b-1), 2^b), the last one everything above
+#ifndef IOHC_STATS_BUCKETS
+    #define IOHC_STATS_BUCKETS 18
+#endif
+// Period of the MQTT stats message
+#ifndef IOHC_STATS_PUBLISH_MS
+    #define IOHC_STATS_PUBLISH_MS 60000
+#endif
+
+namespace IOHC {
+    enum class statMetric : uint8_t {
+        rxToDispatch, // Radio callback to the dispatch task taking the frame, time spent in the RX ring
+        dispatch,     // Handler run time
+        answer,       // Handler start to a 2W answer handed to the radio
+        aes,          // AES work of the MAC and key helpers
+        count
+    };
+
+    /**
+     * Hot path counters: frames per command byte and log2 latency histograms.
+     * Every core updates its own slot with relaxed atomics, readers add the slots up,
+     * so a reading may mix values a few frames apart but never blocks a writer.
+     */
+    class iohcStats {
+    public:
+        static iohcStats *getInstance();
+        virtual ~iohcStats() = default;
+
+        void frame(uint8_t cmd) { slot().frames[cmd].fetch_add(1, std::memory_order_relaxed); }
+        void unknown() { slot().unknown.fetch_add(1, std::memory_order_relaxed); }
+        void record(statMetric metric, uint32_t us);
+        void since(statMetric metric, int64_t start) { record(metric, esp_timer_get_time() - start); }
+
+        // Dispatch task: start stamp of the frame being handled, 0 outside a handler
+        void dispatching(int64_t start) { _dispatchStart = start; }
+        int64_t dispatchStart() const { return _dispatchStart; }
+
+        uint32_t frames(uint8_t cmd) const;
+        uint32_t unknowns() const;
+        // Upper bound of the bucket holding the given percentile, in us
+        uint32_t percentile(statMetric metric, uint8_t pct) const;
+        void reset();
+        void dump() const;
+
+        // Hands the JSON summary to the iohcPublisher task every periodMs, the publisher must be started
+        bool startPublishing(const char *topic, uint32_t periodMs = IOHC_STATS_PUBLISH_MS);
+        size_t toJson(char *out, size_t size) const;
+
+    private:
+        iohcStats() = default;
+        static iohcStats *_iohcStats;
+        static void publishTimer(void *arg);
+        static size_t buildJson(char *out, size_t size);
+
+        static constexpr size_t metrics = static_cast<size_t>(statMetric::count);
+
+        struct histogram {
+            std::atomic<uint32_t> buckets[IOHC_STATS_BUCKETS];
+            std::atomic<uint32_t> count;
+            std::atomic<uint32_t> sum;
+            std::atomic<uint32_t> max;
+        };
+        struct perCore {
+            std::atomic<uint32_t> frames[256];
+            std::atomic<uint32_t> unknown;
+            histogram latency[metrics];
+        };
+
+        perCore &slot();
+        static uint8_t bucket(uint32_t us) {
+            uint8_t b = us ? 32 - __builtin_clz(us) : 0;
+            return b < IOHC_STATS_BUCKETS ? b : IOHC_STATS_BUCKETS - 1;
+        }
+        // Sums of every core for one metric
+        void collect(statMetric metric, uint32_t *buckets, uint32_t &count, uint32_t &sum, uint32_t &max) const;
+
+        perCore _cores[IOHC_STATS_CORES]{};
+        int64_t _dispatchStart = 0; // Only written by the dispatch task
+
+        const char *_topic = nullptr;
+        esp_timer_handle_t _timer = nullptr;
+    };
+
+    // Records the lifetime of the scope into a metric
+    class iohcStatsScope {
+    public:
+        explicit iohcStatsScope(statMetric metric) : _metric(metric), _start(esp_timer_get_time()) {}
+        ~iohcStatsScope() { iohcStats::getInstance()->since(_metric, _start); }
+
+    private:
+        statMetric _metric;
+        int64_t _start;
+    };
+
+    const char *statMetricName(statMetric metric);
+}
+
+#endif // IOHC_STATS_H
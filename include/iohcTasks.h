@@ -0,0 +1,202 @@
+#ifndef IOHC_TASKS_H
+#define IOHC_TASKS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Board settings first so any value below can be overridden there
+#if __has_include(<user_config.h>)
+    #include <user_config.h>
+#endif
+
+#if !defined(IOHC_NATIVE)
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+#endif
+
+/*
+ * Task layout. Protocol work owns core 1, WiFi, MQTT, HTTP, flash and the console run on core 0.
+ *
+ *   core 1  iohcTx       max - 1  TX queue, 2W answers go out as soon as they are submitted
+ *           iohcRx       max - 2  dispatch: handlers, crypto, sessions
+ *           iohcDuty     max - 3  RX duty cycling, only while enabled
+ *   core 0  iohcLoop     3        event loop: console commands, events posted by drivers
+ *           iohcCommand  2        console commands that take seconds
+ *           iohcPublish  2        frames and stats to MQTT
+ *           iohcScan     2        command scan probes
+ *           iohcGroup    2        group commands, one 2W exchange per target
+ *           iohcSessions 2        2W session timeouts and retries, woken by the wheel timer
+ *           iohcArchive  1        archive pages to flash
+ *           iohcNodes    1        node index journal
+ *           iohcSnapshot 1        boot snapshot to flash
+ *           iohcLog      1        log ring to the UART
+ *           esp_timer             2W session wheel tick and stats timer (ESP-IDF task, core 0)
+ *           async_tcp             network stack (CONFIG_ASYNC_TCP_RUNNING_CORE in platformio.ini)
+ *
+ * Frames cross cores through lock-free rings: radio -> iohcRx (spscRing), iohcRx -> iohcPublish (spscRing),
+ * any task -> iohcLog (bounded MPSC ring). State used from both cores is behind a FreeRTOS mutex held for
+ * short copies and list updates: the TX queue (submitted from iohcRx, iohcScan, iohcGroup, iohcSessions and
+ * the console, drained by iohcTx), the 2W sessions, the scan engine, the group command and the node index.
+ * The archive page swap is a critical section (portMUX), its flash writes stay on core 0.
+ * Every value can be set in user_config.h. The Arduino loop task is deleted once setup() is done.
+ */
+#ifndef IOHC_PROTOCOL_CORE
+    #define IOHC_PROTOCOL_CORE 1
+#endif
+#ifndef IOHC_NETWORK_CORE
+    #define IOHC_NETWORK_CORE 0
+#endif
+
+#ifndef IOHC_TX_TASK_CORE
+    #define IOHC_TX_TASK_CORE IOHC_PROTOCOL_CORE
+#endif
+// Above the dispatch task so a real-time answer goes out as soon as it is submitted
+#ifndef IOHC_TX_TASK_PRIORITY
+    #define IOHC_TX_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+#endif
+#ifndef IOHC_TX_TASK_STACK
+    #define IOHC_TX_TASK_STACK 4096
+#endif
+
+#ifndef IOHC_RX_TASK_CORE
+    #define IOHC_RX_TASK_CORE IOHC_PROTOCOL_CORE
+#endif
+#ifndef IOHC_RX_TASK_PRIORITY
+    #define IOHC_RX_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#endif
+#ifndef IOHC_RX_TASK_STACK
+    #define IOHC_RX_TASK_STACK 8192
+#endif
+
+#ifndef IOHC_DUTY_TASK_CORE
+    #define IOHC_DUTY_TASK_CORE IOHC_PROTOCOL_CORE
+#endif
+#ifndef IOHC_DUTY_TASK_PRIORITY
+    #define IOHC_DUTY_TASK_PRIORITY (configMAX_PRIORITIES - 3)
+#endif
+#ifndef IOHC_DUTY_TASK_STACK
+    #define IOHC_DUTY_TASK_STACK 3072
+#endif
+
+#ifndef IOHC_LOOP_TASK_CORE
+    #define IOHC_LOOP_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_LOOP_TASK_PRIORITY
+    #define IOHC_LOOP_TASK_PRIORITY 3
+#endif
+// Console commands run here
+#ifndef IOHC_LOOP_TASK_STACK
+    #define IOHC_LOOP_TASK_STACK 8192
+#endif
+
+// Console commands marked background and the lines queued behind them, below the loop so typed lines still go through
+#ifndef IOHC_COMMAND_TASK_CORE
+    #define IOHC_COMMAND_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_COMMAND_TASK_PRIORITY
+    #define IOHC_COMMAND_TASK_PRIORITY 2
+#endif
+#ifndef IOHC_COMMAND_TASK_STACK
+    #define IOHC_COMMAND_TASK_STACK 8192
+#endif
+
+#ifndef IOHC_PUBLISH_TASK_CORE
+    #define IOHC_PUBLISH_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_PUBLISH_TASK_PRIORITY
+    #define IOHC_PUBLISH_TASK_PRIORITY 2
+#endif
+#ifndef IOHC_PUBLISH_TASK_STACK
+    #define IOHC_PUBLISH_TASK_STACK 4096
+#endif
+
+#ifndef IOHC_SCAN_TASK_CORE
+    #define IOHC_SCAN_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_SCAN_TASK_PRIORITY
+    #define IOHC_SCAN_TASK_PRIORITY 2
+#endif
+#ifndef IOHC_SCAN_TASK_STACK
+    #define IOHC_SCAN_TASK_STACK 4096
+#endif
+
+#ifndef IOHC_SESSION_TASK_CORE
+    #define IOHC_SESSION_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_SESSION_TASK_PRIORITY
+    #define IOHC_SESSION_TASK_PRIORITY 2
+#endif
+#ifndef IOHC_SESSION_TASK_STACK
+    #define IOHC_SESSION_TASK_STACK 4096
+#endif
+
+#ifndef IOHC_GROUP_TASK_CORE
+    #define IOHC_GROUP_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_GROUP_TASK_PRIORITY
+    #define IOHC_GROUP_TASK_PRIORITY 2
+#endif
+#ifndef IOHC_GROUP_TASK_STACK
+    #define IOHC_GROUP_TASK_STACK 4096
+#endif
+
+#ifndef IOHC_ARCHIVE_TASK_CORE
+    #define IOHC_ARCHIVE_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_ARCHIVE_TASK_PRIORITY
+    #define IOHC_ARCHIVE_TASK_PRIORITY 1
+#endif
+#ifndef IOHC_ARCHIVE_TASK_STACK
+    #define IOHC_ARCHIVE_TASK_STACK 4096
+#endif
+
+#ifndef IOHC_NODE_TASK_CORE
+    #define IOHC_NODE_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_NODE_TASK_PRIORITY
+    #define IOHC_NODE_TASK_PRIORITY 1
+#endif
+#ifndef IOHC_NODE_TASK_STACK
+    #define IOHC_NODE_TASK_STACK 4096
+#endif
+
+#ifndef IOHC_SNAPSHOT_TASK_CORE
+    #define IOHC_SNAPSHOT_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_SNAPSHOT_TASK_PRIORITY
+    #define IOHC_SNAPSHOT_TASK_PRIORITY 1
+#endif
+#ifndef IOHC_SNAPSHOT_TASK_STACK
+    #define IOHC_SNAPSHOT_TASK_STACK 4096
+#endif
+
+#ifndef IOHC_LOG_TASK_CORE
+    #define IOHC_LOG_TASK_CORE IOHC_NETWORK_CORE
+#endif
+#ifndef IOHC_LOG_TASK_PRIORITY
+    #define IOHC_LOG_TASK_PRIORITY 1
+#endif
+#ifndef IOHC_LOG_TASK_STACK
+    #define IOHC_LOG_TASK_STACK 3072
+#endif
+
+// Tasks started through startTask, for the tasks command
+#ifndef IOHC_TASKS_MAX
+    #define IOHC_TASKS_MAX 16
+#endif
+
+#if !defined(IOHC_NATIVE)
+namespace IOHC {
+    /**
+     * xTaskCreatePinnedToCore keeping the handle, so stack use and placement can be checked at runtime.
+     */
+    bool startTask(TaskFunction_t func, const char *name, uint32_t stackSize, void *arg, UBaseType_t priority,
+                   TaskHandle_t *handle, BaseType_t core);
+    // Name, core, priority and stack left of every started task
+    void dumpTasks();
+}
+#endif
+
+#endif // IOHC_TASKS_H
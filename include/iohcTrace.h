@@ -0,0 +1,53 @@
+#ifndef IOHC_TRACE_H
+#define IOHC_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <iohcLog.h>
+
+/*
+ * Binary trace records for the byte dumps of the receive path.
+ * In binary mode the bytes are copied as they are and scripts/Iown-IoTraceDecoder.py renders them on the host:
+ *
+ *   0x1E | event | length | timestamp (us, uint32 LE) | length bytes
+ *
+ * 0x1E never appears in the text messages, so records and text share the console stream.
+ * Keep the events in sync with EVENTS in the decoder.
+ */
+namespace IOHC {
+    static constexpr uint8_t traceMarker = 0x1E;
+    static constexpr size_t traceHeaderSize = 7;
+
+    enum class traceEvent : uint8_t {
+        pairingData = 1,   // 0x29 device description
+        keyTransfert,      // 0x38 challenge
+        initialValue,      // IV of the key transfer
+        encryptedKey,      // 2W key sent with 0x32
+        answerKey,         // 0x3C challenge answer or key
+        clearKey,          // 1W key pushed with 0x30
+        mac,               // 1W MAC computed with the captured key
+        frame,             // Raw frame, buffer_length bytes
+    };
+
+    enum class traceMode : uint8_t {
+        text, // Rendered as hex text by the producer
+        uart, // Binary records on the console
+        file, // Binary records appended to IOHC_TRACE_FILE, nothing on the console
+    };
+
+    const char *traceEventPrefix(traceEvent event);
+}
+
+#if IOHC_LOG_LEVEL >= IOHC_LOG_DEBUG
+    #define IOHC_TRACED(event, data, len) IOHC::iohcLog::getInstance()->trace(event, data, len)
+#else
+    #define IOHC_TRACED(event, data, len) ((void) 0)
+#endif
+#if IOHC_LOG_LEVEL >= IOHC_LOG_TRACE
+    #define IOHC_TRACET(event, data, len) IOHC::iohcLog::getInstance()->trace(event, data, len)
+#else
+    #define IOHC_TRACET(event, data, len) ((void) 0)
+#endif
+
+#endif // IOHC_TRACE_H
@@ -0,0 +1,116 @@
+#ifndef IOHC_TX_QUEUE_H
+#define IOHC_TX_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <iohcPacket.h>
+#include <iohcTasks.h>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+    #include "freertos/semphr.h"
+}
+
+// Jobs waiting for the radio, all classes together
+#ifndef IOHC_TX_QUEUE_SIZE
+    #define IOHC_TX_QUEUE_SIZE 12
+#endif
+// Frames sent back to back by one job
+#ifndef IOHC_TX_JOB_PACKETS
+    #define IOHC_TX_JOB_PACKETS 2
+#endif
+
+namespace IOHC {
+    enum class txClass : uint8_t {
+        realtime,    // 2W challenge answers and acks
+        interactive, // User commands
+        background,  // Discovery, scanMode probing
+    };
+
+    /**
+     * Multi-priority TX queue in front of the radio.
+     * Frames are copied at submit time, so callers may reuse their buffers right away.
+     * The queue honours delayed, and sends repeat + 1 transmissions spaced by repeatTime.
+     * Repeat trains are sent one transmission at a time by the TX task: a higher class job submitted
+     * meanwhile goes out before the next repeat, the preempted train resumes afterwards.
+     * Jobs still queued past their deadline are dropped, a late answer is ignored by the device.
+     * A job finding its channel busy is put back with the backoff of the TX scheduler, the other jobs
+     * are sent meanwhile.
+     */
+    class iohcTxQueue {
+    public:
+        // TX task, once a transmission of the job left the radio
+        using sentFunc = void (*)(const iohcPacket *frame, void *arg);
+
+        static iohcTxQueue *getInstance();
+        virtual ~iohcTxQueue() = default;
+
+        bool start(BaseType_t core = IOHC_TX_TASK_CORE, UBaseType_t priority = IOHC_TX_TASK_PRIORITY,
+                   uint32_t stackSize = IOHC_TX_TASK_STACK);
+        // agile: 1W frames, the channel is picked by the TX scheduler. deadline 0 for none.
+        bool submit(const std::vector<iohcPacket *> &packets, txClass cls, int64_t deadline = 0, bool agile = false,
+                    sentFunc sent = nullptr, void *sentArg = nullptr);
+        // Drops the queued jobs of a class, e.g. when leaving scanMode
+        void cancel(txClass cls);
+        // Free job slots, for producers that should not take the last ones
+        size_t room() const;
+        void dump() const;
+
+    private:
+        iohcTxQueue() = default;
+        static iohcTxQueue *_iohcTxQueue;
+        static void task(void *arg);
+
+        static constexpr size_t classes = 3;
+        static constexpr uint8_t none = 0xFF;
+
+        struct job {
+            iohcPacket packets[IOHC_TX_JOB_PACKETS];
+            uint8_t count;
+            uint16_t remaining; // Transmissions left in the repeat train, repeat 255 is 256
+            uint8_t attempts;   // Busy channel assessments of the next transmission
+            uint32_t id;        // Submit number, tells a slot cancelled and reused while the TX task listened
+            bool agile;
+            uint8_t next;
+            int64_t deadline;
+            int64_t notBefore;
+            int64_t origin; // Start of the handler answering with this job, 0 when not an answer
+            uint32_t gapUs;
+            sentFunc sent;
+            void *sentArg;
+        };
+
+        uint8_t take(uint8_t &list);
+        void append(uint8_t &list, uint8_t index);
+        void unlink(uint8_t &list, uint8_t index);
+        bool linked(uint8_t list, uint8_t index, uint32_t id) const;
+        void release(uint8_t index);
+        // Highest class ready job, none if nothing is ready yet; wait is then the delay to the next start
+        uint8_t pick(int64_t now, int64_t &wait, uint8_t &cls);
+
+        job _jobs[IOHC_TX_QUEUE_SIZE];
+        uint8_t _free = none;
+        uint8_t _heads[classes] = {none, none, none};
+        uint32_t _ids = 0;
+        SemaphoreHandle_t _lock = nullptr;
+        TaskHandle_t _task = nullptr;
+        // Frames handed to the radio, reused once it reported them sent
+        iohcPacket _onAir[IOHC_TX_JOB_PACKETS];
+        std::vector<iohcPacket *> _onAirList;
+        uint8_t _train = none; // Job whose repeat train is in progress
+        uint8_t _trainClass = classes;
+
+        std::atomic<uint32_t> _submitted[classes]{};
+        std::atomic<uint32_t> _sent[classes]{};
+        std::atomic<uint32_t> _expired{0};
+        std::atomic<uint32_t> _preempted{0};
+        std::atomic<uint32_t> _deferred{0};
+        std::atomic<uint32_t> _full{0};
+    };
+}
+
+#endif // IOHC_TX_QUEUE_H
@@ -0,0 +1,106 @@
+#ifndef IOHC_TX_SCHEDULER_H
+#define IOHC_TX_SCHEDULER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <iohcPacket.h>
+#include <iohcRadioHooks.h>
+
+// Channel considered busy above this level (EN 300220 LBT threshold)
+#ifndef IOHC_LBT_THRESHOLD_DBM
+    #define IOHC_LBT_THRESHOLD_DBM (-85.0f)
+#endif
+// RSSI samples per clear channel assessment
+#ifndef IOHC_LBT_SAMPLES
+    #define IOHC_LBT_SAMPLES 4
+#endif
+#ifndef IOHC_LBT_SAMPLE_US
+    #define IOHC_LBT_SAMPLE_US 100
+#endif
+// Busy channel assessments before sending anyway, the backoff doubles each time
+#ifndef IOHC_LBT_MAX_ATTEMPTS
+    #define IOHC_LBT_MAX_ATTEMPTS 5
+#endif
+#ifndef IOHC_LBT_BACKOFF_MS
+    #define IOHC_LBT_BACKOFF_MS 2
+#endif
+// Added to the air time before a frame still reported on air is given up on
+#ifndef IOHC_TX_DONE_MARGIN_US
+    #define IOHC_TX_DONE_MARGIN_US 5000
+#endif
+// Time left to a 2W device between its frame and our answer
+#ifndef IOHC_2W_REPLY_BUDGET_US
+    #define IOHC_2W_REPLY_BUDGET_US 15000
+#endif
+
+namespace IOHC {
+    /**
+     * Listen before talk and adaptive frequency agility in front of iohcRadio::send.
+     * Occupancy of channels 1 to 3 is an average of clear channel assessments and frames exchanged by
+     * other systems. 1W frames go out on the least busy channel; 2W answers keep their channel and are sent
+     * anyway when backing off would miss the device reply deadline.
+     * The scheduler never waits: a busy channel returns the backoff to the TX queue, which sends other
+     * jobs meanwhile and assesses this one again once it is due.
+     */
+    class iohcTxScheduler {
+    public:
+        static constexpr size_t channels = 3;
+
+        struct channelStats {
+            uint32_t frequency;
+            std::atomic<uint32_t> occupancy{0}; // Busy share, 0 to occupancyScale
+            std::atomic<uint32_t> assessments{0};
+            std::atomic<uint32_t> busy{0};
+            std::atomic<uint32_t> sent{0};
+        };
+        static constexpr uint32_t occupancyScale = 1 << 12;
+
+        static iohcTxScheduler *getInstance();
+        virtual ~iohcTxScheduler() = default;
+
+        void setHooks(const iohcRadioHooks &hooks) { _hooks = hooks; }
+        // Frames to this address are answers to us, not traffic of other systems
+        void setGateway(const uint8_t *address) { memcpy(_gateway, address, sizeof(_gateway)); }
+
+        // Deadline for the answer to a frame received now
+        static int64_t replyDeadline();
+        // Clear channel assessment number attempt of the frames, 0 when they can go out now, otherwise the
+        // backoff in us before the next assessment.
+        // 2W: same channel, no backoff past deadline (0 for none)
+        uint32_t listen(const std::vector<iohcPacket *> &packets, int64_t deadline, uint8_t attempt);
+        // 1W: hops to the least busy channel when the chosen one is busy, sets the frequency of the frames
+        uint32_t listen1W(std::vector<iohcPacket *> &packets, uint8_t attempt);
+        void transmit(std::vector<iohcPacket *> &packets);
+
+        // Returns once the radio sent the frames, the caller may reuse them
+        void waitSent(const std::vector<iohcPacket *> &packets);
+
+        uint32_t leastBusy() const;
+        bool clearChannel(uint32_t frequency);
+        // Frames not addressed to the gateway count as channel activity
+        void noteReceived(const iohcPacket *iohc);
+        void dump() const;
+
+    private:
+        iohcTxScheduler();
+        static iohcTxScheduler *_iohcTxScheduler;
+        channelStats *stats(uint32_t frequency);
+        static void update(channelStats &channel, bool busy);
+        static void setFrequency(std::vector<iohcPacket *> &packets, uint32_t frequency);
+        static uint32_t backoffMs(uint8_t attempt);
+
+        iohcRadioHooks _hooks;
+        uint8_t _gateway[3] = {};
+        channelStats _channels[channels];
+        std::atomic<uint32_t> _backoffs{0};
+        std::atomic<uint32_t> _hops{0};
+        std::atomic<uint32_t> _forced{0};
+        std::atomic<uint32_t> _txTimeouts{0};
+    };
+}
+
+#endif // IOHC_TX_SCHEDULER_H
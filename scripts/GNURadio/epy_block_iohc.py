@@ -0,0 +1,57 @@
+"""
+Embedded Python Block: IO-HomeControl decoder on the native library
+
+Same output as epy_block_0.py, the sample loop runs in the iohcdecode module
+(scripts/native/python, pip install ./scripts/native/python). One input per channel.
+With a capture path, frames are also written as a capture file (include/iohcCapture.h).
+"""
+
+import numpy as np
+from gnuradio import gr
+
+import iohcdecode
+
+
+class blk(gr.sync_block):
+    """IO-HomeControl Decoder (native)
+       Decodes the already demodulated signal of every channel to a hexadecimal message
+       """
+
+    def __init__(self, samp_rate=172800.0, channels=3, first_channel=0, showhex=1, hexgroup=2, min_preamble=64, capture=""):  # only default arguments here
+        """arguments to this function show up as parameters in GRC"""
+        gr.sync_block.__init__(
+            self,
+            name='IO-HomeControl Decoder (native)',   # will show up in GRC
+            in_sig=[np.byte] * channels,
+            out_sig=[]
+        )
+        self.samp_rate = samp_rate
+        self.showhex = showhex
+        self.hexgroup = hexgroup
+        self.decoders = [iohcdecode.Decoder(first_channel + i, samp_rate / 38400.0, min_preamble)
+                         for i in range(channels)]
+        self.capture = iohcdecode.CaptureWriter(capture, samp_rate) if capture else None
+
+    def stop(self):
+        if self.capture:
+            self.capture.close()
+        return True
+
+    def work(self, input_items, output_items):
+        for decoder, samples in zip(self.decoders, input_items):
+            for frame in decoder.feed(samples):
+                print(self.makeMessage(frame))
+                if self.capture:
+                    self.capture.append(frame)
+        return len(input_items[0])
+
+    def makeMessage(self, frame):
+        s = "io_home_control_data, ch=%i, tick=%i" % (frame.channel, frame.tick)
+        s += ", crc=ok" if frame.crc_ok else ", crc=not_ok"
+        if self.showhex != 0:
+            s += ", hex= "
+            for i, b in enumerate(frame.data):
+                s += "%02X" % b
+                if self.hexgroup > 0 and (i + 1) % self.hexgroup == 0:
+                    s += " "
+        return s
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""
+io-homecontrol capture files (include/iohcCapture.h): gateway archive, host decoder and replay output.
+
+  Iown-Capture.py dump capture.bin [--cmd 0x30] [--addr 1A2B3C] [--boot n] [--from us] [--to us]
+  Iown-Capture.py tsv capture.bin > frames.tsv     # MSG column of docs/LinkLayer.md, CRC appended
+  Iown-Capture.py import frames.txt capture.bin    # one hex frame with CRC per line
+
+The file is mapped, blocks whose index cannot match the filter are skipped without reading their records.
+Stamps count from the boot of the gateway: --from and --to only make sense together with --boot, the boot
+count printed with every record. Blocks with an origin also print the wall clock time.
+With numpy installed, records(path) returns the whole capture as one structured array.
+"""
+
+import datetime
+import mmap
+import struct
+import sys
+
+from ioCrypto import compute_crc_8408
+
+MAGIC = 0x50414349  # "ICAP"
+VERSION = 1
+BLOCK = struct.Struct("<IIHHHBBQQQ16s32sI4s")  # 96 bytes
+RECORD = struct.Struct("<QIbBBB32s")           # 48 bytes
+CRC_ERROR = 0x01
+
+NUMPY_RECORD = [("stamp", "<u8"), ("frequency", "<u4"), ("rssi", "i1"), ("length", "u1"),
+                ("radio", "u1"), ("flags", "u1"), ("buffer", "u1", (32,))]
+
+
+def address_bits(address):
+  h = (((address[0] << 16) | (address[1] << 8) | address[2]) * 0x9E3779B1) & 0xFFFFFFFF
+  return h >> 25, (h >> 18) & 0x7F
+
+
+def has_bit(bits, n):
+  return bits[n // 8] & (1 << (n % 8))
+
+
+class Capture:
+
+  def __init__(self, path):
+    self.file = open(path, "rb")
+    self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+    self.block_size = self._find_block_size()
+    self.blocks = []
+    for offset in range(0, len(self.map) - self.block_size + 1, self.block_size):
+      header = self._header(offset)
+      if header is not None and header["count"]:
+        self.blocks.append(header)
+    self.blocks.sort(key=lambda b: b["sequence"])
+
+  def _header(self, offset, block_size=None):
+    f = BLOCK.unpack_from(self.map, offset)
+    header = dict(zip(("magic", "sequence", "count", "record_size", "block_size", "version", "flags",
+                       "first", "last", "origin", "addresses", "commands", "boot", "reserved"), f))
+    block_size = block_size or self.block_size
+    if header["magic"] != MAGIC or header["version"] != VERSION or header["record_size"] != RECORD.size:
+      return None
+    if header["block_size"] != block_size or header["count"] > (block_size - BLOCK.size) // RECORD.size:
+      return None
+    header["offset"] = offset
+    return header
+
+  # First blocks of an archive may have been cleared
+  def _find_block_size(self):
+    for offset in range(0, len(self.map) - BLOCK.size + 1, 16):
+      if struct.unpack_from("<I", self.map, offset)[0] != MAGIC:
+        continue
+      size = struct.unpack_from("<H", self.map, offset + 12)[0]
+      if size >= BLOCK.size + RECORD.size and offset % size == 0 and self._header(offset, size):
+        return size
+    raise ValueError("Not a capture file")
+
+  def __len__(self):
+    return sum(b["count"] for b in self.blocks)
+
+  def records(self, cmd=None, addr=None, start=0, end=None, boot=None):
+    """Records in sequence order as dicts, data without the CRC"""
+    for b in self.blocks:
+      if boot is not None and b["boot"] != boot:
+        continue
+      if b["last"] < start or (end is not None and b["first"] > end):
+        continue
+      if cmd is not None and not has_bit(b["commands"], cmd):
+        continue
+      if addr is not None and not all(has_bit(b["addresses"], n) for n in address_bits(addr)):
+        continue
+      for i in range(b["count"]):
+        stamp, freq, rssi, length, radio, flags, buf = RECORD.unpack_from(
+          self.map, b["offset"] + BLOCK.size + i * RECORD.size)
+        data = buf[:length]
+        if stamp < start or (end is not None and stamp > end):
+          continue
+        if cmd is not None and (length < 9 or data[8] != cmd):
+          continue
+        if addr is not None and (length < 9 or (data[2:5] != addr and data[5:8] != addr)):
+          continue
+        yield {"stamp": stamp, "frequency": freq, "rssi": rssi, "radio": radio, "flags": flags, "data": data,
+               "boot": b["boot"], "time": b["origin"] + stamp if b["origin"] else None}
+
+
+def records(path):
+  """Whole capture as a numpy structured array, in sequence order"""
+  import numpy as np
+  capture = Capture(path)
+  raw = np.memmap(path, dtype=np.uint8, mode="r")
+  dtype = np.dtype(NUMPY_RECORD)
+  parts = [raw[b["offset"] + BLOCK.size:b["offset"] + BLOCK.size + b["count"] * RECORD.size].view(dtype)
+           for b in capture.blocks]
+  return np.concatenate(parts) if parts else np.zeros(0, dtype)
+
+
+def write(path, frames, block_size=4096):
+  """frames: (stamp, bytes without CRC) pairs, CRC errors are not written"""
+  per_block = (block_size - BLOCK.size) // RECORD.size
+  with open(path, "wb") as out:
+    sequence = 0
+    frames = list(frames)
+    for first in range(0, len(frames), per_block):
+      chunk = frames[first:first + per_block]
+      commands = bytearray(32)
+      addresses = bytearray(16)
+      body = b""
+      for stamp, data in chunk:
+        if len(data) >= 9:
+          commands[data[8] // 8] |= 1 << (data[8] % 8)
+          for a in (data[5:8], data[2:5]):
+            for n in address_bits(a):
+              addresses[n // 8] |= 1 << (n % 8)
+        body += RECORD.pack(stamp, 0, 0, len(data), 0, 0, bytes(data).ljust(32, b"\0"))
+      stamps = [s for s, _ in chunk]
+      header = BLOCK.pack(MAGIC, sequence, len(chunk), RECORD.size, block_size, VERSION, 0,
+                          min(stamps), max(stamps), 0, bytes(addresses), bytes(commands), 0, bytes(4))
+      out.write((header + body).ljust(block_size, b"\0"))
+      sequence += 1
+
+
+def tsv(capture, out):
+  out.write("MSG\n")
+  for r in capture.records():
+    crc = compute_crc_8408(r["data"])
+    out.write(r["data"].hex().upper() + "%02X%02X\n" % (crc & 0xFF, crc >> 8))
+
+
+def usage():
+  print(__doc__.strip())
+  sys.exit(1)
+
+
+def main(argv):
+  if len(argv) < 3:
+    usage()
+  if argv[1] == "import":
+    if len(argv) != 4:
+      usage()
+    frames = []
+    with open(argv[2]) as f:
+      for n, line in enumerate(f):
+        line = line.strip()
+        if not line or line.startswith("#"):
+          continue
+        raw = bytes.fromhex(line.replace(" ", ""))
+        if len(raw) > 2 and compute_crc_8408(raw) == 0:
+          frames.append((n, raw[:-2]))
+    write(argv[3], frames)
+    print("%i frames written" % len(frames))
+    return
+  capture = Capture(argv[2])
+  if argv[1] == "tsv":
+    tsv(capture, sys.stdout)
+    return
+  if argv[1] != "dump":
+    usage()
+  opts = dict(zip(argv[3::2], argv[4::2]))
+  cmd = int(opts["--cmd"], 0) if "--cmd" in opts else None
+  addr = bytes.fromhex(opts["--addr"]) if "--addr" in opts else None
+  start = int(opts.get("--from", 0))
+  end = int(opts["--to"]) if "--to" in opts else None
+  boot = int(opts["--boot"]) if "--boot" in opts else None
+  for r in capture.records(cmd, addr, start, end, boot):
+    flag = " crc=not_ok" if r["flags"] & CRC_ERROR else ""
+    when = " " + datetime.datetime.utcfromtimestamp(r["time"] / 1e6).isoformat() if r["time"] else ""
+    print("%12i boot=%i%s radio=%i rssi=%i%s %s" % (r["stamp"], r["boot"], when, r["radio"], r["rssi"], flag,
+                                                      r["data"].hex().upper()))
+
+
+if __name__ == "__main__":
+  main(sys.argv)
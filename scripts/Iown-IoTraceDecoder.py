@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+
+"""
+Decodes the binary trace records of the gateway (include/iohcTrace.h).
+
+  0x1E | event | length | timestamp (us, uint32 LE) | length bytes
+
+Text around the records is passed through. Input is a file (console capture or /trace.bin
+copied from LittleFS), a serial port (with pyserial) or stdin.
+
+  Iown-IoTraceDecoder.py capture.bin
+  Iown-IoTraceDecoder.py /dev/ttyUSB0 [baudrate]
+  pio device monitor --raw | Iown-IoTraceDecoder.py
+"""
+
+import sys
+
+MARKER = 0x1E
+HEADER_SIZE = 7
+HALF_RANGE = 1 << 31
+
+# Keep in sync with traceEvent in include/iohcTrace.h: (name, separator)
+EVENTS = {
+  1: ("Pairing data", " "),
+  2: ("Key transfert challenge", " "),
+  3: ("2) Initial value used for key encryption", " "),
+  4: ("2) Encrypted 2-way key to be sent with 0x32", " "),
+  5: ("Key", " "),
+  6: ("CLEAR KEY", ""),
+  7: ("MAC", ""),
+  8: ("Frame", " "),
+}
+
+class TraceDecoder:
+
+  def __init__(self, out=sys.stdout):
+    self.out = out
+    self.pending = bytearray()
+    self.first_stamp = None
+    self.last_stamp = 0
+    self.wraps = 0
+
+  def timestamp(self, stamp):
+    # uint32 microseconds wrap every 71 minutes. Records of several tasks may reach the log slightly out of
+    # order, only a backwards jump of more than half the range is a wrap.
+    if self.last_stamp - stamp > HALF_RANGE:
+      self.wraps += 1
+      self.last_stamp = stamp
+    else:
+      self.last_stamp = max(stamp, self.last_stamp)
+    full = stamp + (self.wraps << 32)
+    if self.first_stamp is None:
+      self.first_stamp = full
+    return (full - self.first_stamp) / 1000.0
+
+  def render(self, event, data, stamp):
+    name, sep = EVENTS.get(event, ("Event %d" % event, " "))
+    text = sep.join("%02X" % b for b in data)
+    return "[%10.3f ms] %s: %s\n" % (self.timestamp(stamp), name, text)
+
+  def feed(self, chunk):
+    self.pending += chunk
+    while self.pending:
+      marker = self.pending.find(MARKER)
+      if marker < 0:
+        self.out.write(self.pending.decode("ascii", "replace"))
+        self.pending.clear()
+        return
+      if marker:
+        self.out.write(self.pending[:marker].decode("ascii", "replace"))
+        del self.pending[:marker]
+      if len(self.pending) < HEADER_SIZE or len(self.pending) < HEADER_SIZE + self.pending[2]:
+        return  # Wait for the rest of the record
+      event, length = self.pending[1], self.pending[2]
+      stamp = int.from_bytes(self.pending[3:7], "little")
+      data = bytes(self.pending[HEADER_SIZE:HEADER_SIZE + length])
+      del self.pending[:HEADER_SIZE + length]
+      self.out.write(self.render(event, data, stamp))
+
+def open_input(args):
+  if not args:
+    return sys.stdin.buffer
+  if args[0].startswith("/dev/") or args[0].upper().startswith("COM"):
+    import serial
+    return serial.Serial(args[0], int(args[1]) if len(args) > 1 else 115200, timeout=0.1)
+  return open(args[0], "rb")
+
+def main():
+  source = open_input(sys.argv[1:])
+  decoder = TraceDecoder()
+  read = getattr(source, "read1", source.read)  # Do not wait for a full buffer on a pipe
+  while True:
+    chunk = read(256)
+    if chunk is None or (not chunk and not hasattr(source, "in_waiting")):
+      break
+    if chunk:
+      decoder.feed(chunk)
+      sys.stdout.flush()
+
+if __name__ == "__main__":
+  main()
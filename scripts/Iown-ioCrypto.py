@@ -18,11 +18,22 @@ def compute_crc_8408_byte(data: int, crc: int = 0) -> int:
     crc = (crc >> 1) ^ remainder
   return crc
 
+# Same 256 entries table as the firmware (include/iohcCrc.h)
+CRC_8408_TABLE = [compute_crc_8408_byte(i) for i in range(256)]
+
 def compute_crc_8408(data: bytes, crc: int = 0) -> int:
   """
   Returns the CRC value for the given data frame.
   Used for whole io-homecontrol frames integriy check
   """
+  for b in data:
+    crc = (crc >> 8) ^ CRC_8408_TABLE[(crc ^ b) & 0xff]
+  return crc
+
+def compute_crc_8408_bitwise(data: bytes, crc: int = 0) -> int:
+  """
+  Reference bit by bit version of compute_crc_8408
+  """
   for b in data:
     crc = compute_crc_8408_byte(b, crc)
   return crc
@@ -0,0 +1,16 @@
+/*
+ * Native microbenchmarks: the device console crcBench / cryptoBench built for the host.
+ *
+ *   pio run -e native_bench && .pio/build/native_bench/program [rounds]
+ *
+ * Exit code: 0 ok, 1 when a crypto result differs from the scripts/Iown-ioCrypto.py vectors.
+ */
+#include <cstdlib>
+
+#include <iohcBench.h>
+
+int main(int argc, char **argv) {
+    uint32_t rounds = argc > 1 ? strtoul(argv[1], nullptr, 0) : 10000;
+    IOHC::crcBench(rounds);
+    return IOHC::cryptoBench(rounds) ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+/*
+ * Host decoder check and throughput: frames of a replay file are modulated into sliced samples
+ * (preamble, 0xFF 0x33 sync, UART framing, clock offset and noise between frames) then decoded back.
+ *
+ *   pio run -e native_decode && .pio/build/native_decode/program [-s samples per bit] [-n rounds] [-w capture] frames.txt
+ *
+ * -w writes the frames decoded in the first round as a capture (iohcCapture.h), stamps from the sample index.
+ *
+ * Exit code: 0 ok, 1 when a frame is not decoded back as sent.
+ */
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "iohcCaptureFile.h"
+#include "iohcDecoder.h"
+
+using namespace IOHC;
+
+namespace {
+    constexpr uint32_t bitRate = 38400;
+
+    std::vector<uint8_t> parseHex(const std::string &line) {
+        std::vector<uint8_t> out;
+        int high = -1;
+        for (char c : line) {
+            if (!isxdigit(static_cast<unsigned char>(c))) continue;
+            int nibble = isdigit(static_cast<unsigned char>(c)) ? c - '0' : tolower(c) - 'a' + 10;
+            if (high < 0) high = nibble;
+            else {
+                out.push_back(high << 4 | nibble);
+                high = -1;
+            }
+        }
+        return out;
+    }
+
+    // Sliced samples of one transmission, bits drawn at position t / samplesPerBit
+    class modulator {
+    public:
+        modulator(std::vector<uint8_t> &out, double samplesPerBit) : _out(out), _samplesPerBit(samplesPerBit) {}
+
+        void bits(uint16_t symbol, uint8_t count) {
+            for (int b = count - 1; b >= 0; b--) level((symbol >> b) & 1, 1);
+        }
+        void byte(uint8_t data) { bits(decoder::uartSymbol(data), 10); }
+        void level(uint8_t value, double duration) {
+            _time += duration * _samplesPerBit;
+            while (_out.size() < _time) _out.push_back(value);
+        }
+
+    private:
+        std::vector<uint8_t> &_out;
+        double _samplesPerBit;
+        double _time = 0;
+    };
+
+    int usage(const char *name) {
+        fprintf(stderr, "Usage: %s [-s samples per bit] [-n rounds] [-w capture] frames.txt\n", name);
+        return 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    double samplesPerBit = 4.5;
+    uint32_t rounds = 200;
+    const char *path = nullptr;
+    const char *output = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) samplesPerBit = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc) rounds = strtoul(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc) output = argv[++i];
+        else if (argv[i][0] == '-') return usage(argv[0]);
+        else path = argv[i];
+    }
+    if (!path || samplesPerBit < 3 || !rounds) return usage(argv[0]);
+
+    std::ifstream input(path);
+    if (!input) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 1;
+    }
+    std::vector<std::vector<uint8_t>> frames;
+    for (std::string line; std::getline(input, line);)
+        if (!line.empty() && line[0] != '#') frames.push_back(parseHex(line));
+
+    // Every frame on a transmitter running 0.3 % fast, noise in the gaps
+    std::vector<uint8_t> samples;
+    std::mt19937 noise(1);
+    modulator air(samples, samplesPerBit * 0.997);
+    for (const auto &frame : frames) {
+        for (int i = 0; i < 200; i++) air.level(noise() & 1, 0.3 + (noise() % 100) / 50.0);
+        air.level(0, 20);
+        for (int i = 0; i < 32; i++) air.byte(0x55);
+        air.byte(0xFF);
+        air.byte(0x33);
+        for (uint8_t b : frame) air.byte(b);
+        air.level(1, 4);
+    }
+    air.level(0, 50);
+
+    iohcCaptureWriter writer;
+    if (output && !writer.open(output)) {
+        fprintf(stderr, "Cannot write capture %s\n", output);
+        return 1;
+    }
+    iohcDecoder decoder(0, samplesPerBit);
+    std::vector<std::vector<uint8_t>> decoded;
+    decoder.onFrame([&](const iohcDecodedFrame &frame) {
+        if (decoded.size() >= frames.size()) return;
+        decoded.emplace_back(frame.bytes, frame.bytes + frame.length);
+        if (output) writer.append(frame.record(bitRate * samplesPerBit));
+    });
+
+    // Chunks of GNURadio size
+    const auto begin = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; round++)
+        for (size_t offset = 0; offset < samples.size(); offset += 4096)
+            decoder.feed(samples.data() + offset, std::min<size_t>(4096, samples.size() - offset));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    if (output && !writer.close()) {
+        fprintf(stderr, "Cannot write capture %s\n", output);
+        return 1;
+    }
+
+    const iohcDecoderStats &stats = decoder.stats();
+    bool ok = decoded.size() == frames.size() && stats.frames == frames.size() * rounds;
+    for (size_t i = 0; ok && i < frames.size(); i++) ok = decoded[i] == frames[i];
+
+    const double rate = stats.samples / seconds;
+    printf("%u frames decoded, %u CRC errors, %u framing errors, %u preambles\n", (unsigned) stats.frames,
+           (unsigned) stats.crcErrors, (unsigned) stats.framingErrors, (unsigned) stats.preambles);
+    printf("%.1f Msamples/s, %.0f channels in real time at %.1f samples per bit\n", rate / 1e6,
+           std::floor(rate / (bitRate * samplesPerBit)), samplesPerBit);
+    printf("%s\n", ok ? "frames match" : "*** frames differ");
+    return ok ? 0 : 1;
+}
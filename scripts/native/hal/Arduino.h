@@ -0,0 +1,51 @@
+#ifndef IOHC_NATIVE_ARDUINO_H
+#define IOHC_NATIVE_ARDUINO_H
+
+/*
+ * Host shim of the Arduino core: just what the portable gateway modules use.
+ * Only part of the native environment, see scripts/native/README.md
+ */
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifndef IRAM_ATTR
+    #define IRAM_ATTR
+#endif
+
+#define OUTPUT 1
+#define INPUT 0
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return 0; }
+
+inline unsigned long micros() {
+    using namespace std::chrono;
+    static const auto boot = steady_clock::now();
+    return duration_cast<microseconds>(steady_clock::now() - boot).count();
+}
+inline unsigned long millis() { return micros() / 1000; }
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int written = vprintf(format, args);
+        va_end(args);
+        return written;
+    }
+    size_t println(const char *str = "") { return ::printf("%s\n", str); }
+    size_t println(const std::string &str) { return println(str.c_str()); }
+};
+inline HardwareSerial Serial;
+
+#endif // IOHC_NATIVE_ARDUINO_H
@@ -0,0 +1,125 @@
+#include "crypto2Wutils.h"
+#include "iohcCryptoHelpers.h"
+
+#include <cstring>
+
+/*
+ * AES-128 encryption (FIPS-197) as tiny-AES-c, which LoRa32 uses on target, and the io-homecontrol helpers
+ * of scripts/Iown-ioCrypto.py. Written from the specifications, no firmware code is shared.
+ */
+namespace {
+    constexpr uint8_t sbox[256] = {
+        0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+        0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+        0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+        0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+        0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+        0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+        0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+        0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+        0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+        0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+        0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+        0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+        0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+        0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+        0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+        0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16};
+    constexpr uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+
+    constexpr uint8_t xtime(uint8_t x) { return (x << 1) ^ ((x >> 7) * 0x1b); }
+
+    void addRoundKey(uint8_t *state, const uint8_t *roundKey) {
+        for (int i = 0; i < 16; i++) state[i] ^= roundKey[i];
+    }
+
+    // State is column major as the input block, byte r of column c at 4 * c + r
+    void subShiftRows(uint8_t *state) {
+        uint8_t shifted[16];
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++) shifted[4 * c + r] = sbox[state[4 * ((c + r) % 4) + r]];
+        memcpy(state, shifted, 16);
+    }
+
+    void mixColumns(uint8_t *state) {
+        for (int c = 0; c < 4; c++) {
+            uint8_t *col = state + 4 * c;
+            const uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+            const uint8_t first = col[0];
+            for (int r = 0; r < 4; r++) col[r] ^= all ^ xtime(col[r] ^ (r == 3 ? first : col[r + 1]));
+        }
+    }
+}
+
+uint8_t transfert_key[16] = {0x34, 0xc3, 0x46, 0x6e, 0xd8, 0x8f, 0x4e, 0x8e,
+                             0x16, 0xaa, 0x47, 0x39, 0x49, 0x88, 0x43, 0x73};
+
+void AES_init_ctx(AES_ctx *ctx, const uint8_t *key) {
+    uint8_t *w = ctx->RoundKey;
+    memcpy(w, key, 16);
+    for (int i = 4; i < 44; i++) {
+        uint8_t t[4] = {w[4 * i - 4], w[4 * i - 3], w[4 * i - 2], w[4 * i - 1]};
+        if (i % 4 == 0) {
+            const uint8_t first = t[0];
+            t[0] = sbox[t[1]] ^ rcon[i / 4 - 1];
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[first];
+        }
+        for (int j = 0; j < 4; j++) w[4 * i + j] = w[4 * (i - 4) + j] ^ t[j];
+    }
+}
+
+void AES_ECB_encrypt(const AES_ctx *ctx, uint8_t *buf) {
+    addRoundKey(buf, ctx->RoundKey);
+    for (int round = 1; round < 10; round++) {
+        subShiftRows(buf);
+        mixColumns(buf);
+        addRoundKey(buf, ctx->RoundKey + 16 * round);
+    }
+    subShiftRows(buf);
+    addRoundKey(buf, ctx->RoundKey + 160);
+}
+
+void constructInitialValue(std::vector<uint8_t> &frame, uint8_t *initialValue, size_t length,
+                           std::vector<uint8_t> &challenge, uint8_t *sequence) {
+    uint8_t chksum1 = 0, chksum2 = 0;
+    for (size_t i = 0; i < length; i++) {
+        const uint8_t tmp = frame[i] ^ chksum2;
+        const uint8_t next = ((chksum1 & 0x7f) << 1) | (tmp >> 7);
+        chksum2 = (chksum1 & 0x80) ? (uint8_t) ((tmp << 1) ^ 0x5b) : (uint8_t) (tmp << 1);
+        chksum1 = (chksum1 & 0x80) ? next ^ 0x55 : next;
+    }
+    for (size_t i = 0; i < 8; i++) initialValue[i] = i < length ? frame[i] : 0x55;
+    initialValue[8] = chksum1;
+    initialValue[9] = chksum2;
+    if (challenge.size() == 6) {
+        memcpy(initialValue + 10, challenge.data(), 6);
+    } else {
+        initialValue[10] = sequence[0];
+        initialValue[11] = sequence[1];
+        memset(initialValue + 12, 0x55, 4);
+    }
+}
+
+namespace iohcCrypto {
+    void encrypt_1W_key(const uint8_t *node, uint8_t *key) {
+        uint8_t iv[16];
+        for (int i = 0; i < 15; i++) iv[i] = node[i % 3];
+        iv[15] = node[0];
+        AES_ctx ctx;
+        AES_init_ctx(&ctx, transfert_key);
+        AES_ECB_encrypt(&ctx, iv);
+        for (int i = 0; i < 16; i++) key[i] ^= iv[i];
+    }
+
+    void create_1W_hmac(uint8_t *hmac, uint8_t *sequence, uint8_t *key, std::vector<uint8_t> &frame) {
+        uint8_t iv[16];
+        std::vector<uint8_t> noChallenge;
+        constructInitialValue(frame, iv, frame.size(), noChallenge, sequence);
+        AES_ctx ctx;
+        AES_init_ctx(&ctx, key);
+        AES_ECB_encrypt(&ctx, iv);
+        memcpy(hmac, iv, 6);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef IOHC_NATIVE_CRYPTO_2W_UTILS_H
+#define IOHC_NATIVE_CRYPTO_2W_UTILS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Host shim of the LoRa32 crypto: AES-128 with the tiny-AES API and the initial value construction,
+ * implemented again in crypto2Wutils.cpp so the bench vectors check real code, not the firmware against itself.
+ */
+struct AES_ctx {
+    uint8_t RoundKey[176];
+};
+
+void AES_init_ctx(AES_ctx *ctx, const uint8_t *key);
+// ECB, in place
+void AES_ECB_encrypt(const AES_ctx *ctx, uint8_t *buf);
+
+extern uint8_t transfert_key[16];
+
+// 2W with challenge, 1W with the 2 bytes sequence number when challenge is empty
+void constructInitialValue(std::vector<uint8_t> &frame, uint8_t *initialValue, size_t length,
+                           std::vector<uint8_t> &challenge, uint8_t *sequence);
+
+#endif // IOHC_NATIVE_CRYPTO_2W_UTILS_H
@@ -0,0 +1,12 @@
+#ifndef IOHC_NATIVE_ESP_RANDOM_H
+#define IOHC_NATIVE_ESP_RANDOM_H
+
+#include <cstdint>
+#include <random>
+
+inline uint32_t esp_random() {
+    static std::mt19937 generator(0x10C0);
+    return generator();
+}
+
+#endif // IOHC_NATIVE_ESP_RANDOM_H
@@ -0,0 +1,17 @@
+#ifndef IOHC_NATIVE_ESP_TIMER_H
+#define IOHC_NATIVE_ESP_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+
+// Host shim: microseconds since start, like on target
+inline int64_t esp_timer_get_time() {
+    using namespace std::chrono;
+    static const auto boot = steady_clock::now();
+    return duration_cast<microseconds>(steady_clock::now() - boot).count();
+}
+
+// Periodic timers are not run on the host, the handle only keeps the declarations building
+using esp_timer_handle_t = void *;
+
+#endif // IOHC_NATIVE_ESP_TIMER_H
@@ -0,0 +1,17 @@
+#ifndef IOHC_NATIVE_CRYPTO_HELPERS_H
+#define IOHC_NATIVE_CRYPTO_HELPERS_H
+
+#include <cstdint>
+#include <vector>
+
+#include <crypto2Wutils.h>
+
+// Host shim of the LoRa32 1W key and MAC helpers, see crypto2Wutils.cpp
+namespace iohcCrypto {
+    // Obfuscates (or clears) a 1W key pushed by node with the transfer key
+    void encrypt_1W_key(const uint8_t *node, uint8_t *key);
+    // frame starts at the command ID
+    void create_1W_hmac(uint8_t *hmac, uint8_t *sequence, uint8_t *key, std::vector<uint8_t> &frame);
+}
+
+#endif // IOHC_NATIVE_CRYPTO_HELPERS_H
@@ -0,0 +1,60 @@
+#ifndef IOHC_NATIVE_PACKET_H
+#define IOHC_NATIVE_PACKET_H
+
+#include <cstdint>
+
+/*
+ * Host shim of the LoRa32 iohcPacket: the frame buffer and the radio settings the portable modules use,
+ * laid out as on target. The library header pulls the radio driver in, it does not build on the host.
+ */
+namespace IOHC {
+    struct iohcPacket {
+        union {
+            uint8_t buffer[32]; // frameMaxSize, without the CRC
+            struct __attribute__((packed)) {
+                struct __attribute__((packed)) {
+                    union {
+                        uint8_t asByte;
+                        struct {
+                            uint8_t MsgLen : 5;
+                            uint8_t Protocol : 1;
+                            uint8_t StartFrame : 1;
+                            uint8_t EndFrame : 1;
+                        } asStruct;
+                    } CtrlByte1;
+                    union {
+                        uint8_t asByte;
+                        struct {
+                            uint8_t LPM : 1;
+                            uint8_t Beacon : 1;
+                            uint8_t Routed : 1;
+                            uint8_t Prio : 1;
+                            uint8_t Unk : 2;
+                            uint8_t Version : 2;
+                        } asStruct;
+                    } CtrlByte2;
+                    uint8_t target[3];
+                    uint8_t source[3];
+                    uint8_t cmd;
+                } header;
+                union {
+                    struct __attribute__((packed)) {
+                        uint8_t data[2];
+                        uint8_t sequence[2];
+                        uint8_t hmac[6];
+                    } p0x39;
+                    uint8_t raw[23];
+                } msg;
+            } packet;
+        } payload;
+        uint8_t buffer_length = 0;
+        uint32_t frequency = 0;
+        float rssi = 0;
+        uint8_t repeat = 0;
+        uint32_t repeatTime = 0;
+        uint32_t delayed = 0;
+        bool lock = false;
+    };
+}
+
+#endif // IOHC_NATIVE_PACKET_H
@@ -0,0 +1,15 @@
+#ifndef IOHC_NATIVE_RADIO_H
+#define IOHC_NATIVE_RADIO_H
+
+#include <cstdint>
+
+/*
+ * Host shim of the radio globals used by the portable modules.
+ * There is no transceiver on the host, frames come from the replay tool.
+ */
+namespace IOHC {
+    inline uint64_t packetStamp = 0;
+    inline uint8_t lastSendCmd = 0;
+}
+
+#endif // IOHC_NATIVE_RADIO_H
@@ -0,0 +1,179 @@
+#include "iohcCaptureFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace IOHC {
+    bool iohcCaptureFilter::matches(const iohcCaptureBlock &block) const {
+        if (!block.count || block.lastStamp < from || block.firstStamp > to) return false;
+        if (boot >= 0 && block.boot != boot) return false;
+        if (cmd >= 0 && !capture::hasCommand(block, static_cast<uint8_t>(cmd))) return false;
+        if (hasAddress && !capture::mayHaveAddress(block, address)) return false;
+        return true;
+    }
+
+    bool iohcCaptureFilter::matches(const iohcRxRecord &record) const {
+        if (record.stamp < from || record.stamp > to) return false;
+        if (cmd < 0 && !hasAddress) return true;
+        const iohcFrameView frame = record.view();
+        if (record.length < frameHeaderSize) return false;
+        if (cmd >= 0 && frame.cmd() != cmd) return false;
+        if (hasAddress && memcmp(frame.source(), address, 3) != 0 && memcmp(frame.target(), address, 3) != 0)
+            return false;
+        return true;
+    }
+
+    iohcCaptureWriter::iohcCaptureWriter(size_t blockSize, uint64_t origin)
+        : _blockSize(blockSize), _origin(origin) {
+        _pending.reserve(capture::recordsPerBlock(blockSize));
+    }
+
+    iohcCaptureWriter::~iohcCaptureWriter() { close(); }
+
+    bool iohcCaptureWriter::open(const char *path) {
+        close();
+        _file = fopen(path, "r+b");
+        if (!_file) _file = fopen(path, "w+b");
+        if (!_file) return false;
+
+        fseek(_file, 0, SEEK_END);
+        const long size = ftell(_file);
+        _blocks = static_cast<uint32_t>(size / _blockSize);
+        _header = capture::block(0, _blockSize, _origin);
+        _pending.clear();
+        if (!_blocks) return true;
+
+        // Resume after the newest block, reloading it when partially filled. Cleared archive pages are skipped.
+        bool found = false;
+        uint32_t newest = 0;
+        iohcCaptureBlock last{};
+        for (uint32_t n = 0; n < _blocks; n++) {
+            iohcCaptureBlock header{};
+            fseek(_file, static_cast<long>(n * _blockSize), SEEK_SET);
+            if (fread(&header, sizeof(header), 1, _file) != 1 || !capture::valid(header, _blockSize)) continue;
+            if (!found || header.sequence > last.sequence) {
+                last = header;
+                newest = n;
+            }
+            found = true;
+        }
+        if (!found) {
+            // Not a capture of that block size, never overwrite it
+            close();
+            return false;
+        }
+        if (last.count < capture::recordsPerBlock(_blockSize) && newest == _blocks - 1) {
+            _pending.resize(last.count);
+            fseek(_file, static_cast<long>(newest * _blockSize + sizeof(iohcCaptureBlock)), SEEK_SET);
+            if (last.count && fread(_pending.data(), sizeof(iohcRxRecord), last.count, _file) != last.count) {
+                close();
+                return false;
+            }
+            _blocks--;
+            _header = capture::block(last.sequence, _blockSize, last.origin, last.boot);
+        } else {
+            _header = capture::block(last.sequence + 1, _blockSize, last.origin, last.boot);
+        }
+        return true;
+    }
+
+    bool iohcCaptureWriter::append(const iohcRxRecord &record) {
+        if (!_file) return false;
+        _pending.push_back(record);
+        _dirty = true;
+        _records++;
+        if (_pending.size() < capture::recordsPerBlock(_blockSize)) return true;
+        if (!writeBlock()) return false;
+        _blocks++;
+        _header = capture::block(_header.sequence + 1, _blockSize, _header.origin, _header.boot);
+        _pending.clear();
+        return true;
+    }
+
+    // Whole block, padded, so the next one starts at n * blockSize
+    bool iohcCaptureWriter::writeBlock() {
+        iohcCaptureBlock header = capture::block(_header.sequence, _blockSize, _header.origin, _header.boot);
+        for (const auto &record : _pending) capture::index(header, record);
+        std::vector<uint8_t> block(_blockSize, 0);
+        memcpy(block.data(), &header, sizeof(header));
+        memcpy(block.data() + sizeof(header), _pending.data(), _pending.size() * sizeof(iohcRxRecord));
+        fseek(_file, static_cast<long>(_blocks * _blockSize), SEEK_SET);
+        _dirty = false;
+        return fwrite(block.data(), block.size(), 1, _file) == 1;
+    }
+
+    bool iohcCaptureWriter::flush() {
+        if (!_file) return false;
+        if (_dirty && !writeBlock()) return false;
+        return fflush(_file) == 0;
+    }
+
+    bool iohcCaptureWriter::close() {
+        if (!_file) return true;
+        bool ok = flush();
+        ok = fclose(_file) == 0 && ok;
+        _file = nullptr;
+        return ok;
+    }
+
+    iohcCaptureReader::~iohcCaptureReader() { close(); }
+
+    bool iohcCaptureReader::open(const char *path) {
+        close();
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(iohcCaptureBlock)) {
+            ::close(fd);
+            return false;
+        }
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) return false;
+        _map = static_cast<const uint8_t *>(map);
+        _mapSize = st.st_size;
+
+        // The first blocks of an archive may have been cleared: block size from the first valid header
+        size_t blockSize = 0;
+        for (size_t offset = 0; !blockSize && offset + sizeof(iohcCaptureBlock) <= _mapSize; offset += 16) {
+            const auto *header = reinterpret_cast<const iohcCaptureBlock *>(_map + offset);
+            if (header->magic == captureMagic && header->blockSize >= sizeof(iohcCaptureBlock) + sizeof(iohcRxRecord) &&
+                offset % header->blockSize == 0 && capture::valid(*header, header->blockSize))
+                blockSize = header->blockSize;
+        }
+        if (!blockSize) {
+            close();
+            return false;
+        }
+        for (size_t offset = 0; offset + blockSize <= _mapSize; offset += blockSize) {
+            const auto *header = reinterpret_cast<const iohcCaptureBlock *>(_map + offset);
+            if (capture::valid(*header, blockSize) && header->count) _order.push_back(header);
+        }
+        std::sort(_order.begin(), _order.end(),
+                  [](const iohcCaptureBlock *a, const iohcCaptureBlock *b) { return a->sequence < b->sequence; });
+        return true;
+    }
+
+    void iohcCaptureReader::close() {
+        if (_map) munmap(const_cast<uint8_t *>(_map), _mapSize);
+        _map = nullptr;
+        _mapSize = 0;
+        _order.clear();
+    }
+
+    uint64_t iohcCaptureReader::size() const {
+        uint64_t count = 0;
+        for (const auto *header : _order) count += header->count;
+        return count;
+    }
+
+    bool iohcCaptureReader::isCapture(const char *path) {
+        iohcCaptureReader reader;
+        return reader.open(path);
+    }
+}
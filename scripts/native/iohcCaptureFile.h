@@ -0,0 +1,98 @@
+#ifndef IOHC_CAPTURE_FILE_H
+#define IOHC_CAPTURE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <iohcCapture.h>
+
+/*
+ * Host side of the capture format (include/iohcCapture.h): an append-only writer and a reader
+ * mapping the whole file, archive files pulled from a gateway included.
+ */
+namespace IOHC {
+    // Fields left at their default match everything
+    struct iohcCaptureFilter {
+        int cmd = -1;
+        bool hasAddress = false;
+        uint8_t address[3] = {}; // Source or target
+        int64_t boot = -1;       // Blocks of this boot of the writer, from and to count from it
+        uint64_t from = 0;
+        uint64_t to = UINT64_MAX;
+
+        bool matches(const iohcCaptureBlock &block) const;
+        bool matches(const iohcRxRecord &record) const;
+    };
+
+    class iohcCaptureWriter {
+    public:
+        explicit iohcCaptureWriter(size_t blockSize = 4096, uint64_t origin = 0);
+        ~iohcCaptureWriter();
+
+        // Appends to an existing capture, the last block is completed before a new one is started
+        bool open(const char *path);
+        bool append(const iohcRxRecord &record);
+        // Writes the block being filled, the file is a valid capture after every flush
+        bool flush();
+        bool close();
+
+        uint64_t records() const { return _records; }
+
+    private:
+        bool writeBlock();
+
+        FILE *_file = nullptr;
+        size_t _blockSize;
+        uint64_t _origin;
+        uint32_t _blocks = 0;         // Blocks on file, the one being filled included once written
+        iohcCaptureBlock _header{};
+        std::vector<iohcRxRecord> _pending;
+        bool _dirty = false;
+        uint64_t _records = 0;
+    };
+
+    class iohcCaptureReader {
+    public:
+        iohcCaptureReader() = default;
+        ~iohcCaptureReader();
+        iohcCaptureReader(const iohcCaptureReader &) = delete;
+        iohcCaptureReader &operator=(const iohcCaptureReader &) = delete;
+
+        // Block size comes from the first valid block, invalid or cleared blocks are skipped
+        bool open(const char *path);
+        void close();
+
+        size_t blocks() const { return _order.size(); }
+        const iohcCaptureBlock &block(size_t n) const { return *_order[n]; }
+        const iohcRxRecord *records(size_t n) const { return reinterpret_cast<const iohcRxRecord *>(_order[n] + 1); }
+        uint64_t size() const;
+
+        // Records in sequence order, blocks whose index cannot match are skipped. Returns the matching count.
+        template<class Func>
+        uint64_t forEach(const iohcCaptureFilter &filter, Func &&func) const {
+            uint64_t matched = 0;
+            for (size_t n = 0; n < blocks(); n++) {
+                if (!filter.matches(block(n))) continue;
+                const iohcRxRecord *first = records(n);
+                for (const iohcRxRecord *r = first; r != first + block(n).count; r++) {
+                    if (!filter.matches(*r)) continue;
+                    func(*r);
+                    matched++;
+                }
+            }
+            return matched;
+        }
+
+        // True when path holds at least one capture block, text inputs are told apart this way
+        static bool isCapture(const char *path);
+
+    private:
+        const uint8_t *_map = nullptr;
+        size_t _mapSize = 0;
+        std::vector<const iohcCaptureBlock *> _order;
+    };
+}
+
+#endif // IOHC_CAPTURE_FILE_H
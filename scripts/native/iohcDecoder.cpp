@@ -0,0 +1,182 @@
+#include "iohcDecoder.h"
+
+#include <cmath>
+
+#include <iohcCrc.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+namespace IOHC {
+    namespace decoder {
+        // End of the 0xFF sync byte then 0x33: the decoder joins in the middle of the 0xFF high run
+        static constexpr uint32_t syncTail = (0b11u << 10) | uartSymbol(0x33);
+        static constexpr uint32_t syncTailMask = 0xFFF;
+        static_assert((syncPattern & syncTailMask) == syncTail, "Sync tail is the end of the sync word");
+        // Bits sampled after the preamble before giving up on the sync word
+        static constexpr uint32_t syncSearchBits = 40;
+
+        size_t findEdge(const uint8_t *samples, size_t n, uint8_t level) {
+            size_t i = 0;
+#if defined(__SSE2__)
+            const __m128i ref = _mm_set1_epi8(static_cast<char>(level));
+            for (; i + 16 <= n; i += 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+                const int differs = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, ref)) ^ 0xFFFF;
+                if (differs) return i + __builtin_ctz(differs);
+            }
+#elif defined(__ARM_NEON)
+            const uint8x16_t ref = vdupq_n_u8(level);
+            for (; i + 16 <= n; i += 16) {
+                const uint64x2_t differs = vreinterpretq_u64_u8(vmvnq_u8(vceqq_u8(vld1q_u8(samples + i), ref)));
+                const uint64_t low = vgetq_lane_u64(differs, 0);
+                const uint64_t high = vgetq_lane_u64(differs, 1);
+                if (low) return i + __builtin_ctzll(low) / 8;
+                if (high) return i + 8 + __builtin_ctzll(high) / 8;
+            }
+#endif
+            for (; i < n; i++)
+                if (samples[i] != level) return i;
+            return n;
+        }
+    }
+
+    iohcDecoder::iohcDecoder(uint8_t channel, float samplesPerBit, uint32_t minPreambleCycles)
+        : _channel(channel), _nominal(2 * samplesPerBit), _minCycles(minPreambleCycles) {
+        _frame.channel = channel;
+    }
+
+    void iohcDecoder::reset() {
+        lost();
+        _level = 0;
+        _tick = 0;
+        _stats = {};
+    }
+
+    void iohcDecoder::lost() {
+        _mode = mode::hunt;
+        _cycles = 0;
+        _lastFall = 0;
+    }
+
+    /**
+     * Preamble and silence are walked edge to edge with findEdge, only the bits after the preamble are
+     * sampled one by one. The bit clock is realigned on every edge, at least once per UART byte.
+     */
+    void iohcDecoder::feed(const uint8_t *samples, size_t n) {
+        const uint64_t base = _stats.samples;
+        const float lostLimit = 1.44f * _nominal; // No falling edge for that long ends the preamble
+        size_t i = 0;
+        while (i < n) {
+            if (_mode == mode::hunt || _mode == mode::preamble) {
+                const size_t j = i + decoder::findEdge(samples + i, n - i, _level);
+                if (_mode == mode::preamble && base + j >= _lastFall + lostLimit) {
+                    const uint64_t end = _lastFall + static_cast<uint64_t>(std::ceil(lostLimit));
+                    if (_cycles < _minCycles) {
+                        lost();
+                    } else {
+                        // Inside the high run of 0xFF: phase from its rising edge, then sample bit by bit
+                        _stats.preambles++;
+                        _mode = mode::sync;
+                        _bitLen = static_cast<float>(_lastFall - _preambleStart) / _cycles / 2;
+                        _nextCenter = _tick - 0.5 + _bitLen / 2;
+                        while (_nextCenter < end) _nextCenter += _bitLen;
+                        _shift = 0;
+                        _bits = 0;
+                        i = end > base + i ? end - base : i;
+                        continue;
+                    }
+                }
+                if (j == n) break;
+                i = j;
+                _level = samples[i];
+                _tick = base + i;
+                if (!_level) edge(_tick);
+                i++;
+                continue;
+            }
+
+            const uint8_t v = samples[i];
+            const uint64_t tick = base + i;
+            if (v != _level) {
+                _level = v;
+                _tick = tick;
+                // The edge happened between the previous sample and this one
+                _nextCenter = tick - 0.5 + _bitLen / 2;
+            }
+            if (tick >= _nextCenter) {
+                _nextCenter += _bitLen;
+                bit(v != 0);
+            }
+            i++;
+        }
+        _stats.samples += n;
+    }
+
+    // Falling edges while hunting or in the preamble, 0x55 gives one each 2 bits
+    void iohcDecoder::edge(uint64_t tick) {
+        const float delay = static_cast<float>(tick - _lastFall);
+        if (_mode == mode::hunt) {
+            if (_lastFall && delay >= 0.89f * _nominal && delay <= 1.11f * _nominal) {
+                _mode = mode::preamble;
+                _preambleStart = _lastFall;
+                _cycles = 1;
+            }
+        } else if (delay >= 0.78f * _nominal && delay <= 1.22f * _nominal) {
+            _cycles++;
+        } else {
+            _mode = mode::hunt;
+            _cycles = 0;
+        }
+        _lastFall = tick;
+    }
+
+    void iohcDecoder::bit(uint8_t value) {
+        _shift = _shift << 1 | value;
+        if (_mode == mode::sync) {
+            if ((_shift & decoder::syncTailMask) == decoder::syncTail) {
+                _stats.syncs++;
+                _mode = mode::frame;
+                _bits = 0;
+                _frame.tick = _preambleStart;
+                _frame.length = 0;
+                _expected = 0;
+                _idle = 0;
+            } else if (++_bits > decoder::syncSearchBits) {
+                lost();
+            }
+            return;
+        }
+
+        // Idle high between bytes, the frame is over when it lasts more than a symbol
+        if (_bits == 0 && value) {
+            if (++_idle > 10) {
+                _stats.framingErrors++;
+                lost();
+            }
+            return;
+        }
+        _idle = 0;
+        if (++_bits < 10) return;
+        _bits = 0;
+        const uint16_t entry = decoder::uartLut[_shift & 0x3FF];
+        if (entry & 0x100) {
+            _stats.framingErrors++;
+            lost();
+            return;
+        }
+        _frame.bytes[_frame.length++] = static_cast<uint8_t>(entry);
+        if (_frame.length == 1) _expected = (_frame.bytes[0] & 0x1F) + 1 + 2;
+        if (_frame.length < _expected) return;
+
+        const uint16_t crc = _frame.bytes[_expected - 2] | _frame.bytes[_expected - 1] << 8;
+        _frame.crcOk = crc16Kermit(_frame.bytes, _expected - 2) == crc;
+        if (_frame.crcOk) _stats.frames++;
+        else _stats.crcErrors++;
+        if (_onFrame) _onFrame(_frame);
+        lost();
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef IOHC_DECODER_H
+#define IOHC_DECODER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#include <iohcCapture.h>
+#include <iohcFrame.h>
+
+/*
+ * Host decoder for sliced io-homecontrol samples, as produced by the GNURadio demodulator
+ * (scripts/GNURadio/io_home_demod.grc): one byte per sample, 0 or 1.
+ * Same air format as the Python block epy_block_0.py: 0x55 preamble, UART framed bytes
+ * (start bit, 8 bits LSB first, stop bit), 0xFF 0x33 sync then the frame and its CRC-16/KERMIT.
+ * Works on any chunk size, one decoder per channel.
+ */
+namespace IOHC {
+    struct iohcDecodedFrame {
+        uint8_t channel;
+        uint64_t tick;     // Sample index of the preamble start
+        bool crcOk;
+        uint8_t length;    // Frame bytes, CRC included
+        uint8_t bytes[frameMaxSize + 2];
+
+        iohcFrameView view() const { return {bytes, length >= 2 ? length - 2u : 0u}; }
+
+        // Capture record of the frame, without its CRC. The channel is stored as the radio.
+        iohcRxRecord record(double samplesPerSecond, uint32_t frequency = 0) const {
+            iohcRxRecord out{};
+            out.stamp = static_cast<uint64_t>(tick * 1e6 / samplesPerSecond);
+            out.frequency = frequency;
+            out.rssi = 0;
+            out.length = length >= 2 ? length - 2 : 0;
+            out.radio = channel;
+            out.flags = crcOk ? 0 : rxCrcError;
+            memcpy(out.buffer, bytes, out.length);
+            return out;
+        }
+    };
+
+    struct iohcDecoderStats {
+        uint64_t samples = 0;
+        uint32_t preambles = 0;
+        uint32_t syncs = 0;        // Preambles followed by the 0xFF 0x33 sync word
+        uint32_t frames = 0;
+        uint32_t crcErrors = 0;
+        uint32_t framingErrors = 0; // Bad stop bit or invalid length
+    };
+
+    namespace decoder {
+        // 10 bits UART symbol in arrival order (first bit in bit 9) to its data byte, bit 8 set when the
+        // start or stop bit is wrong
+        constexpr std::array<uint16_t, 1024> uartTable() {
+            std::array<uint16_t, 1024> table{};
+            for (uint16_t symbol = 0; symbol < 1024; symbol++) {
+                const bool start = symbol & 0x200;
+                const bool stop = symbol & 0x001;
+                uint8_t data = 0;
+                for (uint8_t i = 0; i < 8; i++)
+                    if (symbol & (0x100 >> i)) data |= 1 << i;
+                table[symbol] = data | ((start || !stop) ? 0x100 : 0);
+            }
+            return table;
+        }
+        inline constexpr std::array<uint16_t, 1024> uartLut = uartTable();
+
+        constexpr uint16_t uartSymbol(uint8_t data) {
+            uint16_t symbol = 0; // Start bit 0
+            for (uint8_t i = 0; i < 8; i++) symbol = symbol << 1 | ((data >> i) & 1);
+            return symbol << 1 | 1; // Stop bit
+        }
+        // 0xFF then 0x33, 20 bits
+        inline constexpr uint32_t syncPattern = uint32_t(uartSymbol(0xFF)) << 10 | uartSymbol(0x33);
+
+        // Index of the first sample different from level, n when none. SSE2 or NEON when available.
+        size_t findEdge(const uint8_t *samples, size_t n, uint8_t level);
+    }
+
+    class iohcDecoder {
+    public:
+        using frameFunc = std::function<void(const iohcDecodedFrame &frame)>;
+
+        /**
+         * samplesPerBit: nominal oversampling, samp_rate / 38400. The bit period is measured on every preamble,
+         * the nominal value only sets the accepted range.
+         */
+        iohcDecoder(uint8_t channel, float samplesPerBit, uint32_t minPreambleCycles = 64);
+
+        void onFrame(frameFunc func) { _onFrame = std::move(func); }
+        void feed(const uint8_t *samples, size_t n);
+        void reset();
+
+        const iohcDecoderStats &stats() const { return _stats; }
+        uint8_t channel() const { return _channel; }
+
+    private:
+        enum class mode : uint8_t { hunt, preamble, sync, frame };
+
+        void edge(uint64_t tick);
+        void bit(uint8_t value);
+        void lost();
+
+        uint8_t _channel;
+        float _nominal;         // Samples per preamble cycle (2 bits)
+        uint32_t _minCycles;
+        frameFunc _onFrame;
+        iohcDecoderStats _stats;
+
+        mode _mode = mode::hunt;
+        uint8_t _level = 0;
+        uint64_t _tick = 0;
+        uint64_t _lastFall = 0;
+        uint64_t _preambleStart = 0;
+        uint32_t _cycles = 0;
+        float _bitLen = 0;
+        double _nextCenter = 0; // Sample of the next bit center, realigned on every edge
+        uint32_t _shift = 0;
+        uint32_t _bits = 0;     // Bits since the last symbol or since the preamble
+        uint32_t _idle = 0;     // High bits waiting for the next start bit
+        iohcDecodedFrame _frame{};
+        uint8_t _expected = 0;
+    };
+}
+
+#endif // IOHC_DECODER_H
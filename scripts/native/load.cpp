@@ -0,0 +1,462 @@
+/*
+ * Load regression suite: scripted traffic mixes go through the firmware RX rings and dispatcher on a virtual air clock,
+ * and frame loss, 2W challenge answer latency and dispatch heap high water are compared against a baseline.
+ *
+ *   pio run -e native_load && .pio/build/native_load/program [-d ms] [-s seed] [-c cpu scale] [-w capture]
+ *                                                           [-o overhead us] [--baseline file [--tolerance %]] [--save file]
+ *
+ * Frames are scheduled on three channels at 38.4 kb/s, each channel serialized as on air, and land in one
+ * spscRing per channel as the radio callbacks do. The dispatch task model takes the oldest queued frame, runs the
+ * real handlers (1W MAC check, 2W challenge answer, JSON serialization) and holds the slot for the measured host
+ * time multiplied by the CPU scale, 25 being about an ESP32 at 240 MHz, plus a fixed overhead per frame for what
+ * the host does not run (trace output, MQTT publish). A full ring drops the frame, as on the device.
+ * The answer latency includes that overhead, the cpu columns are the scaled handler time alone.
+ * The heap column is the most the dispatcher and the serializer held above what was live before the frame.
+ *   flood1W   12 remotes pressing with repeats, MACs computed with one shared key
+ *   2W        16 devices challenging the gateway on random channels
+ *   discovery 48 devices answering a discovery within 300 ms on all channels
+ *   mix       all three at once
+ * -w writes the mix as a capture (iohcCapture.h), for replay or to feed an emulated radio.
+ * Exit code: 0 ok, 1 usage or file error, 2 regression against the baseline.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <iohc1WAuth.h>
+#include <iohcDispatcher.h>
+#include <iohcFrame.h>
+#include <iohcFrameJson.h>
+#include <iohcInitialValue.h>
+#include <iohcKeyCache.h>
+#include <iohcSpscRing.h>
+
+#include "iohcCaptureFile.h"
+
+// Same default as iohcRxPipeline.h, which needs FreeRTOS
+#ifndef IOHC_RX_QUEUE_SIZE
+    #define IOHC_RX_QUEUE_SIZE 16
+#endif
+
+using namespace IOHC;
+using loadClock = std::chrono::steady_clock;
+
+// Live and peak heap bytes, every allocation of the process goes through here
+namespace {
+    std::atomic<size_t> heapLive{0};
+    std::atomic<size_t> heapPeak{0};
+    constexpr size_t heapHeader = alignof(std::max_align_t);
+
+    void *heapAlloc(size_t size) {
+        auto *p = static_cast<uint8_t *>(malloc(size + heapHeader));
+        if (!p) throw std::bad_alloc();
+        *reinterpret_cast<size_t *>(p) = size;
+        const size_t live = heapLive.fetch_add(size) + size;
+        size_t peak = heapPeak.load();
+        while (live > peak && !heapPeak.compare_exchange_weak(peak, live)) {}
+        return p + heapHeader;
+    }
+
+    void heapFree(void *ptr) {
+        if (!ptr) return;
+        auto *p = static_cast<uint8_t *>(ptr) - heapHeader;
+        heapLive.fetch_sub(*reinterpret_cast<size_t *>(p));
+        free(p);
+    }
+}
+
+void *operator new(size_t size) { return heapAlloc(size); }
+void *operator new[](size_t size) { return heapAlloc(size); }
+void operator delete(void *p) noexcept { heapFree(p); }
+void operator delete[](void *p) noexcept { heapFree(p); }
+void operator delete(void *p, size_t) noexcept { heapFree(p); }
+void operator delete[](void *p, size_t) noexcept { heapFree(p); }
+
+namespace {
+    constexpr uint32_t bitRate = 38400;
+    constexpr size_t preambleBytes = 8;   // Before the 0xFF 0x33 sync
+    constexpr uint64_t interFrameUs = 1000; // Least silence between two frames of a channel
+    constexpr size_t channels = 3;
+    constexpr uint32_t frequencies[channels] = {868250000, 868950000, 869850000};
+    constexpr uint8_t channel1W = 1;
+    constexpr uint8_t gateway[3] = {0xFE, 0xC0, 0xBA};
+    constexpr uint8_t key1W[16] = {0x34, 0xC3, 0x46, 0x6E, 0xD8, 0x8F, 0x4E, 0x8E,
+                                   0x16, 0xAA, 0x47, 0x39, 0x49, 0x88, 0x43, 0x72};
+
+    constexpr uint8_t cmdChallenge = 0x3C;
+    constexpr uint8_t cmdDiscoverAnswer = 0x29;
+
+    struct airFrame {
+        uint64_t at; // End of the frame, when the radio callback runs
+        uint8_t channel;
+        iohcRxRecord record;
+    };
+
+    uint64_t airtimeUs(size_t length) { return (preambleBytes + 2 + length + 2) * 10 * 1000000ull / bitRate; }
+
+    class traffic {
+    public:
+        explicit traffic(uint32_t seed) : _random(seed) {}
+
+        // Sent as soon as the channel is free after at, see frames()
+        void send(uint64_t at, uint8_t channel, const uint8_t *frame, size_t length) {
+            airFrame f{at, channel, {}};
+            f.record.frequency = frequencies[channel];
+            f.record.rssi = -60 - static_cast<int8_t>(_random() % 30);
+            f.record.length = length;
+            f.record.radio = channel;
+            memcpy(f.record.buffer, frame, length);
+            _frames.push_back(f);
+        }
+
+        // Each press is sent three times with the same sequence number, the next press counts up
+        void flood1W(uint64_t durationUs, size_t remotes) {
+            iohcAesKey key;
+            key.setKey(key1W);
+            for (size_t r = 0; r < remotes; r++) {
+                const uint8_t source[3] = {0x8F, 0x9E, static_cast<uint8_t>(r)};
+                uint16_t sequence = _random() & 0xFFF;
+                for (uint64_t at = _random() % 200000; at < durationUs; at += 300000 + _random() % 500000) {
+                    uint8_t frame[frameMaxSize] = {0, 0, 0x00, 0x00, 0x3F};
+                    const uint8_t params[] = {0x01, 0x43, static_cast<uint8_t>(_random() % 2 ? 0xD2 : 0x00), 0x00};
+                    const size_t length = frameHeaderSize + sizeof(params) + frame1WFooterSize;
+                    frame[0] = 0xC0 | 0x20 | (length - 1);
+                    memcpy(frame + 5, source, 3);
+                    frame[8] = 0x00;
+                    memcpy(frame + frameHeaderSize, params, sizeof(params));
+                    uint8_t *footer = frame + frameHeaderSize + sizeof(params);
+                    footer[0] = sequence >> 8;
+                    footer[1] = sequence;
+                    uint8_t iv[16];
+                    initialValue(frame + frameHeaderSize - 1, sizeof(params) + 1, nullptr, footer, iv);
+                    key.encrypt(iv);
+                    memcpy(footer + 2, iv, 6);
+                    for (int repeat = 0; repeat < 3; repeat++) send(at + repeat * 25000, channel1W, frame, length);
+                    sequence++;
+                }
+            }
+        }
+
+        // Challenges the gateway has to answer, as after every 2W command
+        void challenges(uint64_t durationUs, size_t devices) {
+            for (size_t d = 0; d < devices; d++) {
+                for (uint64_t at = _random() % 100000; at < durationUs; at += 80000 + _random() % 200000) {
+                    uint8_t frame[frameHeaderSize + 6] = {frameHeaderSize + 6 - 1, 0};
+                    memcpy(frame + 2, gateway, 3);
+                    frame[5] = 0xCD;
+                    frame[6] = 0x12;
+                    frame[7] = static_cast<uint8_t>(d);
+                    frame[8] = cmdChallenge;
+                    for (size_t i = 0; i < 6; i++) frame[frameHeaderSize + i] = _random();
+                    send(at, _random() % channels, frame, sizeof(frame));
+                }
+            }
+        }
+
+        // Every device answers each discovery round within 300 ms on its channel
+        void discovery(uint64_t durationUs, size_t devices) {
+            for (uint64_t round = 0; round < durationUs; round += 600000) {
+                for (size_t d = 0; d < devices; d++) {
+                    uint8_t frame[frameHeaderSize + 9] = {frameHeaderSize + 9 - 1, 0};
+                    memcpy(frame + 2, gateway, 3);
+                    frame[5] = 0xA1;
+                    frame[6] = 0xB2;
+                    frame[7] = static_cast<uint8_t>(d);
+                    frame[8] = cmdDiscoverAnswer;
+                    for (size_t i = 0; i < 9; i++) frame[frameHeaderSize + i] = _random();
+                    send(round + _random() % 300000, d % channels, frame, sizeof(frame));
+                }
+            }
+        }
+
+        // In air order: a frame wanted while its channel is busy goes out right after
+        std::vector<airFrame> frames() {
+            auto byTime = [](const airFrame &a, const airFrame &b) { return a.at < b.at; };
+            std::stable_sort(_frames.begin(), _frames.end(), byTime);
+            uint64_t free[channels] = {};
+            for (airFrame &f : _frames) {
+                f.at = std::max(f.at, free[f.channel]) + airtimeUs(f.record.length);
+                f.record.stamp = f.at;
+                free[f.channel] = f.at + interFrameUs;
+            }
+            std::stable_sort(_frames.begin(), _frames.end(), byTime);
+            return _frames;
+        }
+
+    private:
+        std::mt19937 _random;
+        std::vector<airFrame> _frames;
+    };
+
+    volatile uint32_t sink = 0;
+
+    bool load1W(iohcPacket *iohc) {
+        const iohcFrameView frame(iohc);
+        if (!frame.valid()) return true;
+        iohc1WAuth *auth = iohc1WAuth::getInstance();
+        const uint8_t *source = iohc->payload.packet.header.source;
+        if (!auth->knows(source)) auth->learn(source, key1W);
+        sink = sink + static_cast<uint8_t>(auth->verify(frame));
+        return true;
+    }
+
+    // Answer of the 0x3C handler: MAC over the memorized command
+    bool load2W(iohcPacket *iohc) {
+        if (iohc->payload.packet.header.cmd != cmdChallenge || iohc->buffer_length < frameHeaderSize + 6) return true;
+        const uint8_t ivData[] = {0x20};
+        uint8_t mac[16];
+        create2WHmac(mac, ivData, sizeof(ivData), iohcFrameView(iohc).params().data, iohcKeyCache::getInstance()->transfer());
+        sink = sink + mac[0];
+        return true;
+    }
+
+    bool loadHandler(iohcPacket *iohc) { return iohcFrameView(iohc).oneWay() ? load1W(iohc) : load2W(iohc); }
+
+    struct result {
+        uint64_t frames = 0;
+        uint64_t lost = 0;
+        size_t queueMax = 0;
+        std::vector<uint64_t> answers; // 0x3C radio callback to answer, us
+        std::vector<uint64_t> cpu;     // Scaled host time of the 0x3C handlers, us
+        size_t heap = 0;
+        double hostNs = 0;
+
+        double lossPct() const { return frames ? 100.0 * lost / frames : 0; }
+        uint64_t answer(size_t permille) const { return answers.empty() ? 0 : answers[answers.size() * permille / 1000]; }
+        uint64_t answerCpu(size_t permille) const { return cpu.empty() ? 0 : cpu[cpu.size() * permille / 1000]; }
+    };
+
+    // Discrete events on the air clock: arrivals fill the rings, the dispatch model drains them
+    result simulate(const std::vector<airFrame> &frames, double cpuScale, uint64_t overheadUs) {
+        static spscRing<iohcRxRecord, IOHC_RX_QUEUE_SIZE> rings[channels];
+        for (auto &ring : rings)
+            while (ring.front()) ring.pop();
+        iohc1WAuth *auth = iohc1WAuth::getInstance();
+        for (size_t r = 0; r < 256; r++) {
+            const uint8_t source[3] = {0x8F, 0x9E, static_cast<uint8_t>(r)};
+            auth->forget(source);
+        }
+
+        result res;
+        res.frames = frames.size();
+        // Grown up front, only the allocations of the dispatch path are counted
+        res.answers.reserve(frames.size());
+        res.cpu.reserve(frames.size());
+        iohcDispatcher *dispatcher = iohcDispatcher::getInstance();
+        char json[frameJsonMaxSize()];
+        uint64_t hostTotal = 0;
+
+        size_t next = 0;
+        bool busy = false;
+        size_t busyRing = 0;
+        uint64_t busyUntil = 0;
+        uint64_t now = 0;
+        for (;;) {
+            if (!busy) {
+                // Oldest queued frame first, whatever its channel
+                const iohcRxRecord *oldest = nullptr;
+                for (size_t c = 0; c < channels; c++) {
+                    const iohcRxRecord *front = rings[c].front();
+                    if (front && (!oldest || front->stamp < oldest->stamp)) {
+                        oldest = front;
+                        busyRing = c;
+                    }
+                }
+                if (oldest) {
+                    iohcPacket iohc;
+                    oldest->toPacket(&iohc);
+                    const size_t heapBefore = heapLive.load();
+                    heapPeak.store(heapBefore);
+                    const auto start = loadClock::now();
+                    dispatcher->dispatch(&iohc);
+                    sink = sink + serializeFrame(json, sizeof(json), &iohc);
+                    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(loadClock::now() - start).count();
+                    res.heap = std::max(res.heap, heapPeak.load() - heapBefore);
+                    hostTotal += ns;
+                    const uint64_t cpuUs = ns * cpuScale / 1000;
+                    busyUntil = std::max(now, oldest->stamp) + std::max<uint64_t>(1, cpuUs + overheadUs);
+                    if (iohc.payload.packet.header.cmd == cmdChallenge && !iohcFrameView(&iohc).oneWay()) {
+                        res.answers.push_back(busyUntil - oldest->stamp);
+                        res.cpu.push_back(cpuUs);
+                    }
+                    busy = true;
+                    continue;
+                }
+            }
+            if (next < frames.size() && (!busy || frames[next].at < busyUntil)) {
+                const airFrame &f = frames[next++];
+                now = f.at;
+                iohcRxRecord *slot = rings[f.channel].back();
+                if (!slot) {
+                    res.lost++;
+                    continue;
+                }
+                *slot = f.record;
+                rings[f.channel].push();
+                size_t queued = 0;
+                for (const auto &ring : rings) queued += ring.size();
+                res.queueMax = std::max(res.queueMax, queued);
+            } else if (busy) {
+                now = busyUntil;
+                rings[busyRing].pop();
+                busy = false;
+            } else {
+                break;
+            }
+        }
+        std::sort(res.answers.begin(), res.answers.end());
+        std::sort(res.cpu.begin(), res.cpu.end());
+        res.hostNs = res.frames - res.lost ? (double) hostTotal / (res.frames - res.lost) : 0;
+        return res;
+    }
+
+    using metrics = std::map<std::string, double>;
+
+    void addMetrics(metrics &out, const std::string &name, const result &r) {
+        out[name + ".loss_pct"] = r.lossPct();
+        out[name + ".queue_max"] = r.queueMax;
+        out[name + ".answer_p50_us"] = r.answer(500);
+        out[name + ".answer_p99_us"] = r.answer(990);
+        out[name + ".answer_cpu_p50_us"] = r.answerCpu(500);
+        out[name + ".answer_cpu_p99_us"] = r.answerCpu(990);
+        out[name + ".heap_bytes"] = r.heap;
+    }
+
+    // Below these differences a change is noise, whatever the tolerance
+    double slack(const std::string &metric) {
+        if (metric.find("loss_pct") != std::string::npos) return 0.1;
+        if (metric.find("queue_max") != std::string::npos) return 2;
+        if (metric.find("_cpu_") != std::string::npos) return 5;
+        if (metric.find("_us") != std::string::npos) return 50;
+        return 256;
+    }
+
+    bool readMetrics(const char *path, metrics &out) {
+        std::ifstream in(path);
+        if (!in) return false;
+        for (std::string line; std::getline(in, line);) {
+            if (line.empty() || line[0] == '#') continue;
+            const size_t space = line.find(' ');
+            if (space != std::string::npos) out[line.substr(0, space)] = strtod(line.c_str() + space, nullptr);
+        }
+        return true;
+    }
+
+    int usage(const char *name) {
+        fprintf(stderr, "Usage: %s [-d ms] [-s seed] [-c cpu scale] [-o overhead us] [-w capture] [--baseline file [--tolerance %%]] [--save file]\n", name);
+        return 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint64_t durationUs = 2000000;
+    uint32_t seed = 1;
+    double cpuScale = 25;
+    uint64_t overheadUs = 500;
+    double tolerance = 30;
+    const char *baseline = nullptr;
+    const char *save = nullptr;
+    const char *output = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc) durationUs = strtoull(argv[++i], nullptr, 10) * 1000;
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) seed = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc) cpuScale = strtod(argv[++i], nullptr);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc) overheadUs = strtoull(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc) output = argv[++i];
+        else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) baseline = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) tolerance = strtod(argv[++i], nullptr);
+        else if (!strcmp(argv[i], "--save") && i + 1 < argc) save = argv[++i];
+        else return usage(argv[0]);
+    }
+    if (!durationUs || cpuScale <= 0) return usage(argv[0]);
+
+    iohcDispatcher *dispatcher = iohcDispatcher::getInstance();
+    for (unsigned cmd = 0; cmd < 256; cmd++) dispatcher->registerHandler(cmd, loadHandler);
+
+    struct scenario {
+        const char *name;
+        bool flood, challenge, discover;
+    };
+    const scenario scenarios[] = {
+        {"flood1W", true, false, false},
+        {"2W", false, true, false},
+        {"discovery", false, false, true},
+        {"mix", true, true, true},
+    };
+
+    // Lazy allocations and first use caches stay out of the numbers
+    {
+        traffic air(seed);
+        air.flood1W(durationUs, 12);
+        air.challenges(durationUs, 16);
+        simulate(air.frames(), cpuScale, overheadUs);
+    }
+
+    metrics current;
+    printf("%-10s %7s %6s %7s %6s %10s %10s %10s %8s %8s %8s %8s\n", "scenario", "frames", "lost", "loss%", "queue",
+           "answer p50", "p99", "max", "cpu p50", "cpu p99", "heap", "ns/frame");
+    for (const scenario &s : scenarios) {
+        traffic air(seed);
+        if (s.flood) air.flood1W(durationUs, 12);
+        if (s.challenge) air.challenges(durationUs, 16);
+        if (s.discover) air.discovery(durationUs, 48);
+        const std::vector<airFrame> frames = air.frames();
+        const result r = simulate(frames, cpuScale, overheadUs);
+        addMetrics(current, s.name, r);
+        printf("%-10s %7llu %6llu %7.2f %6zu %10llu %10llu %10llu %8llu %8llu %8zu %8.0f\n", s.name,
+               (unsigned long long) r.frames, (unsigned long long) r.lost, r.lossPct(), r.queueMax,
+               (unsigned long long) r.answer(500), (unsigned long long) r.answer(990),
+               (unsigned long long) (r.answers.empty() ? 0 : r.answers.back()), (unsigned long long) r.answerCpu(500),
+               (unsigned long long) r.answerCpu(990), r.heap, r.hostNs);
+
+        if (output && s.flood && s.challenge && s.discover) {
+            iohcCaptureWriter writer;
+            bool ok = writer.open(output);
+            for (const airFrame &f : frames) ok = ok && writer.append(f.record);
+            if (!writer.close() || !ok) {
+                fprintf(stderr, "Cannot write capture %s\n", output);
+                return 1;
+            }
+        }
+    }
+
+    if (save) {
+        FILE *f = fopen(save, "w");
+        if (!f) {
+            fprintf(stderr, "Cannot write %s\n", save);
+            return 1;
+        }
+        fprintf(f, "# load baseline: -d %llu -s %u -c %.0f -o %llu, lower is better\n",
+                (unsigned long long) (durationUs / 1000), (unsigned) seed, cpuScale, (unsigned long long) overheadUs);
+        for (const auto &m : current) fprintf(f, "%s %.2f\n", m.first.c_str(), m.second);
+        fclose(f);
+    }
+    if (!baseline) return 0;
+
+    metrics base;
+    if (!readMetrics(baseline, base)) {
+        fprintf(stderr, "Cannot read baseline %s\n", baseline);
+        return 1;
+    }
+    int regressions = 0;
+    for (const auto &m : base) {
+        auto it = current.find(m.first);
+        if (it == current.end()) continue;
+        const double limit = m.second * (1 + tolerance / 100) + slack(m.first);
+        if (it->second > limit) {
+            fprintf(stderr, "Regression %s: %.2f, baseline %.2f\n", m.first.c_str(), it->second, m.second);
+            regressions++;
+        }
+    }
+    printf("%d regressions against %s (%.0f%% tolerance)\n", regressions, baseline, tolerance);
+    return regressions ? 2 : 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Python bindings of the host decoder (module iohcdecode), built by setup.py next to this file.
+ *
+ *   decoder = iohcdecode.Decoder(channel=0, samples_per_bit=4.5)
+ *   for frame in decoder.feed(samples):   # numpy int8/uint8 array or bytes, one sliced sample per byte
+ *       print(frame.channel, frame.tick, frame.crc_ok, frame.data.hex())
+ *
+ *   capture = iohcdecode.CaptureWriter("capture.bin", samples_per_second=172800)
+ *   capture.append(frame)   # read back with scripts/Iown-Capture.py or the replay harness
+ */
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <vector>
+
+#include <iohcCrc.h>
+
+#include "../iohcCaptureFile.h"
+#include "../iohcDecoder.h"
+
+namespace py = pybind11;
+using namespace IOHC;
+
+namespace {
+    struct pyFrame {
+        uint8_t channel;
+        uint64_t tick;
+        bool crcOk;
+        py::bytes data; // CRC included
+        uint8_t cmd;
+        iohcDecodedFrame decoded; // For the capture writer
+    };
+
+    // Frames of one feed() call, handed back as a list so Python never runs inside the sample loop
+    class pyDecoder {
+    public:
+        pyDecoder(uint8_t channel, float samplesPerBit, uint32_t minPreambleCycles)
+            : _decoder(channel, samplesPerBit, minPreambleCycles) {
+            _decoder.onFrame([this](const iohcDecodedFrame &frame) { _frames.push_back(frame); });
+        }
+
+        std::vector<pyFrame> feed(py::buffer samples) {
+            py::buffer_info info = samples.request();
+            if (info.itemsize != 1 || info.ndim != 1) throw std::invalid_argument("samples: one byte per sample");
+            {
+                py::gil_scoped_release release;
+                _decoder.feed(static_cast<const uint8_t *>(info.ptr), static_cast<size_t>(info.shape[0]));
+            }
+            std::vector<pyFrame> out;
+            out.reserve(_frames.size());
+            for (const auto &frame : _frames)
+                out.push_back({frame.channel, frame.tick, frame.crcOk,
+                               py::bytes(reinterpret_cast<const char *>(frame.bytes), frame.length),
+                               frame.view().cmd(), frame});
+            _frames.clear();
+            return out;
+        }
+
+        py::dict stats() const {
+            const iohcDecoderStats &s = _decoder.stats();
+            py::dict out;
+            out["samples"] = s.samples;
+            out["preambles"] = s.preambles;
+            out["syncs"] = s.syncs;
+            out["frames"] = s.frames;
+            out["crc_errors"] = s.crcErrors;
+            out["framing_errors"] = s.framingErrors;
+            return out;
+        }
+
+        void reset() { _decoder.reset(); }
+
+    private:
+        iohcDecoder _decoder;
+        std::vector<iohcDecodedFrame> _frames;
+    };
+
+    class pyCaptureWriter {
+    public:
+        pyCaptureWriter(const std::string &path, double samplesPerSecond, uint32_t frequency)
+            : _samplesPerSecond(samplesPerSecond), _frequency(frequency) {
+            if (!_writer.open(path.c_str())) throw std::runtime_error("Cannot write capture " + path);
+        }
+
+        void append(const pyFrame &frame) { _writer.append(frame.decoded.record(_samplesPerSecond, _frequency)); }
+        void flush() { _writer.flush(); }
+        void close() { _writer.close(); }
+        uint64_t records() const { return _writer.records(); }
+
+    private:
+        iohcCaptureWriter _writer;
+        double _samplesPerSecond;
+        uint32_t _frequency;
+    };
+
+    // CRC-16/KERMIT of the firmware, over bytes without their 2 CRC bytes
+    uint16_t crc16(py::bytes data) {
+        const std::string raw = data;
+        return crc16Kermit(reinterpret_cast<const uint8_t *>(raw.data()), raw.size());
+    }
+
+    // Frame as printed by rtl_433 or Iown-IoHexFrameParser.py, CRC appended little endian
+    bool checkFrame(py::bytes frame) {
+        const std::string raw = frame;
+        if (raw.size() < 3) return false;
+        const auto *bytes = reinterpret_cast<const uint8_t *>(raw.data());
+        const uint16_t crc = bytes[raw.size() - 2] | bytes[raw.size() - 1] << 8;
+        return crc16Kermit(bytes, raw.size() - 2) == crc;
+    }
+}
+
+PYBIND11_MODULE(iohcdecode, m) {
+    m.doc() = "io-homecontrol frame decoder for sliced SDR samples";
+
+    py::class_<pyFrame>(m, "Frame")
+        .def_readonly("channel", &pyFrame::channel)
+        .def_readonly("tick", &pyFrame::tick)
+        .def_readonly("crc_ok", &pyFrame::crcOk)
+        .def_readonly("data", &pyFrame::data)
+        .def_readonly("cmd", &pyFrame::cmd);
+
+    py::class_<pyDecoder>(m, "Decoder")
+        .def(py::init<uint8_t, float, uint32_t>(), py::arg("channel") = 0, py::arg("samples_per_bit") = 4.5f,
+             py::arg("min_preamble_cycles") = 64)
+        .def("feed", &pyDecoder::feed, py::arg("samples"))
+        .def("reset", &pyDecoder::reset)
+        .def_property_readonly("stats", &pyDecoder::stats);
+
+    py::class_<pyCaptureWriter>(m, "CaptureWriter")
+        .def(py::init<const std::string &, double, uint32_t>(), py::arg("path"), py::arg("samples_per_second"),
+             py::arg("frequency") = 0)
+        .def("append", &pyCaptureWriter::append, py::arg("frame"))
+        .def("flush", &pyCaptureWriter::flush)
+        .def("close", &pyCaptureWriter::close)
+        .def_property_readonly("records", &pyCaptureWriter::records);
+
+    m.def("crc16", &crc16, py::arg("data"));
+    m.def("check_frame", &checkFrame, py::arg("frame"));
+}
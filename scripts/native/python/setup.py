@@ -0,0 +1,26 @@
+# Builds the iohcdecode module: pip install ./scripts/native/python (needs pybind11 and a C++17 compiler)
+from pathlib import Path
+
+from pybind11.setup_helpers import Pybind11Extension, build_ext
+from setuptools import setup
+
+here = Path(__file__).resolve().parent
+native = here.parent
+root = native.parent.parent
+
+setup(
+    name="iohcdecode",
+    version="0.1.0",
+    description="io-homecontrol frame decoder for sliced SDR samples",
+    ext_modules=[
+        Pybind11Extension(
+            "iohcdecode",
+            [str(here / "iohcDecoderPy.cpp"), str(native / "iohcDecoder.cpp"), str(native / "iohcCaptureFile.cpp")],
+            include_dirs=[str(root / "include"), str(native)],
+            cxx_std=17,
+            extra_compile_args=["-O2"],
+        )
+    ],
+    cmdclass={"build_ext": build_ext},
+    zip_safe=False,
+)
@@ -0,0 +1,253 @@
+/*
+ * Native replay harness: feeds recorded frames through the portable receive path as fast as possible
+ * and reports frames/sec and per stage latency.
+ *
+ *   pio run -e native && .pio/build/native/program [-n rounds] [-k 1W key] [--min-fps N] [-w capture] frames.txt|capture
+ *
+ * Input lines are either hex frames as parsed by scripts/Iown-IoHexFrameParser.py, or rtl_433 output
+ * where the frame follows a {bits} prefix ("codes" of the iown flex decoder in scripts/rtl_433).
+ * Frames include their CRC. Captures (iohcCapture.h: gateway archive, host decoder, -w output) are read
+ * as well, records carry no CRC so the parse and crc stages are skipped for them.
+ * -w writes the frames replayed in the first round as a capture.
+ * Exit code: 0 ok, 1 usage or input error, 2 below --min-fps.
+ */
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <iohc1WAuth.h>
+#include <iohcCrc.h>
+#include <iohcDispatcher.h>
+#include <iohcFrame.h>
+#include <iohcFrameJson.h>
+#include <iohcKeyCache.h>
+
+#include "iohcCaptureFile.h"
+
+using namespace IOHC;
+using replayClock = std::chrono::steady_clock;
+
+namespace {
+    constexpr uint8_t protocol1W = 0x20; // Control byte 1, set on 1W frames
+
+    struct stage {
+        const char *name;
+        std::vector<uint32_t> ns;
+
+        void add(replayClock::time_point start) {
+            ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(replayClock::now() - start).count());
+        }
+        void report() {
+            if (ns.empty()) return;
+            std::sort(ns.begin(), ns.end());
+            uint64_t total = 0;
+            for (uint32_t v : ns) total += v;
+            printf("  %-10s %8zu calls  avg %7.0f ns  p50 %7u  p99 %7u  max %7u\n", name, ns.size(),
+                   (double) total / ns.size(), ns[ns.size() / 2], ns[ns.size() * 99 / 100], ns.back());
+        }
+    };
+
+    stage parseStage{"parse", {}};
+    stage crcStage{"crc", {}};
+    stage dispatchStage{"dispatch", {}};
+    stage cryptoStage{"crypto", {}};
+    stage publishStage{"publish", {}};
+
+    uint8_t oneWayKey[16];
+    bool hasOneWayKey = false;
+    uint32_t authCounts[6] = {};
+    uint32_t badCrc = 0;
+    volatile uint32_t sink = 0;
+
+    bool hexDigit(char c) { return isxdigit(static_cast<unsigned char>(c)); }
+
+    // Longest hex run of the line, after a rtl_433 {bits} prefix when there is one
+    size_t parseLine(const std::string &line, uint8_t *out, size_t room) {
+        size_t pos = line.find('}');
+        pos = pos == std::string::npos ? 0 : pos + 1;
+        size_t bestStart = 0, bestLen = 0;
+        for (size_t i = pos; i < line.size();) {
+            if (!hexDigit(line[i])) {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            while (i < line.size() && (hexDigit(line[i]) || line[i] == ' ')) i++;
+            if (i - start > bestLen) {
+                bestStart = start;
+                bestLen = i - start;
+            }
+        }
+        size_t len = 0;
+        int high = -1;
+        for (size_t i = bestStart; i < bestStart + bestLen && len < room; i++) {
+            if (line[i] == ' ') continue;
+            int nibble = isdigit(static_cast<unsigned char>(line[i])) ? line[i] - '0' : (tolower(line[i]) - 'a' + 10);
+            if (high < 0) high = nibble;
+            else {
+                out[len++] = (high << 4) | nibble;
+                high = -1;
+            }
+        }
+        return len;
+    }
+
+    // Same layout as the 0x39 handler: data from the command ID, sequence number then MAC close the frame
+    bool replay1W(iohcPacket *iohc) {
+        const iohcFrameView frame(iohc);
+        if (!frame.valid() || !hasOneWayKey) return true;
+        auto start = replayClock::now();
+        iohc1WAuth *auth = iohc1WAuth::getInstance();
+        const uint8_t *source = iohc->payload.packet.header.source;
+        if (!auth->knows(source)) auth->learn(source, oneWayKey);
+        authResult result = auth->verify(frame);
+        authCounts[static_cast<uint8_t>(result)]++;
+        cryptoStage.add(start);
+        return true;
+    }
+
+    // 2W challenges are answered with the transfer key, as a fresh device would be
+    bool replay2W(iohcPacket *iohc) {
+        if (iohc->payload.packet.header.cmd != 0x3C || iohc->buffer_length < 15) return true;
+        auto start = replayClock::now();
+        const uint8_t *challenge = iohcFrameView(iohc).params().data;
+        const uint8_t ivData[] = {0x20};
+        uint8_t mac[16];
+        create2WHmac(mac, ivData, sizeof(ivData), challenge, iohcKeyCache::getInstance()->transfer());
+        sink = sink + mac[0];
+        cryptoStage.add(start);
+        return true;
+    }
+
+    bool replayHandler(iohcPacket *iohc) {
+        return iohc->payload.packet.header.CtrlByte1.asByte & protocol1W ? replay1W(iohc) : replay2W(iohc);
+    }
+
+    int usage(const char *name) {
+        fprintf(stderr, "Usage: %s [-n rounds] [-k 1W key hex] [--min-fps N] [-w capture] frames.txt|capture\n", name);
+        return 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t rounds = 1;
+    double minFps = 0;
+    const char *path = nullptr;
+    const char *output = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) rounds = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--min-fps") && i + 1 < argc) minFps = strtod(argv[++i], nullptr);
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc) hasOneWayKey = parseLine(argv[++i], oneWayKey, 16) == 16;
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc) output = argv[++i];
+        else if (argv[i][0] == '-') return usage(argv[0]);
+        else path = argv[i];
+    }
+    if (!path || !rounds) return usage(argv[0]);
+
+    std::vector<std::string> lines;
+    std::vector<iohcRxRecord> records;
+    if (iohcCaptureReader::isCapture(path)) {
+        iohcCaptureReader capture;
+        capture.open(path);
+        records.reserve(capture.size());
+        capture.forEach({}, [&](const iohcRxRecord &record) { records.push_back(record); });
+    } else {
+        std::ifstream input(path);
+        if (!input) {
+            fprintf(stderr, "Cannot open %s\n", path);
+            return 1;
+        }
+        for (std::string line; std::getline(input, line);)
+            if (!line.empty() && line[0] != '#') lines.push_back(line);
+    }
+    iohcCaptureWriter writer;
+    if (output && !writer.open(output)) {
+        fprintf(stderr, "Cannot write capture %s\n", output);
+        return 1;
+    }
+
+    iohcDispatcher *dispatcher = iohcDispatcher::getInstance();
+    for (unsigned cmd = 0; cmd < 256; cmd++) dispatcher->registerHandler(cmd, replayHandler);
+
+    char json[frameJsonMaxSize()];
+    uint64_t frames = 0;
+    auto process = [&](iohcPacket &iohc) {
+        auto start = replayClock::now();
+        dispatcher->dispatch(&iohc);
+        dispatchStage.add(start);
+
+        start = replayClock::now();
+        sink = sink + serializeFrame(json, sizeof(json), &iohc);
+        publishStage.add(start);
+        frames++;
+    };
+    const auto begin = replayClock::now();
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (const auto &line : lines) {
+            iohcPacket iohc;
+            uint8_t raw[64];
+            auto start = replayClock::now();
+            size_t len = parseLine(line, raw, sizeof(raw));
+            parseStage.add(start);
+            if (len < 11 || len - 2 > sizeof(iohc.payload.buffer)) continue;
+
+            start = replayClock::now();
+            bool valid = crc16Kermit(raw, len) == 0;
+            crcStage.add(start);
+            if (!valid) {
+                badCrc++;
+                continue;
+            }
+            // Radio frames come without their FCS
+            memcpy(iohc.payload.buffer, raw, len - 2);
+            iohc.buffer_length = len - 2;
+            process(iohc);
+            if (output && !round) {
+                // Text frames have no time, their line number stands in for it
+                iohcRxRecord record;
+                record.set(&iohc, frames, 0);
+                writer.append(record);
+            }
+        }
+        for (const auto &record : records) {
+            if (record.flags & rxCrcError || record.length < frameHeaderSize) {
+                badCrc++;
+                continue;
+            }
+            iohcPacket iohc;
+            record.toPacket(&iohc);
+            process(iohc);
+            if (output && !round) writer.append(record);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(replayClock::now() - begin).count();
+    const double fps = seconds > 0 ? frames / seconds : 0;
+    if (output && !writer.close()) {
+        fprintf(stderr, "Cannot write capture %s\n", output);
+        return 1;
+    }
+
+    printf("%llu frames in %.3f s: %.0f frames/s (%u bad CRC)\n", (unsigned long long) frames, seconds, fps, badCrc);
+    parseStage.report();
+    crcStage.report();
+    dispatchStage.report();
+    cryptoStage.report();
+    publishStage.report();
+    if (hasOneWayKey) {
+        printf("  1W auth:");
+        for (uint8_t r = 0; r < 6; r++)
+            if (authCounts[r]) printf(" %s %u", authResultName(static_cast<authResult>(r)), authCounts[r]);
+        printf("\n");
+    }
+    if (minFps > 0 && fps < minFps) {
+        fprintf(stderr, "Throughput %.0f frames/s below %.0f\n", fps, minFps);
+        return 2;
+    }
+    return 0;
+}
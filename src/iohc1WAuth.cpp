@@ -0,0 +1,169 @@
+#include <iohc1WAuth.h>
+
+#include <cstring>
+
+#include <iohcInitialValue.h>
+#include <iohcStats.h>
+
+namespace IOHC {
+    iohc1WAuth *iohc1WAuth::_iohc1WAuth = nullptr;
+
+    iohc1WAuth *iohc1WAuth::getInstance() {
+        if (!_iohc1WAuth)
+            _iohc1WAuth = new iohc1WAuth();
+        return _iohc1WAuth;
+    }
+
+    const char *authResultName(authResult result) {
+        switch (result) {
+            case authResult::unknownRemote: return "unknown remote";
+            case authResult::accepted: return "accepted";
+            case authResult::fastAccepted: return "accepted (precomputed)";
+            case authResult::repeated: return "repeated";
+            case authResult::replayed: return "REPLAYED";
+            case authResult::badMac: return "BAD MAC";
+        }
+        return "?";
+    }
+
+    iohcRemoteAuth *iohc1WAuth::find(const uint8_t *address) {
+        for (auto &remote : _remotes)
+            if (remote.used && !memcmp(remote.address, address, 3)) return &remote;
+        return nullptr;
+    }
+
+    void iohc1WAuth::learn(const uint8_t *address, const uint8_t *key) {
+        beginChange();
+        iohcRemoteAuth *remote = find(address);
+        if (!remote) {
+            remote = &_remotes[_next];
+            _next = (_next + 1) % IOHC_1W_AUTH_SIZE;
+            memcpy(remote->address, address, 3);
+            remote->used = true;
+        }
+        memcpy(remote->clearKey, key, sizeof(remote->clearKey));
+        remote->key.setKey(key);
+        remote->hasSequence = false;
+        remote->dataLen = 0;
+        for (auto &entry : remote->window) entry.valid = false;
+        endChange();
+        _saved.fetch_add(1, std::memory_order_release);
+    }
+
+    void iohc1WAuth::forget(const uint8_t *address) {
+        beginChange();
+        if (iohcRemoteAuth *remote = find(address)) remote->used = false;
+        endChange();
+        _saved.fetch_add(1, std::memory_order_release);
+    }
+
+    size_t iohc1WAuth::save(iohcRemoteState *out, size_t room) const {
+        for (;;) {
+            const uint32_t before = _revision.load(std::memory_order_acquire);
+            size_t count = 0;
+            if (!(before & 1)) {
+                for (const auto &remote : _remotes) {
+                    if (!remote.used || count == room) continue;
+                    iohcRemoteState &state = out[count++];
+                    memcpy(state.address, remote.address, 3);
+                    memcpy(state.key, remote.clearKey, sizeof(state.key));
+                    state.lastSequence = remote.savedSequence;
+                    state.hasSequence = remote.hasSequence;
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (!(before & 1) && _revision.load(std::memory_order_relaxed) == before) return count;
+        }
+    }
+
+    // Frames accepted since the mark was saved are below it + IOHC_1W_SEQUENCE_STEP, up to as many presses
+    // of that remote are refused after a reset
+    void iohc1WAuth::restore(const iohcRemoteState &state) {
+        learn(state.address, state.key);
+        beginChange();
+        iohcRemoteAuth *remote = find(state.address);
+        remote->lastSequence = state.lastSequence + IOHC_1W_SEQUENCE_STEP;
+        remote->savedSequence = state.lastSequence;
+        remote->hasSequence = state.hasSequence;
+        endChange();
+    }
+
+    void iohc1WAuth::computeMac(const iohcRemoteAuth &remote, uint16_t sequence, const uint8_t *data, size_t len,
+                                uint8_t *mac) {
+        iohcStatsScope timed(statMetric::aes);
+        const uint8_t seq[2] = {(uint8_t) (sequence >> 8), (uint8_t) sequence};
+        uint8_t iv[16];
+        initialValue(data, len, nullptr, seq, iv);
+        remote.key.encrypt(iv);
+        memcpy(mac, iv, 6);
+    }
+
+    // Precompute the MACs the remote sends if its next frames repeat the last accepted command
+    void iohc1WAuth::refill(iohcRemoteAuth &remote) {
+        for (uint16_t ahead = 1; ahead <= IOHC_1W_AUTH_WINDOW; ahead++) {
+            uint16_t sequence = remote.lastSequence + ahead;
+            auto &entry = remote.window[sequence % IOHC_1W_AUTH_WINDOW];
+            if (entry.valid && entry.sequence == sequence) continue;
+            entry.sequence = sequence;
+            computeMac(remote, sequence, remote.data, remote.dataLen, entry.mac);
+            entry.valid = true;
+        }
+    }
+
+    authResult iohc1WAuth::verify(const uint8_t *address, const uint8_t *sequence, const uint8_t *data, size_t len,
+                                  const uint8_t *mac) {
+        iohcRemoteAuth *remote = find(address);
+        if (!remote) return authResult::unknownRemote;
+        if (len > IOHC_1W_MAX_DATA) len = IOHC_1W_MAX_DATA;
+
+        uint16_t seq = (sequence[0] << 8) | sequence[1];
+        if (remote->hasSequence) {
+            uint16_t ahead = seq - remote->lastSequence;
+            if (ahead == 0) {
+                if (!memcmp(remote->lastMac, mac, 6)) return authResult::repeated;
+                _rejected++;
+                return authResult::replayed;
+            }
+            if (ahead > IOHC_1W_MAX_SEQUENCE_JUMP) {
+                _rejected++;
+                return authResult::replayed;
+            }
+        }
+
+        authResult result = authResult::accepted;
+        const auto &entry = remote->window[seq % IOHC_1W_AUTH_WINDOW];
+        bool sameData = remote->dataLen == len && !memcmp(remote->data, data, len);
+        if (remote->hasSequence && sameData && entry.valid && entry.sequence == seq) {
+            if (memcmp(entry.mac, mac, 6)) {
+                _rejected++;
+                return authResult::badMac;
+            }
+            _fastHits++;
+            result = authResult::fastAccepted;
+        } else {
+            uint8_t computed[6];
+            computeMac(*remote, seq, data, len, computed);
+            if (memcmp(computed, mac, 6)) {
+                _rejected++;
+                return authResult::badMac;
+            }
+        }
+
+        // Moved once the sequence number went IOHC_1W_SEQUENCE_STEP past the saved mark
+        const bool save = !remote->hasSequence || (uint16_t) (seq - remote->savedSequence) >= IOHC_1W_SEQUENCE_STEP;
+        beginChange();
+        if (save) remote->savedSequence = seq;
+        remote->hasSequence = true;
+        remote->lastSequence = seq;
+        memcpy(remote->lastMac, mac, 6);
+        if (!sameData) {
+            memcpy(remote->data, data, len);
+            remote->dataLen = len;
+            for (auto &slot : remote->window) slot.valid = false;
+        }
+        endChange();
+        if (save) _saved.fetch_add(1, std::memory_order_release);
+        refill(*remote);
+        return result;
+    }
+}
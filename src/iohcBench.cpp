@@ -0,0 +1,176 @@
+#include <iohcBench.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <esp_timer.h>
+#include <crypto2Wutils.h>
+#include <iohcCryptoHelpers.h>
+#include <iohcCrc.h>
+#include <iohcInitialValue.h>
+#include <iohcKeyCache.h>
+
+#if defined(IOHC_NATIVE)
+    #include <chrono>
+#elif __has_include(<esp_cpu.h>)
+    #include <esp_cpu.h>
+#else
+    #include <Arduino.h>
+#endif
+
+namespace IOHC {
+    static constexpr size_t benchFrameSize = 32; // Max io-homecontrol frame
+
+    template<typename F>
+    static int64_t timeUs(uint32_t rounds, F &&func) {
+        int64_t start = esp_timer_get_time();
+        for (uint32_t i = 0; i < rounds; i++) func(i);
+        return esp_timer_get_time() - start;
+    }
+
+    // CPU cycles on the device, nanoseconds on the host
+#if defined(IOHC_NATIVE)
+    static constexpr const char *counterUnit = "ns";
+    static inline uint32_t counter() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+#else
+    static constexpr const char *counterUnit = "cycles";
+    static inline uint32_t counter() {
+    #if __has_include(<esp_cpu.h>)
+        return esp_cpu_get_cycle_count();
+    #else
+        return ESP.getCycleCount();
+    #endif
+    }
+#endif
+
+    template<typename F>
+    static void perOp(const char *name, uint32_t rounds, F &&func) {
+        uint32_t start = counter();
+        for (uint32_t i = 0; i < rounds; i++) func(i);
+        uint32_t elapsed = counter() - start;
+        printf("  %-28s %8u %s/op\n", name, (unsigned) (elapsed / rounds), counterUnit);
+    }
+
+    static bool check(const char *name, const uint8_t *result, const char *expectedHex, size_t len) {
+        uint8_t expected[16];
+        for (size_t i = 0; i < len; i++) {
+            unsigned byte;
+            sscanf(expectedHex + 2 * i, "%2x", &byte);
+            expected[i] = byte;
+        }
+        bool ok = !memcmp(result, expected, len);
+        if (!ok) {
+            printf("  %s MISMATCH: ", name);
+            for (size_t i = 0; i < len; i++) printf("%02x", result[i]);
+            printf(" expected %s\n", expectedHex);
+        }
+        return ok;
+    }
+
+    void crcBench(uint32_t rounds) {
+        uint8_t frame[benchFrameSize];
+        for (size_t i = 0; i < sizeof(frame); i++) frame[i] = i * 37 + 11;
+        volatile uint16_t sink = 0; // Keep the compiler from dropping the loops
+
+        int64_t bitwise = timeUs(rounds, [&](uint32_t i) { frame[0] = i; sink = crc16KermitBitwise(frame, sizeof(frame)); });
+        int64_t table = timeUs(rounds, [&](uint32_t i) { frame[0] = i; sink = crc16KermitTableDriven(frame, sizeof(frame)); });
+        int64_t best = timeUs(rounds, [&](uint32_t i) { frame[0] = i; sink = crc16Kermit(frame, sizeof(frame)); });
+        (void) sink;
+
+        bool same = true;
+        for (uint32_t i = 0; i < 256 && same; i++) {
+            frame[0] = i;
+            uint16_t ref = crc16KermitBitwise(frame, sizeof(frame));
+            same = ref == crc16KermitTableDriven(frame, sizeof(frame)) && ref == crc16Kermit(frame, sizeof(frame));
+        }
+
+        printf("CRC16-KERMIT %u x %u bytes\n", (unsigned) rounds, (unsigned) benchFrameSize);
+        printf("  bitwise %lld us\n", (long long) bitwise);
+        printf("  table   %lld us\n", (long long) table);
+#if defined(IOHC_ROM_CRC16)
+        printf("  rom     %lld us\n", (long long) best);
+#else
+        printf("  default %lld us\n", (long long) best);
+#endif
+        printf("  results %s\n", same ? "match" : "MISMATCH");
+    }
+
+    /*
+     * Vectors printed by demo() in scripts/Iown-ioCrypto.py: 1W key push by abcdef with sequence 1234,
+     * 2W key pull with challenge 123456789abc and system key abcdef01020304050607080910111213
+     */
+    bool cryptoBench(uint32_t rounds) {
+        static const uint8_t node[3] = {0xab, 0xcd, 0xef};
+        static const uint8_t controllerKey[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                                                  0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16};
+        static const uint8_t systemKey[16] = {0xab, 0xcd, 0xef, 0x01, 0x02, 0x03, 0x04, 0x05,
+                                              0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13};
+        uint8_t sequence[2] = {0x12, 0x34};
+        std::vector<uint8_t> challenge = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc};
+        std::vector<uint8_t> noChallenge;
+        std::vector<uint8_t> frame38 = {0x38, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc};
+        std::vector<uint8_t> frame30 = {0x30, 0x7e, 0x60, 0x49, 0x1f, 0x97, 0x6a, 0xdf, 0x65,
+                                        0x3d, 0xb0, 0xed, 0x78, 0x5e, 0x49, 0xa2, 0x01};
+        std::vector<uint8_t> frame32 = {0x32, 0xea, 0x42, 0x5a, 0x7a, 0x18, 0x28, 0x85, 0xd4,
+                                        0xea, 0xee, 0xfd, 0x41, 0x6d, 0x62, 0x5e, 0x01};
+        uint8_t out[16];
+        bool ok = true;
+
+        // Results first
+        constructInitialValue(frame30, out, frame30.size(), noChallenge, sequence);
+        ok &= check("constructInitialValue 1W", out, "307e60491f976adfc987123455555555", 16);
+        initialValue(frame30.data(), frame30.size(), nullptr, sequence, out);
+        ok &= check("initialValue 1W", out, "307e60491f976adfc987123455555555", 16);
+        constructInitialValue(frame38, out, frame38.size(), challenge, nullptr);
+        ok &= check("constructInitialValue 2W", out, "38123456789abc551bb0123456789abc", 16);
+        initialValue(frame38.data(), frame38.size(), challenge.data(), nullptr, out);
+        ok &= check("initialValue 2W", out, "38123456789abc551bb0123456789abc", 16);
+
+        memcpy(out, controllerKey, 16);
+        iohcCrypto::encrypt_1W_key(node, out);
+        ok &= check("encrypt_1W_key", out, "7e60491f976adf653db0ed785e49a201", 16);
+        iohcCrypto::create_1W_hmac(out, sequence, (uint8_t *) controllerKey, frame30);
+        ok &= check("create_1W_hmac", out, "19e81ec43d5e", 6);
+
+        AES_ctx software;
+        AES_init_ctx(&software, transfert_key);
+        memset(out, 0, 16);
+        AES_ECB_encrypt(&software, out);
+        ok &= check("AES_ECB_encrypt", out, "709d1c485e5a848ae242712163415d4e", 16);
+        const iohcAesKey &transfer = iohcKeyCache::getInstance()->transfer();
+        memset(out, 0, 16);
+        transfer.encrypt(out);
+        ok &= check("iohcAesKey", out, "709d1c485e5a848ae242712163415d4e", 16);
+
+        iohcAesKey system;
+        system.setKey(systemKey);
+        encrypt2WKey(out, frame38.data(), frame38.size(), challenge.data(), systemKey);
+        ok &= check("encrypt2WKey", out, "ea425a7a182885d4eaeefd416d625e01", 16);
+        create2WHmac(out, frame32.data(), frame32.size(), challenge.data(), system);
+        ok &= check("create2WHmac", out, "0ae519a73c99", 6);
+
+        printf("Crypto %u rounds\n", (unsigned) rounds);
+        perOp("constructInitialValue", rounds, [&](uint32_t i) {
+            challenge[0] = i; constructInitialValue(frame38, out, frame38.size(), challenge, nullptr); });
+        perOp("initialValue (constexpr)", rounds, [&](uint32_t i) {
+            frame38[1] = i; initialValue(frame38.data(), frame38.size(), challenge.data(), nullptr, out); });
+        perOp("encrypt_1W_key", rounds, [&](uint32_t i) { out[0] = i; iohcCrypto::encrypt_1W_key(node, out); });
+        perOp("create_1W_hmac", rounds, [&](uint32_t i) {
+            sequence[1] = i; iohcCrypto::create_1W_hmac(out, sequence, (uint8_t *) controllerKey, frame30); });
+        perOp("AES_init_ctx + ECB (software)", rounds, [&](uint32_t i) {
+            out[0] = i; AES_init_ctx(&software, transfert_key); AES_ECB_encrypt(&software, out); });
+        perOp("AES_ECB_encrypt (software)", rounds, [&](uint32_t i) { out[0] = i; AES_ECB_encrypt(&software, out); });
+#if defined(IOHC_HW_AES)
+        perOp("iohcAesKey (hardware)", rounds, [&](uint32_t i) { out[0] = i; transfer.encrypt(out); });
+#else
+        perOp("iohcAesKey (software)", rounds, [&](uint32_t i) { out[0] = i; transfer.encrypt(out); });
+#endif
+        perOp("create2WHmac", rounds, [&](uint32_t i) { challenge[0] = i; create2WHmac(out, frame32.data(), frame32.size(), challenge.data(), system); });
+        printf("  results %s\n", ok ? "match" : "MISMATCH");
+        return ok;
+    }
+}
@@ -0,0 +1,199 @@
+#include <iohcConsole.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <Arduino.h>
+
+namespace IOHC {
+    void iohcArgs::split(char *line) {
+        _count = 0;
+        char *p = line;
+        while (*p && _count < IOHC_CONSOLE_ARGS) {
+            while (*p == ' ' || *p == '\t') p++;
+            if (!*p) break;
+            char *end = p;
+            while (*end && *end != ' ' && *end != '\t') end++;
+            _tokens[_count] = p;
+            _lengths[_count++] = end - p;
+            if (!*end) break;
+            *end = 0;
+            p = end + 1;
+        }
+    }
+
+    Tokens iohcArgs::tokens() const {
+        Tokens tokens;
+        tokens.reserve(_count);
+        for (size_t i = 0; i < _count; i++) tokens.emplace_back(_tokens[i], _lengths[i]);
+        return tokens;
+    }
+
+    iohcConsole *iohcConsole::_iohcConsole = nullptr;
+
+    iohcConsole *iohcConsole::getInstance() {
+        if (!_iohcConsole)
+            _iohcConsole = new iohcConsole();
+        return _iohcConsole;
+    }
+
+    bool iohcConsole::addHandler(const char *name, const char *help, argsFunc handler, commandMode mode) {
+        return add({name, help, handler, nullptr, mode});
+    }
+
+    bool iohcConsole::addHandler(const char *name, const char *help, handlerFunc handler, commandMode mode) {
+        return add({name, help, nullptr, handler, mode});
+    }
+
+    bool iohcConsole::add(const command &c) {
+        const int id = consoleCommandHash.find(c.name);
+        if (id >= 0) {
+            _commands[id] = c;
+            return true;
+        }
+        if (_extraCount >= IOHC_CONSOLE_COMMANDS) {
+            printf("*** Console full, %s not registered\n", c.name);
+            return false;
+        }
+        _extra[_extraCount++] = c;
+        return true;
+    }
+
+    const iohcConsole::command *iohcConsole::find(std::string_view name) const {
+        const int id = consoleCommandHash.find(name);
+        if (id >= 0) return _commands[id].name ? &_commands[id] : nullptr;
+        for (size_t i = 0; i < _extraCount; i++)
+            if (name == _extra[i].name) return &_extra[i];
+        return nullptr;
+    }
+
+    bool iohcConsole::begin(iohcEventLoop *loop, BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        _loop = loop;
+        if (!loop->on(loopEvent::console, onInput, this)) return false;
+        if (!_jobs) _jobs = xQueueCreate(IOHC_CONSOLE_PENDING, IOHC_CONSOLE_LINE);
+        if (!_jobs) return false;
+        if (!_task && !startTask(task, "iohcCommand", stackSize, this, priority, &_task, core)) return false;
+        addHandler("help", "List commands", [](const iohcArgs *cmd) -> void { iohcConsole::getInstance()->help(); });
+        // Called from the UART driver task on received bytes or RX timeout
+        Serial.onReceive([]() -> void { iohcEventLoop::getInstance()->post(loopEvent::console); });
+        return true;
+    }
+
+    void iohcConsole::onInput(void *arg) { static_cast<iohcConsole *>(arg)->read(); }
+
+    void iohcConsole::read() {
+        while (Serial.available()) {
+            const int c = Serial.read();
+            if (c < 0) break;
+            if (c == '\r' || c == '\n') {
+                if (!_len) continue;
+                _line[_len] = 0;
+                _len = 0;
+                execute(_line);
+            } else if (c == 0x08 || c == 0x7F) {
+                if (_len) _len--;
+            } else if (_len < sizeof(_line) - 1) {
+                _line[_len++] = c;
+            }
+        }
+    }
+
+    void iohcConsole::run(const command &c, const iohcArgs &args) {
+        if (c.args) {
+            c.args(&args);
+            return;
+        }
+        Tokens tokens = args.tokens();
+        c.tokens(&tokens);
+    }
+
+    bool iohcConsole::execute(const char *line) {
+        // Split in a copy, front ends may pass string literals
+        char buffer[IOHC_CONSOLE_LINE];
+        strncpy(buffer, line, sizeof(buffer) - 1);
+        buffer[sizeof(buffer) - 1] = 0;
+        iohcArgs args;
+        args.split(buffer);
+        if (!args.size()) return false;
+
+        const command *c = find(args.at(0));
+        if (!c) {
+            printf("Unknown command %s, type help\n", args.c_str(0));
+            return false;
+        }
+        // Inline when nothing runs or waits, lines stay in order
+        bool idle = false;
+        if (c->mode == commandMode::foreground && (!_jobs || !uxQueueMessagesWaiting(_jobs)) &&
+            _busy.compare_exchange_strong(idle, true, std::memory_order_acquire)) {
+            run(*c, args);
+            _executed.fetch_add(1, std::memory_order_relaxed);
+            release();
+            return true;
+        }
+
+        // Copied from line, buffer has its separators overwritten
+        char job[IOHC_CONSOLE_LINE];
+        strncpy(job, line, sizeof(job) - 1);
+        job[sizeof(job) - 1] = 0;
+        if (!_task || xQueueSend(_jobs, job, 0) != pdTRUE) {
+            const command *running = _jobCommand.load(std::memory_order_acquire);
+            printf("%s still running, %s not started\n", running ? running->name : "A command", c->name);
+            _rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        xTaskNotifyGive(_task);
+        return true;
+    }
+
+    void iohcConsole::release() {
+        _busy.store(false, std::memory_order_release);
+        if (_task && uxQueueMessagesWaiting(_jobs)) xTaskNotifyGive(_task);
+    }
+
+    // Queued lines, the console keeps reading meanwhile. Woken again by release() when a foreground
+    // command held the console
+    void iohcConsole::task(void *arg) {
+        auto *self = static_cast<iohcConsole *>(arg);
+        for (;;) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            for (;;) {
+                bool idle = false;
+                if (!self->_busy.compare_exchange_strong(idle, true, std::memory_order_acquire)) break;
+                if (xQueueReceive(self->_jobs, self->_job, 0) != pdTRUE) {
+                    // A line queued after the receive failed is picked up here, not by release()
+                    self->_busy.store(false, std::memory_order_release);
+                    if (uxQueueMessagesWaiting(self->_jobs)) continue;
+                    break;
+                }
+                iohcArgs args;
+                args.split(self->_job);
+                const command *c = self->find(args.at(0));
+                if (c) {
+                    self->_jobCommand.store(c, std::memory_order_release);
+                    run(*c, args);
+                    self->_jobCommand.store(nullptr, std::memory_order_release);
+                    (c->mode == commandMode::background ? self->_background : self->_executed).fetch_add(1, std::memory_order_relaxed);
+                }
+                self->_busy.store(false, std::memory_order_release);
+            }
+        }
+    }
+
+    void iohcConsole::help() const {
+        auto line = [](const command &c) -> void {
+            printf("%-16s %s%s\n", c.name, c.help, c.mode == commandMode::background ? " (background)" : "");
+        };
+        for (const command &c : _commands)
+            if (c.name) line(c);
+        for (size_t i = 0; i < _extraCount; i++) line(_extra[i]);
+    }
+
+    void iohcConsole::dump() const {
+        size_t hashed = 0;
+        for (const command &c : _commands) hashed += c.name != nullptr;
+        printf("*Console %u hashed commands in %u slots, %u others, %u run %u in background %u rejected%s\n",
+               (unsigned) hashed, (unsigned) consoleCommandHash.slots, (unsigned) _extraCount,
+               (unsigned) _executed.load(), (unsigned) _background.load(), (unsigned) _rejected.load(),
+               _busy ? ", busy" : "");
+    }
+}
@@ -0,0 +1,245 @@
+#include <Arduino.h>
+#include <iohcGateway.h>
+#include <crypto2Wutils.h>
+#include <iohcCryptoHelpers.h>
+#include <iohcFrame.h>
+#include <iohcInitialValue.h>
+#include <iohcKeyCache.h>
+#include <iohcMessages.h>
+#include <iohcLog.h>
+#include <iohcTrace.h>
+#include <iohcNodeIndex.h>
+#include <iohcTxScheduler.h>
+#include <iohcTxQueue.h>
+#include <iohcSession2W.h>
+#include <iohcScanEngine.h>
+
+/*
+ * 2W received frames handlers: pairing, key transfert, challenge answer and scanMode results
+ */
+namespace IOHC {
+    static bool discover0x28(iohcPacket* iohc) {
+        IOHC_LOGI("Pairing Asked\n");
+        if (!pairMode) return true;
+
+        packets2send.clear();
+        if (!packets2send.add()) return true;
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+        const uint8_t toSend[] = {0xff, 0xc0, 0xba, 0x11, 0xad, 0x0b, 0xcc, 0x00, 0x00}; // 0x0b OverKiz 0x0c Atlantic
+
+        buildReply<msg::discoverAnswer>(packets2send.back(), iohc, toSend, CHANNEL2, 25, 0, 250);
+        // Answer in the name of the gateway, not of the asked target
+        memcpy(packets2send.back()->payload.packet.header.source, cozyDevice2W->gateway, 3);
+
+        iohcTxQueue::getInstance()->submit(packets2send.pointers(), txClass::background);
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+        return true;
+    }
+
+    static bool discoverActuator0x2C(iohcPacket* iohc) {
+        IOHC_LOGI("Actuator Ack Asked\n");
+        if (!pairMode) return true;
+
+        packets2send.clear();
+        if (!packets2send.add()) return true;
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+
+        buildReply<msg::discoverActuatorAck>(packets2send.back(), iohc, CHANNEL2, 25, 0, 250);
+
+        // Sent 250 ms after the request on purpose, no reply deadline
+        iohcTxQueue::getInstance()->submit(packets2send.pointers(), txClass::realtime);
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+        return true;
+    }
+
+    static bool discoverAnswer0x29(iohcPacket* iohc) {
+        IOHC_LOGI("A Device want to be paired\n");
+        if (!pairMode) return true;
+
+        IOHC_TRACED(traceEvent::pairingData, msg::discoverAnswer::data::in(iohc), msg::discoverAnswer::data::size);
+        IOHC_LOGI("Sending 0x2C \n");
+        packets2send.clear();
+        if (!packets2send.add()) return true;
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+
+        buildReply<msg::discoverActuator>(packets2send.back(), iohc, CHANNEL2, 25, 1);
+        // 0x2C goes out as a first frame without header length
+        packets2send.back()->payload.packet.header.CtrlByte1.asByte = 0;
+        packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
+        packets2send.back()->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
+
+        iohcTxQueue::getInstance()->submit(packets2send.pointers(), txClass::background);
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+        return true;
+    }
+
+    static bool discoverRemote0x2B(iohcPacket* iohc) {
+        // The node index is the device table, unchanged nodes are not written again
+        iohcNodeIndex::getInstance()->upsert(iohc->payload.packet.header.source, iohc->payload.packet.msg.p0x2b.backbone,
+                                             iohc->payload.packet.msg.p0x2b.actuator, iohc->payload.packet.msg.p0x2b.manufacturer,
+                                             iohc->payload.packet.msg.p0x2b.info);
+        return true;
+    }
+
+    static bool launchKeyTransfert0x38(iohcPacket* iohc) {
+        const int64_t deadline = iohcTxScheduler::replyDeadline();
+        IOHC_LOGI("Key Transfert Asked after Command %2.2X\n", iohc->payload.packet.header.cmd);
+        if (!pairMode) return true;
+
+        packets2send.clear();
+        if (!packets2send.add()) return true;
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+        // The challenge is read in place from the frame
+        const uint8_t *key_transfert = msg::launchKeyTransfert::challenge::in(iohc);
+
+        IOHC_TRACED(traceEvent::keyTransfert, key_transfert, msg::launchKeyTransfert::challenge::size);
+        const uint8_t data[] = {msg::askChallenge::cmd}; //0x38
+        unsigned char initial_value[16];
+        initialValue(data, sizeof(data), key_transfert, nullptr, initial_value);
+        IOHC_TRACET(traceEvent::initialValue, initial_value, sizeof(initial_value));
+
+        iohcKeyCache *keyCache = iohcKeyCache::getInstance();
+        // The key this device already got from us, the gateway key for a new one
+        uint8_t systemKey[16];
+        if (!keyCache->key(iohc->payload.packet.header.source, systemKey)) memcpy(systemKey, transfert_key, sizeof(systemKey));
+        uint8_t encrypted_key[16];
+        keyCache->transfer().encrypt(initial_value);
+        // Appliquer le XOR avec la clé du système
+        for (int i = 0; i < 16; i++) {
+            encrypted_key[i] = initial_value[i] ^ systemKey[i];
+        }
+        IOHC_TRACED(traceEvent::encryptedKey, encrypted_key, sizeof(encrypted_key));
+
+        buildReply<msg::keyTransfert>(packets2send.back(), iohc, encrypted_key, CHANNEL2, 25, 0);
+        cozyDevice2W->memorizeSend.memorizedCmd = iohcDevice::SEND_KEY_TRANSFERT_0x32;
+        iohcSession2W::getInstance()->remember(iohc->payload.packet.header.source, iohcDevice::SEND_KEY_TRANSFERT_0x32,
+                                               cozyDevice2W->memorizeSend.memorizedData.data(),
+                                               cozyDevice2W->memorizeSend.memorizedData.size());
+        // The device now shares our key, expand its schedule once for the coming challenges
+        if (!keyCache->setSystemKey(iohc->payload.packet.header.source, systemKey))
+            IOHC_LOGE("*** Key cache full, challenges of this device use the transfer key\n");
+        iohcNodeIndex::getInstance()->setKey(iohc->payload.packet.header.source, systemKey);
+
+        iohcTxQueue::getInstance()->submit(packets2send.pointers(), txClass::realtime, deadline);
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+        return true;
+    }
+
+    static bool command0x20(iohcPacket* iohc) {
+        cozyDevice2W->memorizeSend.memorizedCmd = iohc->payload.packet.header.cmd;
+        IOHC::lastSendCmd = iohc->payload.packet.header.cmd;
+        // The target will challenge this command, keep its context apart from other exchanges
+        const iohcBytes params = iohcFrameView(iohc).params();
+        iohcSession2W::getInstance()->open(iohc->payload.packet.header.target, iohc->payload.packet.header.cmd,
+                                           params.data, params.size);
+        return true;
+    }
+
+    static bool commandAnswer0x21(iohcPacket* iohc) {
+        // Answer of 0x20, publish the confirmed command
+        return true;
+    }
+
+    static bool challenge0x3C(iohcPacket* iohc) {
+        const int64_t deadline = iohcTxScheduler::replyDeadline();
+        // Answer only to our gateway, not to others devices
+        if (!cozyDevice2W->isFake(iohc->payload.packet.header.source, iohc->payload.packet.header.target))
+            return true;
+
+        packets2send.clear();
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+
+        iohcKeyCache *keyCache = iohcKeyCache::getInstance();
+        const iohcKeyCache::pinnedKey systemKey = keyCache->system(iohc->payload.packet.header.source);
+
+        // IVdata is the challenge with commandId put on start
+        const uint8_t *challengeAsked = msg::challengeRequest::challenge::in(iohc);
+        IOHC_LOGI("Challenge asked after LastSend Command %2.2X\n", IOHC::lastSendCmd);
+        IOHC_LOGI("Challenge asked after Memorized Command %2.2X\n", cozyDevice2W->memorizeSend.memorizedCmd);
+
+        if (scanMode) {
+            cozyDevice2W->mapValid[IOHC::lastSendCmd] = 0x3C;
+            return true;
+        }
+        // Challenges of a probed command are the scan result, not to be answered
+        if (iohcScanEngine::getInstance()->scanning(iohc->payload.packet.header.source))
+            return true;
+
+        // Context of the exchange with this device, the single memorizeSend slot only as fallback
+        uint8_t IVdata[1 + IOHC_SESSION_MAX_DATA];
+        size_t IVlen = 0;
+        iohcSession2W *sessions = iohcSession2W::getInstance();
+        if (!sessions->challenge(iohc->payload.packet.header.source, challengeAsked, IVdata, IVlen)) {
+            const auto &memorized = cozyDevice2W->memorizeSend.memorizedData;
+            if (memorized.size() > IOHC_SESSION_MAX_DATA)
+                IOHC_LOGE("*** %u memorized bytes, only %u hashed\n", (unsigned) memorized.size(), (unsigned) IOHC_SESSION_MAX_DATA);
+            IVlen = 1 + std::min<size_t>(memorized.size(), IOHC_SESSION_MAX_DATA);
+            IVdata[0] = cozyDevice2W->memorizeSend.memorizedCmd;
+            std::copy(memorized.begin(), memorized.begin() + (IVlen - 1), IVdata + 1);
+        }
+        const uint8_t memorizedCmd = IVdata[0];
+
+        if (!packets2send.add()) return true;
+
+        unsigned char initial_value[16];
+        uint8_t dataLen = msg::challengeAnswer::size;
+
+        if (memorizedCmd == msg::askChallenge::cmd) {
+            // 0x31 is answered with the key itself
+            dataLen = msg::keyTransfert::size;
+            const uint8_t askChallenge[] = {msg::askChallenge::cmd};
+            uint8_t key[16];
+            if (!keyCache->key(iohc->payload.packet.header.source, key)) memcpy(key, transfert_key, sizeof(key));
+            encrypt2WKey(initial_value, askChallenge, sizeof(askChallenge), challengeAsked, key);
+            // Same key as the 0x38 transfer, kept for this device
+            keyCache->setSystemKey(iohc->payload.packet.header.source, key);
+            iohcNodeIndex::getInstance()->setKey(iohc->payload.packet.header.source, key);
+            cozyDevice2W->memorizeSend.memorizedCmd = msg::keyTransfert::cmd;
+            cozyDevice2W->memorizeSend.memorizedData.assign(initial_value, initial_value + 16);
+            sessions->remember(iohc->payload.packet.header.source, msg::keyTransfert::cmd, initial_value, 16);
+            buildReply<msg::keyTransfert>(packets2send.back(), iohc, initial_value, CHANNEL2, 6, 1);
+        } else {
+            create2WHmac(initial_value, IVdata, IVlen, challengeAsked, systemKey.key());
+            buildReply<msg::challengeAnswer>(packets2send.back(), iohc, initial_value, CHANNEL2, 6, 1);
+        }
+
+        iohcTxQueue::getInstance()->submit(packets2send.pointers(), txClass::realtime, deadline);
+
+        IOHC_LOGD("Key to be sent with %2.2X\n", packets2send[0]->payload.packet.header.cmd);
+        IOHC_TRACED(traceEvent::answerKey, initial_value, dataLen);
+
+        digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
+        return true;
+    }
+
+    // Answers to the commands probed by scanMode
+    static bool scanAnswer(iohcPacket* iohc) {
+        if (scanMode) {
+            otherDevice2W->memorizeOther2W = {};
+            cozyDevice2W->mapValid[IOHC::lastSendCmd] = iohc->payload.packet.header.cmd;
+        }
+        return true;
+    }
+
+    static bool scanUnknown0xFE(iohcPacket* iohc) {
+        if (scanMode) {
+            otherDevice2W->memorizeOther2W = {};
+            cozyDevice2W->mapValid[IOHC::lastSendCmd] = *msg::unknownAnswer::refused::in(iohc);
+        }
+        return true;
+    }
+
+    void registerCozyDevice2WHandlers(iohcDispatcher* dispatcher) {
+        dispatcher->registerHandler<msg::discover>(discover0x28);
+        dispatcher->registerHandler<msg::discoverActuator>(discoverActuator0x2C);
+        dispatcher->registerHandler<msg::discoverAnswer>(discoverAnswer0x29);
+        dispatcher->registerHandler(0x2B, discoverRemote0x2B);
+        dispatcher->registerHandler<msg::launchKeyTransfert>(launchKeyTransfert0x38);
+        dispatcher->registerHandler(0x20, command0x20);
+        dispatcher->registerHandler(0x21, commandAnswer0x21);
+        dispatcher->registerHandler<msg::challengeRequest>(challenge0x3C);
+        dispatcher->registerHandler({0x04, 0x0D, 0x2D, 0x4B, 0x55, 0x57, 0x59}, scanAnswer);
+        dispatcher->registerHandler<msg::unknownAnswer>(scanUnknown0xFE);
+        dispatcher->registerHandler({0x48, 0x49, 0x4A, 0x3D, 0x05}, iohcDispatcher::ignoreCommand);
+    }
+}
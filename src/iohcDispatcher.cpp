@@ -0,0 +1,55 @@
+#include <iohcDispatcher.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <esp_timer.h>
+#include <iohcLog.h>
+#include <iohcRadio.h>
+#include <iohcTrace.h>
+#include <iohcStats.h>
+
+namespace IOHC {
+    iohcDispatcher *iohcDispatcher::_iohcDispatcher = nullptr;
+
+    iohcDispatcher *iohcDispatcher::getInstance() {
+        if (!_iohcDispatcher)
+            _iohcDispatcher = new iohcDispatcher();
+        return _iohcDispatcher;
+    }
+
+    bool iohcDispatcher::unknownCommand(iohcPacket *iohc) {
+        iohcStats::getInstance()->unknown();
+        IOHC_LOGI("Received Unknown command %02X ", iohc->payload.packet.header.cmd);
+        IOHC_TRACET(traceEvent::frame, iohc->payload.buffer, iohc->buffer_length);
+        return false;
+    }
+
+    bool iohcDispatcher::shortFrame(iohcPacket *iohc) {
+        iohcStats::getInstance()->unknown();
+        IOHC_LOGI("Received short %02X frame, %u bytes\n", iohc->payload.packet.header.cmd, (unsigned) iohc->buffer_length);
+        IOHC_TRACET(traceEvent::frame, iohc->payload.buffer, iohc->buffer_length);
+        return false;
+    }
+
+    void buildReply(iohcPacket *reply, const iohcPacket *request, uint8_t cmd, const uint8_t *data, size_t len,
+                    uint32_t frequency, uint16_t repeatTime, uint8_t repeat, uint16_t delayed) {
+        // Header len if protocol version is 8 else 10 ;)
+        reply->payload.packet.header.CtrlByte1.asByte = frameHeaderSize - 1 + len;
+        reply->payload.packet.header.CtrlByte2.asByte = 0;
+        reply->payload.packet.header.cmd = cmd;
+        /* Swap */
+        memcpy(reply->payload.packet.header.source, request->payload.packet.header.target, 3);
+        memcpy(reply->payload.packet.header.target, request->payload.packet.header.source, 3);
+
+        if (len) memcpy(reply->payload.buffer + frameHeaderSize, data, len);
+
+        reply->buffer_length = frameHeaderSize + len;
+        reply->frequency = frequency;
+        reply->repeatTime = repeatTime;
+        reply->delayed = delayed;
+        IOHC::packetStamp = esp_timer_get_time();
+        reply->repeat = repeat; // Need to stop txMode
+        reply->lock = false; // Need to received ASAP
+    }
+}
@@ -0,0 +1,58 @@
+#include <iohcEventLoop.h>
+
+#include <cstdint>
+#include <cstdio>
+
+namespace IOHC {
+    iohcEventLoop *iohcEventLoop::_iohcEventLoop = nullptr;
+
+    iohcEventLoop *iohcEventLoop::getInstance() {
+        if (!_iohcEventLoop)
+            _iohcEventLoop = new iohcEventLoop();
+        return _iohcEventLoop;
+    }
+
+    bool iohcEventLoop::start(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (_task) return true;
+        return startTask(task, "iohcLoop", stackSize, this, priority, &_task, core);
+    }
+
+    bool iohcEventLoop::on(loopEvent event, eventFunc func, void *arg) {
+        const size_t index = static_cast<size_t>(event);
+        if (_task || index >= events) return false;
+        _handlers[index] = {func, arg};
+        return true;
+    }
+
+    void iohcEventLoop::post(loopEvent event) {
+        if (_task) xTaskNotify(_task, 1u << static_cast<uint8_t>(event), eSetBits);
+    }
+
+    void IRAM_ATTR iohcEventLoop::postFromISR(loopEvent event) {
+        if (!_task) return;
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(_task, 1u << static_cast<uint8_t>(event), eSetBits, &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
+
+    void iohcEventLoop::task(void *arg) {
+        auto *self = static_cast<iohcEventLoop *>(arg);
+        for (;;) {
+            uint32_t pending = 0;
+            xTaskNotifyWait(0, UINT32_MAX, &pending, portMAX_DELAY);
+            self->_wakeups.fetch_add(1, std::memory_order_relaxed);
+            while (pending) {
+                const uint8_t index = __builtin_ctz(pending);
+                pending &= pending - 1;
+                const handler &h = self->_handlers[index];
+                if (!h.func) continue;
+                h.func(h.arg);
+                self->_handled.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void iohcEventLoop::dump() const {
+        printf("*Event loop %u wakeups %u events handled\n", (unsigned) _wakeups.load(), (unsigned) _handled.load());
+    }
+}
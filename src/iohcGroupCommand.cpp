@@ -0,0 +1,227 @@
+#include <iohcGroupCommand.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <esp_timer.h>
+#include <iohcLog.h>
+#include <iohcMessages.h>
+#include <iohcSession2W.h>
+#include <iohcTxQueue.h>
+
+namespace IOHC {
+    static constexpr uint8_t IOHC_CHALLENGE_0x3C = 0x3C;
+
+    const char *groupResultName(groupResult result) {
+        switch (result) {
+            case groupResult::pending: return "pending";
+            case groupResult::acked: return "acked";
+            case groupResult::refused: return "refused";
+            case groupResult::failed: return "failed";
+        }
+        return "?";
+    }
+
+    iohcGroupCommand *iohcGroupCommand::_iohcGroupCommand = nullptr;
+
+    iohcGroupCommand *iohcGroupCommand::getInstance() {
+        if (!_iohcGroupCommand)
+            _iohcGroupCommand = new iohcGroupCommand();
+        return _iohcGroupCommand;
+    }
+
+    bool iohcGroupCommand::start(const uint8_t *gateway, const uint8_t (*targets)[3], size_t count, uint8_t cmd,
+                                 const uint8_t *data, size_t len, uint32_t frequency, resultFunc done) {
+        if (!count || count > IOHC_GROUP_TARGETS || len > IOHC_GROUP_MAX_DATA) return false;
+        if (!_lock) _lock = xSemaphoreCreateMutex();
+        if (!_lock) return false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        if (_running) {
+            xSemaphoreGive(_lock);
+            return false;
+        }
+        memcpy(_gateway, gateway, 3);
+        memset(_targets, 0, sizeof(_targets));
+        for (size_t i = 0; i < count; i++) memcpy(_targets[i].address, targets[i], 3);
+        _count = count;
+        _cmd = cmd;
+        if (len) memcpy(_data, data, len);
+        _dataLen = len;
+        _frequency = frequency;
+        _done = done;
+        _round = 0;
+        _next = 0;
+        _started = esp_timer_get_time();
+        _running = true;
+        xSemaphoreGive(_lock);
+        _groups.fetch_add(1, std::memory_order_relaxed);
+
+        if (!_task && !startTask(task, "iohcGroup", IOHC_GROUP_TASK_STACK, this, IOHC_GROUP_TASK_PRIORITY, &_task,
+                                 IOHC_GROUP_TASK_CORE)) {
+            _running = false;
+            return false;
+        }
+        xTaskNotifyGive(_task);
+        return true;
+    }
+
+    // Pending devices are reported failed, transmissions already queued still go out
+    void iohcGroupCommand::stop() {
+        if (!_lock) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        if (_running) {
+            for (size_t i = 0; i < _count; i++)
+                if (_targets[i].result == groupResult::pending) finish(_targets[i], groupResult::failed, 0);
+            _running = false;
+        }
+        xSemaphoreGive(_lock);
+        if (_task) xTaskNotifyGive(_task);
+    }
+
+    // A frame from a device of the group to the gateway: the challenge stops its repeats, anything else is its answer
+    void iohcGroupCommand::received(const iohcPacket *iohc) {
+        if (!_running) return;
+        if (memcmp(iohc->payload.packet.header.target, _gateway, 3)) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        for (size_t i = 0; i < _count; i++) {
+            iohcGroupTarget &t = _targets[i];
+            if (t.result != groupResult::pending || memcmp(t.address, iohc->payload.packet.header.source, 3)) continue;
+            const uint8_t cmd = iohc->payload.packet.header.cmd;
+            t.heard = true;
+            if (cmd == msg::unknownAnswer::cmd)
+                finish(t, groupResult::refused,
+                       iohc->buffer_length >= msg::unknownAnswer::frameSize ? *msg::unknownAnswer::refused::in(iohc) : 0);
+            else if (cmd != IOHC_CHALLENGE_0x3C) finish(t, groupResult::acked, cmd);
+            break;
+        }
+        xSemaphoreGive(_lock);
+        if (_task) xTaskNotifyGive(_task);
+    }
+
+    void iohcGroupCommand::finish(iohcGroupTarget &target, groupResult result, uint8_t answer) {
+        target.result = result;
+        target.answer = answer;
+        target.doneAt = esp_timer_get_time();
+        if (result == groupResult::acked) _acked.fetch_add(1, std::memory_order_relaxed);
+        else _failed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t iohcGroupCommand::unreported(iohcGroupTarget *out) {
+        size_t n = 0;
+        for (size_t i = 0; i < _count; i++) {
+            iohcGroupTarget &t = _targets[i];
+            if (t.result == groupResult::pending || t.reported) continue;
+            t.reported = true;
+            out[n++] = t;
+        }
+        return n;
+    }
+
+    // One transmission, the repeats of the other devices go out in between
+    bool iohcGroupCommand::send(iohcGroupTarget &target, int64_t now) {
+        iohcPacket frame;
+        frame.payload.packet.header.CtrlByte1.asByte = frameHeaderSize - 1 + _dataLen;
+        frame.payload.packet.header.CtrlByte2.asByte = 0;
+        frame.payload.packet.header.cmd = _cmd;
+        memcpy(frame.payload.packet.header.source, _gateway, 3);
+        memcpy(frame.payload.packet.header.target, target.address, 3);
+        if (_dataLen) memcpy(frame.payload.buffer + frameHeaderSize, _data, _dataLen);
+        frame.buffer_length = frameHeaderSize + _dataLen;
+        frame.frequency = _frequency;
+        frame.repeatTime = 25;
+        frame.repeat = 0;
+        frame.delayed = 0;
+        frame.lock = false;
+
+        // Context for the 0x3C answer before the device can send it, the group does the repeats itself.
+        // Not taken from other exchanges: without a free session the device cannot be authenticated.
+        if (!target.sent && !iohcSession2W::getInstance()->open(target.address, _cmd, _data, _dataLen, nullptr, 0, false)) {
+            IOHC_LOGE("*** Group %02X%02X%02X no free 2W session\n", target.address[0], target.address[1], target.address[2]);
+            finish(target, groupResult::failed, 0);
+            return true;
+        }
+        std::vector<iohcPacket *> frames{&frame};
+        if (!iohcTxQueue::getInstance()->submit(frames, txClass::interactive)) return false;
+        target.sent++;
+        target.lastSent = now;
+        _frames.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void iohcGroupCommand::step() {
+        const int64_t now = esp_timer_get_time();
+        iohcTxQueue *txQueue = iohcTxQueue::getInstance();
+
+        // Round major: the first transmission of every device, then the first repeat of every device...
+        while (_round <= IOHC_GROUP_REPEAT && txQueue->room() > IOHC_GROUP_TX_RESERVE) {
+            if (_next >= _count) {
+                _next = 0;
+                _round++;
+                continue;
+            }
+            iohcGroupTarget &t = _targets[_next];
+            if (t.result != groupResult::pending || t.heard) {
+                _next++;
+                continue;
+            }
+            if (t.sent && now - t.lastSent < IOHC_GROUP_REPEAT_MS * 1000) break;
+            if (!send(t, now)) break;
+            _next++;
+        }
+
+        bool done = true;
+        for (size_t i = 0; i < _count; i++) {
+            iohcGroupTarget &t = _targets[i];
+            if (t.result != groupResult::pending) continue;
+            // Silent past the timeout once every transmission is out, or heard and never answered
+            const bool lastOut = t.heard || t.sent > IOHC_GROUP_REPEAT;
+            if (lastOut && now - t.lastSent > IOHC_GROUP_TIMEOUT_MS * 1000) {
+                finish(t, groupResult::failed, 0);
+                continue;
+            }
+            done = false;
+        }
+        if (!done) return;
+
+        _running = false;
+        size_t acked = 0;
+        for (size_t i = 0; i < _count; i++) acked += _targets[i].result == groupResult::acked;
+        IOHC_LOGI("Group %02X: %u/%u acked in %u ms, type groupStatus\n", _cmd, (unsigned) acked, (unsigned) _count,
+                  (unsigned) ((now - _started) / 1000));
+    }
+
+    void iohcGroupCommand::task(void *arg) {
+        auto *self = static_cast<iohcGroupCommand *>(arg);
+        iohcGroupTarget results[IOHC_GROUP_TARGETS];
+        for (;;) {
+            xSemaphoreTake(self->_lock, portMAX_DELAY);
+            if (self->_running) self->step();
+            const size_t n = self->unreported(results);
+            const resultFunc done = self->_done;
+            const bool running = self->_running;
+            xSemaphoreGive(self->_lock);
+            // Outside the lock, the callback may print or publish
+            if (done)
+                for (size_t i = 0; i < n; i++) done(results[i]);
+            ulTaskNotifyTake(pdTRUE, running ? pdMS_TO_TICKS(IOHC_GROUP_TICK_MS) : portMAX_DELAY);
+        }
+    }
+
+    void iohcGroupCommand::dump() {
+        printf("*Group %s, %u groups %u frames %u acked %u failed\n", _running ? "running" : "idle",
+               (unsigned) _groups.load(), (unsigned) _frames.load(), (unsigned) _acked.load(), (unsigned) _failed.load());
+        if (!_lock || !_count) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        printf("*Group %02X, %u parameters bytes\n", _cmd, (unsigned) _dataLen);
+        for (size_t i = 0; i < _count; i++) {
+            const iohcGroupTarget &t = _targets[i];
+            printf("  %02X%02X%02X %-7s sent %u", t.address[0], t.address[1], t.address[2], groupResultName(t.result),
+                   (unsigned) t.sent);
+            if (t.result == groupResult::acked || t.result == groupResult::refused)
+                printf(" answer %02X after %u ms", t.answer, (unsigned) ((t.doneAt - _started) / 1000));
+            printf("\n");
+        }
+        xSemaphoreGive(_lock);
+    }
+}
@@ -0,0 +1,121 @@
+#include <iohcKeyCache.h>
+
+#include <cstring>
+
+#include <iohcInitialValue.h>
+#include <iohcStats.h>
+
+namespace IOHC {
+    iohcAesKey::iohcAesKey() {
+#if defined(IOHC_HW_AES)
+        esp_aes_init(&_ctx);
+#endif
+    }
+
+    iohcAesKey::~iohcAesKey() {
+#if defined(IOHC_HW_AES)
+        esp_aes_free(&_ctx);
+#endif
+    }
+
+    void iohcAesKey::setKey(const uint8_t *key) {
+#if defined(IOHC_HW_AES)
+        esp_aes_setkey(&_ctx, key, 128);
+#else
+        AES_init_ctx(&_ctx, key);
+#endif
+        _set = true;
+    }
+
+    void iohcAesKey::encrypt(uint8_t *block) const {
+#if defined(IOHC_HW_AES)
+        // The peripheral driver takes its own lock, input and output may overlap
+        esp_aes_crypt_ecb(&_ctx, ESP_AES_ENCRYPT, block, block);
+#else
+        AES_ECB_encrypt(&_ctx, block);
+#endif
+    }
+
+    iohcKeyCache *iohcKeyCache::_iohcKeyCache = nullptr;
+
+    iohcKeyCache::iohcKeyCache() {
+        _transfer.setKey(transfert_key);
+    }
+
+    iohcKeyCache *iohcKeyCache::getInstance() {
+        if (!_iohcKeyCache)
+            _iohcKeyCache = new iohcKeyCache();
+        return _iohcKeyCache;
+    }
+
+    iohcDeviceKeys *iohcKeyCache::find(const uint8_t *address) {
+        for (auto &device : _devices)
+            if (device.used && !memcmp(device.address, address, 3)) return &device;
+        return nullptr;
+    }
+
+    iohcKeyCache::pinnedKey iohcKeyCache::system(const uint8_t *address) {
+        iohcDeviceKeys *device = find(address);
+        if (device) device->pins.fetch_add(1, std::memory_order_acquire);
+        return pinnedKey(device, _transfer);
+    }
+
+    bool iohcKeyCache::key(const uint8_t *address, uint8_t *out) {
+        const iohcDeviceKeys *device = find(address);
+        if (!device) return false;
+        memcpy(out, device->key, sizeof(device->key));
+        return true;
+    }
+
+    bool iohcKeyCache::setSystemKey(const uint8_t *address, const uint8_t *key) {
+        iohcDeviceKeys *device = find(address);
+        if (device) {
+            if (!memcmp(device->key, key, sizeof(device->key))) return true;
+            if (device->pins.load(std::memory_order_acquire)) return false;
+        } else {
+            // A free entry, else round robin over the entries not pinned
+            for (auto &candidate : _devices)
+                if (!candidate.used && !candidate.pins.load(std::memory_order_acquire)) {
+                    device = &candidate;
+                    break;
+                }
+            for (size_t n = 0; !device && n < IOHC_KEY_CACHE_SIZE; n++) {
+                iohcDeviceKeys &candidate = _devices[(_next + n) % IOHC_KEY_CACHE_SIZE];
+                if (candidate.pins.load(std::memory_order_acquire)) continue;
+                device = &candidate;
+                _next = (_next + n + 1) % IOHC_KEY_CACHE_SIZE;
+            }
+            if (!device) return false;
+            memcpy(device->address, address, 3);
+            device->used = true;
+        }
+        memcpy(device->key, key, sizeof(device->key));
+        device->system.setKey(key);
+        return true;
+    }
+
+    void iohcKeyCache::forget(const uint8_t *address) {
+        if (iohcDeviceKeys *device = find(address)) device->used = false;
+    }
+
+    size_t iohcKeyCache::size() const {
+        size_t count = 0;
+        for (const auto &device : _devices)
+            if (device.used) count++;
+        return count;
+    }
+
+    void create2WHmac(uint8_t *mac, const uint8_t *frame, size_t len, const uint8_t *challenge, const iohcAesKey &key) {
+        iohcStatsScope timed(statMetric::aes);
+        initialValue(frame, len, challenge, nullptr, mac);
+        key.encrypt(mac);
+    }
+
+    void encrypt2WKey(uint8_t *encrypted, const uint8_t *frame, size_t len, const uint8_t *challenge, const uint8_t *key) {
+        iohcStatsScope timed(statMetric::aes);
+        initialValue(frame, len, challenge, nullptr, encrypted);
+        iohcKeyCache::getInstance()->transfer().encrypt(encrypted);
+        for (int i = 0; i < 16; i++)
+            encrypted[i] ^= key[i];
+    }
+}
@@ -0,0 +1,196 @@
+#include <iohcLog.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include <esp_timer.h>
+#include <iohcTrace.h>
+
+#if !defined(IOHC_NATIVE)
+    #include <LittleFS.h>
+#endif
+
+namespace IOHC {
+    iohcLog *iohcLog::_iohcLog = nullptr;
+#if !defined(IOHC_NATIVE)
+    static File traceFile; // Log task only
+#endif
+
+    const char *traceEventPrefix(traceEvent event) {
+        switch (event) {
+            case traceEvent::pairingData: return "";
+            case traceEvent::keyTransfert: return "";
+            case traceEvent::initialValue: return "2) Initial value used for key encryption: ";
+            case traceEvent::encryptedKey: return "2) Encrypted 2-way key to be sent with 0x32: ";
+            case traceEvent::answerKey: return "Key: ";
+            case traceEvent::clearKey: return "CLEAR KEY: ";
+            case traceEvent::mac: return "MAC: ";
+            case traceEvent::frame: return "Frame: ";
+        }
+        return "";
+    }
+
+    iohcLog *iohcLog::getInstance() {
+        if (!_iohcLog)
+            _iohcLog = new iohcLog();
+        return _iohcLog;
+    }
+
+    iohcLog::iohcLog() {
+        for (size_t i = 0; i < IOHC_LOG_SLOTS; i++) _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+#if !defined(IOHC_NATIVE)
+    bool iohcLog::start(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (_task) return true;
+        if (!startTask(task, "iohcLog", stackSize, this, priority, &_task, core)) return false;
+        _started = true;
+        return true;
+    }
+
+    void iohcLog::task(void *arg) {
+        auto *self = static_cast<iohcLog *>(arg);
+        for (;;) {
+            if (!self->drain()) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+        }
+    }
+#else
+    void iohcLog::task(void *) {}
+#endif
+
+    bool iohcLog::write(const char *text, size_t len) {
+        return len ? push(text, len, text[len - 1] == '\n') : true;
+    }
+
+    bool iohcLog::push(const char *text, size_t len, [[maybe_unused]] bool wake) {
+        if (!_started) {
+            output(text, len);
+            return true;
+        }
+        if (len > IOHC_LOG_LINE) len = IOHC_LOG_LINE;
+
+        size_t position = _enqueue.load(std::memory_order_relaxed);
+        slot *s;
+        for (;;) {
+            s = &_slots[position & (IOHC_LOG_SLOTS - 1)];
+            const intptr_t diff = (intptr_t) s->sequence.load(std::memory_order_acquire) - (intptr_t) position;
+            if (diff == 0) {
+                if (_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                // Still holding text the task has not written out
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = _enqueue.load(std::memory_order_relaxed);
+            }
+        }
+        memcpy(s->text, text, len);
+        s->len = len;
+        s->sequence.store(position + 1, std::memory_order_release);
+        _written.fetch_add(1, std::memory_order_relaxed);
+#if !defined(IOHC_NATIVE)
+        // Wake the task at the end of a line only, partial lines are usually followed by more
+        if (wake) xTaskNotifyGive(_task);
+#endif
+        return true;
+    }
+
+    bool iohcLog::printf(const char *format, ...) {
+        char line[IOHC_LOG_LINE];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        if (len < 0) return false;
+        return write(line, (size_t) len < sizeof(line) ? len : sizeof(line) - 1);
+    }
+
+    bool iohcLog::hex(const char *prefix, const uint8_t *data, size_t len, const char *sep) {
+        char line[IOHC_LOG_LINE];
+        size_t pos = snprintf(line, sizeof(line), "%s", prefix);
+        const size_t sepLen = strlen(sep);
+        // Keep room for the new line
+        for (size_t i = 0; i < len && pos + 2 + sepLen < sizeof(line) - 1; i++)
+            pos += snprintf(line + pos, sizeof(line) - pos, "%02X%s", data[i], sep);
+        if (pos >= sizeof(line) - 1) pos = sizeof(line) - 2;
+        line[pos++] = '\n';
+        return write(line, pos);
+    }
+
+    bool iohcLog::trace(traceEvent event, const uint8_t *data, size_t len) {
+        if (getTraceMode() == traceMode::text) {
+            const bool bytes = event == traceEvent::clearKey || event == traceEvent::mac;
+            return hex(traceEventPrefix(event), data, len, bytes ? "" : " ");
+        }
+        char record[IOHC_LOG_LINE];
+        if (len > sizeof(record) - traceHeaderSize) len = sizeof(record) - traceHeaderSize;
+        const uint32_t stamp = esp_timer_get_time();
+        record[0] = traceMarker;
+        record[1] = static_cast<uint8_t>(event);
+        record[2] = len;
+        for (size_t i = 0; i < 4; i++) record[3 + i] = stamp >> (8 * i);
+        memcpy(record + traceHeaderSize, data, len);
+        return push(record, traceHeaderSize + len, true);
+    }
+
+    void iohcLog::setTraceMode(traceMode mode) { _traceMode.store(static_cast<uint8_t>(mode), std::memory_order_relaxed); }
+
+    traceMode iohcLog::getTraceMode() const { return static_cast<traceMode>(_traceMode.load(std::memory_order_relaxed)); }
+
+    // Binary records go to the trace file in file mode, everything else to the console
+    void iohcLog::output(const char *text, size_t len) {
+#if !defined(IOHC_NATIVE)
+        const uint8_t mode = _traceMode.load(std::memory_order_relaxed);
+        if (mode != _fileMode && _started) {
+            if (traceFile) traceFile.close();
+            if (mode == static_cast<uint8_t>(traceMode::file)) traceFile = LittleFS.open(IOHC_TRACE_FILE, "w");
+            _fileSize = 0;
+            _fileMode = mode;
+        }
+        if (len && text[0] == traceMarker && mode == static_cast<uint8_t>(traceMode::file)) {
+            if (!traceFile || _fileSize + len > IOHC_TRACE_FILE_MAX) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            traceFile.write(reinterpret_cast<const uint8_t *>(text), len);
+            _fileSize += len;
+            return;
+        }
+#endif
+        fwrite(text, 1, len, stdout);
+    }
+
+    // Log task: writes out the committed slots in order, returns false when there was nothing to write
+    bool iohcLog::drain() {
+        bool any = false;
+        for (;;) {
+            slot &s = _slots[_dequeue & (IOHC_LOG_SLOTS - 1)];
+            if (s.sequence.load(std::memory_order_acquire) != _dequeue + 1) break;
+            output(s.text, s.len);
+            s.sequence.store(_dequeue + IOHC_LOG_SLOTS, std::memory_order_release);
+            _dequeue++;
+            any = true;
+        }
+        const uint32_t dropped = _dropped.load(std::memory_order_relaxed);
+        if (dropped != _reported) {
+            ::printf("*** %u log messages dropped\n", (unsigned) (dropped - _reported));
+            _reported = dropped;
+        }
+        if (any) {
+            fflush(stdout);
+#if !defined(IOHC_NATIVE)
+            if (traceFile) traceFile.flush();
+#endif
+        }
+        return any;
+    }
+
+    void iohcLog::dump() const {
+        static const char *modes[] = {"text", "uart", "file"};
+        ::printf("*Log %u messages %u dropped, level %d, traces %s", (unsigned) written(), (unsigned) dropped(), IOHC_LOG_LEVEL,
+                 modes[_traceMode.load(std::memory_order_relaxed) % 3]);
+        if (_fileMode == static_cast<uint8_t>(traceMode::file)) ::printf(" %u bytes in %s", (unsigned) _fileSize, IOHC_TRACE_FILE);
+        ::printf("\n");
+    }
+}
@@ -0,0 +1,349 @@
+#include <iohcNodeIndex.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <iohcCrc.h>
+
+namespace IOHC {
+    static constexpr uint32_t IOHC_NODE_INDEX_MAGIC = 0x58444E49; // "INDX"
+    static constexpr char IOHC_NODE_INDEX_TMP[] = IOHC_NODE_INDEX_FILE ".tmp";
+
+    struct __attribute__((packed)) nodeIndexHeader {
+        uint32_t magic;
+        uint16_t recordSize;
+        uint16_t count;
+        uint16_t crc;
+        uint8_t generation; // Bumped by each compaction, older journal entries are stale
+        uint8_t reserved;
+    };
+
+    struct __attribute__((packed)) nodeJournalEntry {
+        iohcNodeRecord record;
+        uint16_t crc;
+    };
+
+    iohcNodeIndex *iohcNodeIndex::_iohcNodeIndex = nullptr;
+
+    iohcNodeIndex *iohcNodeIndex::getInstance() {
+        if (!_iohcNodeIndex)
+            _iohcNodeIndex = new iohcNodeIndex();
+        return _iohcNodeIndex;
+    }
+
+    bool iohcNodeIndex::begin(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (_task) return true;
+        _lock = xSemaphoreCreateMutex();
+        _fileLock = xSemaphoreCreateMutex();
+        if (!_lock || !_fileLock) return false;
+        const bool fresh = !LittleFS.exists(IOHC_NODE_INDEX_FILE) && !LittleFS.exists(IOHC_NODE_JOURNAL_FILE);
+        load();
+        replay();
+        // Written at once, the next boot finds the index and does not import again
+        if (fresh && importSystemTable()) {
+            writeJournal();
+            compact();
+        }
+        return startTask(task, "iohcNodes", stackSize, this, priority, &_task, core);
+    }
+
+    // Branchless lower bound, the loop always runs log2(n) times
+    size_t iohcNodeIndex::lowerBound(uint32_t node) const {
+        if (!_count) return 0;
+        const iohcNodeRecord *base = _records;
+        size_t n = _count;
+        while (n > 1) {
+            size_t half = n / 2;
+            base = key(base[half - 1].node) < node ? base + half : base;
+            n -= half;
+        }
+        return (base - _records) + (key(base->node) < node);
+    }
+
+    iohcNodeRecord *iohcNodeIndex::insert(const uint8_t *node) {
+        const uint32_t k = key(node);
+        size_t pos = lowerBound(k);
+        if (pos < _count && key(_records[pos].node) == k) return &_records[pos];
+        if (_count == IOHC_NODE_INDEX_SIZE) {
+            _full.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        memmove(&_records[pos + 1], &_records[pos], (_count - pos) * sizeof(iohcNodeRecord));
+        _count++;
+        iohcNodeRecord *record = &_records[pos];
+        memset(record, 0, sizeof(iohcNodeRecord));
+        memcpy(record->node, node, 3);
+        return record;
+    }
+
+    void iohcNodeIndex::apply(const iohcNodeRecord &record) {
+        iohcNodeRecord *slot = insert(record.node);
+        if (!slot) return;
+        *slot = record;
+        slot->flags &= ~iohcNodeRecord::dirty;
+    }
+
+    void iohcNodeIndex::changed(iohcNodeRecord &record) {
+        record.flags |= iohcNodeRecord::dirty;
+    }
+
+    bool iohcNodeIndex::upsert(const uint8_t *node, const uint8_t *backbone, const uint8_t *actuator,
+                               uint8_t manufacturer, uint8_t info) {
+        bool modified = false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        if (iohcNodeRecord *record = insert(node)) {
+            modified = memcmp(record->backbone, backbone, 3) || memcmp(record->actuator, actuator, 2) ||
+                       record->manufacturer != manufacturer || record->info != info ||
+                       !(record->flags & iohcNodeRecord::discovered);
+            if (modified) {
+                memcpy(record->backbone, backbone, 3);
+                memcpy(record->actuator, actuator, 2);
+                record->manufacturer = manufacturer;
+                record->info = info;
+                record->flags |= iohcNodeRecord::discovered;
+                changed(*record);
+            }
+        }
+        xSemaphoreGive(_lock);
+        if (modified && _task) xTaskNotifyGive(_task);
+        return modified;
+    }
+
+    bool iohcNodeIndex::setKey(const uint8_t *node, const uint8_t *key) {
+        bool modified = false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        if (iohcNodeRecord *record = insert(node)) {
+            modified = !(record->flags & iohcNodeRecord::hasKey) || memcmp(record->key, key, sizeof(record->key));
+            if (modified) {
+                memcpy(record->key, key, sizeof(record->key));
+                record->flags |= iohcNodeRecord::hasKey;
+                changed(*record);
+            }
+        }
+        xSemaphoreGive(_lock);
+        if (modified && _task) xTaskNotifyGive(_task);
+        return modified;
+    }
+
+    bool iohcNodeIndex::setName(const uint8_t *node, const char *name, size_t len) {
+        char padded[sizeof(iohcNodeRecord::name)] = {};
+        for (size_t i = 0; i < len && i < sizeof(padded) && name[i]; i++) padded[i] = name[i];
+
+        bool modified = false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        if (iohcNodeRecord *record = insert(node)) {
+            modified = !(record->flags & iohcNodeRecord::hasName) || memcmp(record->name, padded, sizeof(padded));
+            if (modified) {
+                memcpy(record->name, padded, sizeof(padded));
+                record->flags |= iohcNodeRecord::hasName;
+                changed(*record);
+            }
+        }
+        xSemaphoreGive(_lock);
+        if (modified && _task) xTaskNotifyGive(_task);
+        return modified;
+    }
+
+    bool iohcNodeIndex::find(const uint8_t *node, iohcNodeRecord &record) {
+        const uint32_t k = key(node);
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        size_t pos = lowerBound(k);
+        bool found = pos < _count && key(_records[pos].node) == k;
+        if (found) record = _records[pos];
+        xSemaphoreGive(_lock);
+        return found;
+    }
+
+    void iohcNodeIndex::forEach(nodeFunc func) {
+        for (size_t i = 0;; i++) {
+            iohcNodeRecord record;
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            bool more = i < _count;
+            if (more) record = _records[i];
+            xSemaphoreGive(_lock);
+            if (!more) break;
+            func(record);
+        }
+    }
+
+    bool iohcNodeIndex::load() {
+        File f = LittleFS.open(IOHC_NODE_INDEX_FILE, "r");
+        if (!f) return false;
+        nodeIndexHeader header{};
+        bool ok = f.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  header.magic == IOHC_NODE_INDEX_MAGIC && header.recordSize == sizeof(iohcNodeRecord) &&
+                  header.count <= IOHC_NODE_INDEX_SIZE;
+        if (ok) {
+            // Read straight into place, the file is kept sorted
+            size_t bytes = header.count * sizeof(iohcNodeRecord);
+            ok = f.read(reinterpret_cast<uint8_t *>(_records), bytes) == bytes &&
+                 crc16Kermit(reinterpret_cast<const uint8_t *>(_records), bytes) == header.crc;
+            _count = ok ? header.count : 0;
+            _generation = ok ? header.generation : 0;
+        }
+        f.close();
+        if (!ok) printf("*** Node index %s corrupted, ignored\n", IOHC_NODE_INDEX_FILE);
+        return ok;
+    }
+
+    // Entries are whole records, the last one wins. A torn entry ends the replay.
+    // Entries of an older generation are already in the index, or older than it: a reset between the rename
+    // of compact() and the journal removal leaves them behind.
+    bool iohcNodeIndex::replay() {
+        File f = LittleFS.open(IOHC_NODE_JOURNAL_FILE, "r");
+        if (!f) return false;
+        nodeJournalEntry entry{};
+        while (f.read(reinterpret_cast<uint8_t *>(&entry), sizeof(entry)) == sizeof(entry)) {
+            if (crc16Kermit(reinterpret_cast<const uint8_t *>(&entry.record), sizeof(entry.record)) != entry.crc)
+                break;
+            if (entry.record.generation != _generation) continue;
+            entry.record.generation = 0;
+            apply(entry.record);
+            _journaled++;
+        }
+        f.close();
+        return true;
+    }
+
+    // Exactly len bytes of hex
+    static bool hexBytes(const char *hex, uint8_t *out, size_t len) {
+        if (!hex || strlen(hex) != 2 * len) return false;
+        for (size_t i = 0; i < len; i++) {
+            const char digits[3] = {hex[2 * i], hex[2 * i + 1], 0};
+            char *end;
+            out[i] = strtoul(digits, &end, 16);
+            if (*end) return false;
+        }
+        return true;
+    }
+
+    // Numbers or one byte hex strings
+    static uint8_t jsonByte(JsonVariantConst value) {
+        uint8_t byte = 0;
+        if (value.is<const char *>()) hexBytes(value.as<const char *>(), &byte, 1);
+        else byte = value.as<uint8_t>();
+        return byte;
+    }
+
+    // {"<node>": {"backbone": "<hex>", "actuator": "<hex>", "manufacturer": .., "info": ..}, ..}, as saved by
+    // iohcSystemTable. The JSON file is left in place, the node index does not read it again.
+    size_t iohcNodeIndex::importSystemTable() {
+        File f = LittleFS.open(IOHC_SYS_TABLE, "r");
+        if (!f) return 0;
+        DynamicJsonDocument doc(3 * f.size() + 1024);
+        const DeserializationError error = deserializeJson(doc, f);
+        f.close();
+        if (error) {
+            printf("*** System table %s unreadable, not imported: %s\n", IOHC_SYS_TABLE, error.c_str());
+            return 0;
+        }
+        size_t imported = 0;
+        for (JsonPair object : doc.as<JsonObject>()) {
+            uint8_t node[3], backbone[3] = {}, actuator[2] = {};
+            if (!hexBytes(object.key().c_str(), node, sizeof(node))) continue;
+            JsonObjectConst fields = object.value().as<JsonObjectConst>();
+            hexBytes(fields["backbone"] | "", backbone, sizeof(backbone));
+            hexBytes(fields["actuator"] | "", actuator, sizeof(actuator));
+            if (upsert(node, backbone, actuator, jsonByte(fields["manufacturer"]), jsonByte(fields["info"]))) imported++;
+        }
+        printf("Node index: %u nodes imported from %s\n", (unsigned) imported, IOHC_SYS_TABLE);
+        return imported;
+    }
+
+    void iohcNodeIndex::writeJournal() {
+        nodeJournalEntry entries[8];
+        File f;
+        for (;;) {
+            size_t n = 0;
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            for (size_t i = 0; i < _count && n < 8; i++) {
+                if (!(_records[i].flags & iohcNodeRecord::dirty)) continue;
+                _records[i].flags &= ~iohcNodeRecord::dirty;
+                entries[n].record = _records[i];
+                entries[n].record.generation = _generation;
+                n++;
+            }
+            xSemaphoreGive(_lock);
+            if (!n) break;
+
+            if (!f) f = LittleFS.open(IOHC_NODE_JOURNAL_FILE, "a");
+            if (!f) {
+                printf("*** Node journal %s unavailable\n", IOHC_NODE_JOURNAL_FILE);
+                return;
+            }
+            for (size_t i = 0; i < n; i++)
+                entries[i].crc = crc16Kermit(reinterpret_cast<const uint8_t *>(&entries[i].record), sizeof(iohcNodeRecord));
+            f.write(reinterpret_cast<const uint8_t *>(entries), n * sizeof(nodeJournalEntry));
+            _journaled += n;
+        }
+        if (f) f.close();
+    }
+
+    // The table is copied first so lookups are never held during the flash write
+    bool iohcNodeIndex::compact() {
+        std::unique_ptr<iohcNodeRecord[]> snapshot(new (std::nothrow) iohcNodeRecord[IOHC_NODE_INDEX_SIZE]);
+        if (!snapshot) return false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        const size_t count = _count;
+        memcpy(snapshot.get(), _records, count * sizeof(iohcNodeRecord));
+        xSemaphoreGive(_lock);
+        for (size_t i = 0; i < count; i++) {
+            snapshot[i].flags &= ~iohcNodeRecord::dirty;
+            snapshot[i].generation = 0;
+        }
+
+        const size_t bytes = count * sizeof(iohcNodeRecord);
+        const uint8_t generation = _generation + 1;
+        nodeIndexHeader header{IOHC_NODE_INDEX_MAGIC, sizeof(iohcNodeRecord), static_cast<uint16_t>(count),
+                               crc16Kermit(reinterpret_cast<const uint8_t *>(snapshot.get()), bytes), generation, 0};
+        File f = LittleFS.open(IOHC_NODE_INDEX_TMP, "w");
+        if (!f) return false;
+        bool ok = f.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  f.write(reinterpret_cast<const uint8_t *>(snapshot.get()), bytes) == bytes;
+        f.close();
+        if (!ok) {
+            LittleFS.remove(IOHC_NODE_INDEX_TMP);
+            return false;
+        }
+        // LittleFS renames over the old index atomically, a reset leaves either file whole.
+        // A journal left behind by a reset before its removal is of the previous generation, replay skips it
+        if (!LittleFS.rename(IOHC_NODE_INDEX_TMP, IOHC_NODE_INDEX_FILE)) {
+            printf("*** Node index %s not replaced, journal kept\n", IOHC_NODE_INDEX_FILE);
+            LittleFS.remove(IOHC_NODE_INDEX_TMP);
+            return false;
+        }
+        _generation = generation;
+        LittleFS.remove(IOHC_NODE_JOURNAL_FILE);
+        _journaled = 0;
+        _compactions.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void iohcNodeIndex::save(bool full) {
+        if (!_task) return;
+        xSemaphoreTake(_fileLock, portMAX_DELAY);
+        writeJournal();
+        if (full || _journaled >= IOHC_NODE_JOURNAL_MAX) compact();
+        xSemaphoreGive(_fileLock);
+    }
+
+    void iohcNodeIndex::task(void *arg) {
+        auto *self = static_cast<iohcNodeIndex *>(arg);
+        for (;;) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            // Let a pairing burst settle so it lands in one journal write
+            vTaskDelay(pdMS_TO_TICKS(100));
+            ulTaskNotifyTake(pdTRUE, 0);
+            self->save(false);
+        }
+    }
+
+    void iohcNodeIndex::dump() {
+        printf("*Node index %u/%u nodes, %u journaled, %u compactions, %u refused\n", (unsigned) _count,
+               (unsigned) IOHC_NODE_INDEX_SIZE, (unsigned) _journaled, (unsigned) _compactions.load(),
+               (unsigned) _full.load());
+    }
+}
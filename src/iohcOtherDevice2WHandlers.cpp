@@ -0,0 +1,38 @@
+#include <Arduino.h>
+#include <iohcGateway.h>
+#include <iohcFrame.h>
+#include <iohcLog.h>
+#include <iohcMessages.h>
+#include <iohcNodeIndex.h>
+#include <iohcSession2W.h>
+
+/*
+ * Other 2W received frames handlers: sniffed commands and names
+ */
+namespace IOHC {
+    static bool command(iohcPacket* iohc) {
+        otherDevice2W->memorizeOther2W.memorizedCmd = iohc->payload.packet.header.cmd;
+        cozyDevice2W->memorizeSend.memorizedCmd = iohc->payload.packet.header.cmd;
+        const iohcBytes params = iohcFrameView(iohc).params();
+        iohcSession2W::getInstance()->open(iohc->payload.packet.header.target, iohc->payload.packet.header.cmd,
+                                           params.data, params.size);
+        return true;
+    }
+
+    static bool nameAnswer0x51(iohcPacket* iohc) {
+        using field = msg::nameAnswer::name;
+        const uint8_t *text = field::in(iohc);
+        char name[field::size + 1] = {};
+        for (uint8_t i = 0; i < field::size; i++)
+            name[i] = std::toupper(text[i]);
+        IOHC_LOGI("%s\n", name);
+        iohcNodeIndex::getInstance()->setName(iohc->payload.packet.header.source, reinterpret_cast<const char *>(text),
+                                              field::size);
+        return true;
+    }
+
+    void registerOtherDevice2WHandlers(iohcDispatcher* dispatcher) {
+        dispatcher->registerHandler({0x00, 0x01, 0x03, 0x19}, command);
+        dispatcher->registerHandler<msg::nameAnswer>(nameAnswer0x51);
+    }
+}
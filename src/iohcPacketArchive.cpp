@@ -0,0 +1,279 @@
+#include <iohcPacketArchive.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <sys/time.h>
+#include <esp_timer.h>
+
+namespace IOHC {
+    namespace {
+        // Clock considered set (SNTP) past this date, 2020-09-13
+        constexpr time_t clockSet = 1600000000;
+
+        // Wall clock at stamp 0, 0 while the clock still counts from the epoch at boot
+        uint64_t wallclockOrigin() {
+            timeval now{};
+            gettimeofday(&now, nullptr);
+            if (now.tv_sec < clockSet) return 0;
+            return (uint64_t) now.tv_sec * 1000000 + now.tv_usec - esp_timer_get_time();
+        }
+    }
+
+    iohcPacketArchive *iohcPacketArchive::_iohcPacketArchive = nullptr;
+
+    iohcPacketArchive *iohcPacketArchive::getInstance() {
+        if (!_iohcPacketArchive)
+            _iohcPacketArchive = new iohcPacketArchive();
+        return _iohcPacketArchive;
+    }
+
+    bool iohcPacketArchive::begin(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (_task) return true;
+        _fileLock = xSemaphoreCreateMutex();
+        if (!_fileLock || !preallocate()) {
+            printf("*** Archive %s unavailable\n", IOHC_ARCHIVE_FILE);
+            return false;
+        }
+        recover();
+        return startTask(task, "iohcArchive", stackSize, this, priority, &_task, core);
+    }
+
+    // The whole file is written once so later page writes never grow it
+    bool iohcPacketArchive::preallocate() {
+        constexpr size_t fileSize = IOHC_ARCHIVE_PAGES * IOHC_ARCHIVE_PAGE_SIZE;
+        if (LittleFS.exists(IOHC_ARCHIVE_FILE)) {
+            File f = LittleFS.open(IOHC_ARCHIVE_FILE, "r");
+            bool sized = f && f.size() == fileSize;
+            f.close();
+            if (sized) {
+                _file = LittleFS.open(IOHC_ARCHIVE_FILE, "r+");
+                return (bool) _file;
+            }
+        }
+
+        File f = LittleFS.open(IOHC_ARCHIVE_FILE, "w");
+        if (!f) return false;
+        uint8_t zero[256] = {};
+        for (size_t written = 0; written < fileSize; written += sizeof(zero))
+            if (f.write(zero, sizeof(zero)) != sizeof(zero)) {
+                f.close();
+                return false;
+            }
+        f.close();
+        _file = LittleFS.open(IOHC_ARCHIVE_FILE, "r+");
+        return (bool) _file;
+    }
+
+    // Resumes after the newest page. A partially filled one is left as is: its stamps are from the previous boot
+    void iohcPacketArchive::recover() {
+        bool found = false;
+        iohcArchivePageHeader newest{};
+        uint32_t lastBoot = 0;
+        for (uint32_t p = 0; p < IOHC_ARCHIVE_PAGES; p++) {
+            iohcArchivePageHeader header{};
+            if (!readHeader(p, header)) continue;
+            if (!found || header.sequence > newest.sequence) newest = header;
+            if (header.boot > lastBoot) lastBoot = header.boot;
+            found = true;
+        }
+        _boot = lastBoot + 1;
+        _pages[_filling].sequence = found ? newest.sequence + 1 : 0;
+    }
+
+    // Only checks the header is valid, callers compare header.sequence with the page they expect
+    bool iohcPacketArchive::readHeader(uint32_t sequence, iohcArchivePageHeader &header) {
+        if (!_file.seek(offset(sequence))) return false;
+        if (_file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) != sizeof(header)) return false;
+        return capture::valid(header, IOHC_ARCHIVE_PAGE_SIZE);
+    }
+
+    bool iohcPacketArchive::writePage(uint32_t sequence, const iohcArchiveRecord *records, uint16_t count) {
+        // Stamps are us since boot, the host tools order pages by sequence and tell boots apart by boot
+        iohcArchivePageHeader header = capture::block(sequence, IOHC_ARCHIVE_PAGE_SIZE, wallclockOrigin(), _boot);
+        for (uint16_t i = 0; i < count; i++) capture::index(header, records[i]);
+        if (!_file.seek(offset(sequence))) return false;
+        bool ok = _file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header);
+        ok = ok && _file.write(reinterpret_cast<const uint8_t *>(records), count * sizeof(iohcArchiveRecord)) ==
+                   count * sizeof(iohcArchiveRecord);
+        _file.flush();
+        _pageWrites.fetch_add(1, std::memory_order_relaxed);
+        return ok;
+    }
+
+    /**
+     * Called from the dispatch task for every archived frame: copy into the RAM page and, once full,
+     * hand it to the archive task. Frames arriving while both pages wait for flash are dropped and counted.
+     */
+    bool iohcPacketArchive::append(const iohcPacket *iohc) {
+        iohcRxRecord record;
+        record.set(iohc, esp_timer_get_time(), 0);
+        return append(record);
+    }
+
+    bool iohcPacketArchive::append(const iohcRxRecord &received) {
+        if (!_task) return false;
+        bool stored = false;
+        bool wake = false;
+
+        portENTER_CRITICAL(&_mux);
+        if (_filled == IOHC_ARCHIVE_RECORDS_PER_PAGE && !_writing) {
+            // Page left full by a clear() or a slow write
+            _writing = true;
+            _pages[_filling ^ 1].sequence = _pages[_filling].sequence + 1;
+            _filling ^= 1;
+            _filled = 0;
+            wake = true;
+        }
+        if (_filled < IOHC_ARCHIVE_RECORDS_PER_PAGE) {
+            _pages[_filling].records[_filled++] = received;
+            _dirty = true;
+            stored = true;
+            if (_filled == IOHC_ARCHIVE_RECORDS_PER_PAGE && !_writing) {
+                _writing = true;
+                _pages[_filling ^ 1].sequence = _pages[_filling].sequence + 1;
+                _filling ^= 1;
+                _filled = 0;
+                _dirty = false;
+                wake = true;
+            }
+        }
+        portEXIT_CRITICAL(&_mux);
+
+        if (!stored) _dropped.fetch_add(1, std::memory_order_relaxed);
+        if (wake) xTaskNotifyGive(_task);
+        return stored;
+    }
+
+    void iohcPacketArchive::task(void *arg) {
+        auto *self = static_cast<iohcPacketArchive *>(arg);
+        for (;;) {
+            if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IOHC_ARCHIVE_FLUSH_MS))) {
+                if (self->_dirty) self->flush();
+                continue;
+            }
+            for (;;) {
+                portENTER_CRITICAL(&self->_mux);
+                bool writing = self->_writing;
+                page &full = self->_pages[self->_filling ^ 1];
+                portEXIT_CRITICAL(&self->_mux);
+                if (!writing) break;
+
+                xSemaphoreTake(self->_fileLock, portMAX_DELAY);
+                self->writePage(full.sequence, full.records, IOHC_ARCHIVE_RECORDS_PER_PAGE);
+                portENTER_CRITICAL(&self->_mux);
+                self->_writing = false;
+                // The other page filled up while writing, write it right away
+                if (self->_filled == IOHC_ARCHIVE_RECORDS_PER_PAGE) {
+                    self->_writing = true;
+                    self->_pages[self->_filling ^ 1].sequence = self->_pages[self->_filling].sequence + 1;
+                    self->_filling ^= 1;
+                    self->_filled = 0;
+                    self->_dirty = false;
+                }
+                portEXIT_CRITICAL(&self->_mux);
+                xSemaphoreGive(self->_fileLock);
+            }
+        }
+    }
+
+    void iohcPacketArchive::flush() {
+        if (!_task) return;
+        xSemaphoreTake(_fileLock, portMAX_DELAY);
+        portENTER_CRITICAL(&_mux);
+        page &current = _pages[_filling];
+        uint16_t count = _filled;
+        _dirty = false;
+        portEXIT_CRITICAL(&_mux);
+        // Records below count do not change until the page is swapped, which needs the file lock
+        if (count) writePage(current.sequence, current.records, count);
+        xSemaphoreGive(_fileLock);
+    }
+
+    void iohcPacketArchive::clear() {
+        if (!_task) return;
+        // Hold off page swaps while the headers are invalidated
+        for (;;) {
+            portENTER_CRITICAL(&_mux);
+            bool idle = !_writing;
+            if (idle) {
+                _writing = true;
+                _filled = 0;
+                _dirty = false;
+            }
+            portEXIT_CRITICAL(&_mux);
+            if (idle) break;
+            vTaskDelay(1);
+        }
+
+        xSemaphoreTake(_fileLock, portMAX_DELAY);
+        const iohcArchivePageHeader empty{};
+        for (uint32_t p = 0; p < IOHC_ARCHIVE_PAGES; p++) {
+            _file.seek(p * IOHC_ARCHIVE_PAGE_SIZE);
+            _file.write(reinterpret_cast<const uint8_t *>(&empty), sizeof(empty));
+        }
+        _file.flush();
+        xSemaphoreGive(_fileLock);
+
+        portENTER_CRITICAL(&_mux);
+        _writing = false;
+        portEXIT_CRITICAL(&_mux);
+    }
+
+    void iohcPacketArchive::forEach(recordFunc func) {
+        if (!_task) return;
+        xSemaphoreTake(_fileLock, portMAX_DELAY);
+        portENTER_CRITICAL(&_mux);
+        const uint8_t filling = _filling;
+        const uint16_t filled = _filled;
+        const bool writing = _writing;
+        const uint32_t sequence = _pages[filling].sequence;
+        portEXIT_CRITICAL(&_mux);
+
+        // With the file lock held neither RAM page can be recycled, see append() and task()
+        const uint32_t first = sequence >= IOHC_ARCHIVE_PAGES - 1 ? sequence - (IOHC_ARCHIVE_PAGES - 1) : 0;
+        for (uint32_t s = first; s < sequence; s++) {
+            if (writing && s == sequence - 1) {
+                for (const auto &record : _pages[filling ^ 1].records) func(record);
+                continue;
+            }
+            iohcArchivePageHeader header{};
+            if (!readHeader(s, header) || header.sequence != s) continue;
+            iohcArchiveRecord record{};
+            for (uint16_t i = 0; i < header.count; i++) {
+                if (_file.read(reinterpret_cast<uint8_t *>(&record), sizeof(record)) != sizeof(record)) break;
+                func(record);
+            }
+        }
+        for (uint16_t i = 0; i < filled; i++) func(_pages[filling].records[i]);
+        xSemaphoreGive(_fileLock);
+    }
+
+    uint32_t iohcPacketArchive::size() {
+        if (!_task) return 0;
+        uint32_t count = 0;
+        xSemaphoreTake(_fileLock, portMAX_DELAY);
+        portENTER_CRITICAL(&_mux);
+        const uint32_t sequence = _pages[_filling].sequence;
+        const bool writing = _writing;
+        count += _filled;
+        portEXIT_CRITICAL(&_mux);
+        const uint32_t first = sequence >= IOHC_ARCHIVE_PAGES - 1 ? sequence - (IOHC_ARCHIVE_PAGES - 1) : 0;
+        for (uint32_t s = first; s < sequence; s++) {
+            iohcArchivePageHeader header{};
+            if (writing && s == sequence - 1) count += IOHC_ARCHIVE_RECORDS_PER_PAGE;
+            else if (readHeader(s, header) && header.sequence == s) count += header.count;
+        }
+        xSemaphoreGive(_fileLock);
+        return count;
+    }
+
+    void iohcPacketArchive::toPacket(const iohcArchiveRecord &record, iohcPacket *iohc) {
+        record.toPacket(iohc);
+    }
+
+    void iohcPacketArchive::dump() {
+        printf("*Archive %u/%u records, %u page writes, %u dropped, boot %u\n", (unsigned) size(), (unsigned) capacity(),
+               (unsigned) pageWrites(), (unsigned) dropped(), (unsigned) _boot);
+    }
+}
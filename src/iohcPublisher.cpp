@@ -0,0 +1,122 @@
+#include <iohcPublisher.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <esp_timer.h>
+
+namespace IOHC {
+    iohcPublisher *iohcPublisher::_iohcPublisher = nullptr;
+
+    iohcPublisher *iohcPublisher::getInstance() {
+        if (!_iohcPublisher)
+            _iohcPublisher = new iohcPublisher();
+        return _iohcPublisher;
+    }
+
+    bool iohcPublisher::start(publishFunc publish, const char *topic, BaseType_t core, UBaseType_t priority,
+                              uint32_t stackSize) {
+        if (_task) return true;
+        _publish = publish;
+        _topic = topic;
+        _batch[0] = '[';
+        return startTask(task, "iohcPublish", stackSize, this, priority, &_task, core);
+    }
+
+    // Same source, command and content (sequence number and MAC for 1W) inside the dedup window.
+    // The window runs from the first copy, repeats do not extend it
+    bool iohcPublisher::isRepeat(const iohcPacket *iohc, int64_t now) {
+        uint32_t key = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < iohc->buffer_length; i++)
+            key = (key ^ iohc->payload.buffer[i]) * 16777619u;
+
+        for (auto &seen : _recent)
+            if (seen.key == key && now - seen.stamp < _dedupUs) return true;
+        _recent[_nextRecent] = {key, now};
+        _nextRecent = (_nextRecent + 1) % (sizeof(_recent) / sizeof(_recent[0]));
+        return false;
+    }
+
+    bool iohcPublisher::offer(const iohcPacket *iohc) {
+        if (isRepeat(iohc, esp_timer_get_time())) {
+            _coalesced.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Serialized straight into the queue slot
+        entry *slot = _queue.back();
+        if (!slot) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slot->len = serializeFrame(slot->json, sizeof(slot->json), iohc);
+        if (!slot->len) return false;
+        _queue.push();
+
+        if (_task) xTaskNotifyGive(_task);
+        return true;
+    }
+
+    void iohcPublisher::flush() {
+        if (!_batchCount) return;
+
+        bool sent;
+        if (_batchCount == 1) {
+            sent = _publish(_topic, _batch + 1, _batchLen - 1);
+        } else {
+            _batch[_batchLen] = ']';
+            sent = _publish(_topic, _batch, _batchLen + 1);
+        }
+        if (!sent) return; // Broker busy, keep the batch and retry on the next round
+
+        _published.fetch_add(_batchCount, std::memory_order_relaxed);
+        _messages.fetch_add(1, std::memory_order_relaxed);
+        _batchLen = 1;
+        _batchCount = 0;
+    }
+
+    void iohcPublisher::report(const char *topic, buildFunc build) {
+        _reportTopic.store(topic, std::memory_order_relaxed);
+        _reportBuild.store(build, std::memory_order_release);
+        if (_task) xTaskNotifyGive(_task);
+    }
+
+    void iohcPublisher::flushReport() {
+        buildFunc build = _reportBuild.load(std::memory_order_acquire);
+        if (!build) return;
+        const char *topic = _reportTopic.load(std::memory_order_relaxed);
+        const size_t len = build(_report, sizeof(_report));
+        // A report that does not fit is dropped, retrying would not make it fit
+        if (len && !_publish(topic, _report, len)) return; // Broker busy, built again on the next round
+        // Unless report() queued another one meanwhile
+        _reportBuild.compare_exchange_strong(build, nullptr, std::memory_order_relaxed);
+    }
+
+    void iohcPublisher::task(void *arg) {
+        auto *self = static_cast<iohcPublisher *>(arg);
+        self->_batchLen = 1;
+        for (;;) {
+            if (!self->_batchCount && !self->_queue.size() && !self->_reportBuild.load(std::memory_order_relaxed))
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            // Let retransmissions and neighbour frames join the batch
+            vTaskDelay(pdMS_TO_TICKS(IOHC_PUBLISH_BATCH_MS));
+
+            while (self->_batchCount < IOHC_PUBLISH_BATCH_MAX) {
+                entry *next = self->_queue.front();
+                if (!next) break;
+                if (self->_batchCount) self->_batch[self->_batchLen++] = ',';
+                memcpy(self->_batch + self->_batchLen, next->json, next->len);
+                self->_batchLen += next->len;
+                self->_batchCount++;
+                self->_queue.pop();
+            }
+            self->flush();
+            self->flushReport();
+        }
+    }
+
+    void iohcPublisher::dump() const {
+        printf("*Published %u frames in %u messages, %u coalesced, %u dropped, %u queued\n", (unsigned) published(),
+               (unsigned) messages(), (unsigned) coalesced(), (unsigned) dropped(), (unsigned) _queue.size());
+    }
+}
@@ -0,0 +1,62 @@
+#include <iohcRadioSet.h>
+
+#include <cstdio>
+
+#include <iohcRadio.h>
+
+namespace IOHC {
+    iohcRadioSet *iohcRadioSet::_iohcRadioSet = nullptr;
+
+    iohcRadioSet *iohcRadioSet::getInstance() {
+        if (!_iohcRadioSet)
+            _iohcRadioSet = new iohcRadioSet();
+        return _iohcRadioSet;
+    }
+
+    bool iohcRadioSet::add(const iohcRadioPort &port) {
+        if (!port.start || !port.send) {
+            printf("*** Radio on %u not added, no %s hook\n", (unsigned) port.frequency, port.start ? "send" : "start");
+            return false;
+        }
+        if (_count >= IOHC_RADIO_COUNT) {
+            printf("*** Radio on %u not added, raise IOHC_RADIO_COUNT\n", (unsigned) port.frequency);
+            return false;
+        }
+        _ports[_count++] = port;
+        return true;
+    }
+
+    bool iohcRadioSet::start() {
+        // One RX callback per ring, the radio index is part of the function
+        static constexpr bool (*callbacks[])(iohcPacket *) = {rxEnqueueOn<0>, rxEnqueueOn<1>, rxEnqueueOn<2>};
+        static_assert(IOHC_RADIO_COUNT <= sizeof(callbacks) / sizeof(callbacks[0]), "Up to 3 radios");
+        bool ok = true;
+        for (size_t i = 1; i < _count; i++)
+            if (!_ports[i].start(_ports[i].frequency, callbacks[i])) {
+                printf("*** Radio %u on %u not started\n", (unsigned) i, (unsigned) _ports[i].frequency);
+                ok = false;
+            }
+        return ok;
+    }
+
+    uint8_t iohcRadioSet::owner(uint32_t frequency) const {
+        for (size_t i = 1; i < _count; i++)
+            if (_ports[i].frequency == frequency) return i;
+        return 0;
+    }
+
+    void iohcRadioSet::send(std::vector<iohcPacket *> &packets) {
+        if (packets.empty()) return;
+        const uint8_t radio = owner(packets[0]->frequency);
+        if (radio) _ports[radio].send(packets);
+        else iohcRadio::getInstance()->send(packets);
+        _sent[radio].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void iohcRadioSet::dump() const {
+        printf("*Radios: 0 scan list %u sent", (unsigned) _sent[0].load());
+        for (size_t i = 1; i < _count; i++)
+            printf(", %u on %u %u sent", (unsigned) i, (unsigned) _ports[i].frequency, (unsigned) _sent[i].load());
+        printf("\n");
+    }
+}
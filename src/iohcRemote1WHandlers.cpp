@@ -0,0 +1,63 @@
+#include <Arduino.h>
+#include <iohcGateway.h>
+#include <iohcCryptoHelpers.h>
+#include <iohc1WAuth.h>
+#include <iohcFrame.h>
+#include <iohcInitialValue.h>
+#include <iohcKeyCache.h>
+#include <iohcLog.h>
+#include <iohcMessages.h>
+#include <iohcSnapshot.h>
+#include <iohcTrace.h>
+
+/*
+ * 1W received frames handlers: key push and authentication
+ */
+namespace IOHC {
+    static bool learningMode0x2E(iohcPacket* iohc) {
+        IOHC_LOGI("1W Learning mode\n");
+        return true;
+    }
+
+    static bool keyPush0x30(iohcPacket* iohc) {
+        memcpy(keyCap, msg::keyPush::key::in(iohc), msg::keyPush::key::size);
+
+        iohcCrypto::encrypt_1W_key((const uint8_t *)iohc->payload.packet.header.source, (uint8_t *)keyCap);
+        IOHC_TRACED(traceEvent::clearKey, keyCap, sizeof(keyCap));
+        iohc1WAuth::getInstance()->learn(iohc->payload.packet.header.source, keyCap);
+        iohcSnapshot::getInstance()->changed(); // A lost key means pairing the remote again
+        return true;
+    }
+
+    static bool command0x39(iohcPacket* iohc) {
+        // Authenticated data runs from the command ID to the sequence number, the MAC closes the frame
+        const iohcFrameView frame(iohc);
+        if (!frame.oneWay() || !frame.valid()) return true;
+
+        iohc1WAuth *auth = iohc1WAuth::getInstance();
+        if (auth->knows(frame.source())) {
+            const uint32_t revision = auth->revision();
+            authResult result = auth->verify(frame);
+            IOHC_LOGI("MAC: %s\n", authResultName(result));
+            // The sequence mark moved: written now, frames past the saved one could be replayed after a reset
+            if (auth->revision() != revision) iohcSnapshot::getInstance()->changed();
+            return true;
+        }
+
+        if (keyCap[0] == 0) return true;
+        uint8_t hmac[16];
+        // frame = {0x39, 0x00}, hashed in place
+        initialValue(&iohc->payload.packet.header.cmd, 2, nullptr, frame.sequence(), hmac);
+        iohcAesKey captured;
+        captured.setKey(keyCap);
+        captured.encrypt(hmac);
+        IOHC_TRACED(traceEvent::mac, hmac, 6);
+        return true;
+    }
+
+    void registerRemote1WHandlers(iohcDispatcher* dispatcher) {
+        dispatcher->registerHandler(0x2E, learningMode0x2E);
+        dispatcher->registerHandler<msg::keyPush>(keyPush0x30);
+        dispatcher->registerHandler(0x39, command0x39);
+    }
+}
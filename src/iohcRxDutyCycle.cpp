@@ -0,0 +1,160 @@
+#include <iohcRxDutyCycle.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <esp_timer.h>
+
+namespace IOHC {
+    iohcRxDutyCycle *iohcRxDutyCycle::_iohcRxDutyCycle = nullptr;
+
+    iohcRxDutyCycle *iohcRxDutyCycle::getInstance() {
+        if (!_iohcRxDutyCycle)
+            _iohcRxDutyCycle = new iohcRxDutyCycle();
+        return _iohcRxDutyCycle;
+    }
+
+    bool iohcRxDutyCycle::start(const uint32_t *frequencies, size_t count, BaseType_t core, UBaseType_t priority,
+                                uint32_t stackSize) {
+        if (_task) return true;
+        _frequencies = frequencies;
+        _channels = count;
+        return startTask(task, "iohcDuty", stackSize, this, priority, &_task, core);
+    }
+
+    bool iohcRxDutyCycle::enable(bool on) {
+        if (on) {
+            if (!_task || !_hooks.sleep || !_hooks.resume || (!_hooks.detectPreamble && !_hooks.readRssi)) return false;
+            // Scheduler ticks are 1 ms
+            if (sleepUs(_channels) < 1000) return false;
+        }
+        if (_enabled.exchange(on) == on) return true;
+        if (!on && _hooks.resume) _hooks.resume();
+        xTaskNotifyGive(_task);
+        return true;
+    }
+
+    // Wakes the transceiver on each channel in turn, true as soon as one carries a preamble
+    bool iohcRxDutyCycle::sniff() {
+        for (size_t i = 0; i < _channels; i++) {
+            if (_hooks.detectPreamble) {
+                if (_hooks.detectPreamble(_frequencies[i], IOHC_DUTY_DETECT_US)) return true;
+            } else if (_hooks.readRssi(_frequencies[i]) > IOHC_DUTY_RSSI_DBM) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool iohcRxDutyCycle::keptAwake() const {
+        return _held.load(std::memory_order_relaxed) || _awakeUntil.load(std::memory_order_relaxed) > esp_timer_get_time();
+    }
+
+    void iohcRxDutyCycle::awake(uint32_t ms) {
+        if (!enabled()) return;
+        const int64_t until = esp_timer_get_time() + int64_t(ms) * 1000;
+        int64_t current = _awakeUntil.load(std::memory_order_relaxed);
+        while (current < until && !_awakeUntil.compare_exchange_weak(current, until, std::memory_order_relaxed)) {}
+        xTaskNotifyGive(_task);
+    }
+
+    void iohcRxDutyCycle::hold(bool on) {
+        if (_held.exchange(on, std::memory_order_relaxed) == on || !on || !enabled()) return;
+        xTaskNotifyGive(_task);
+    }
+
+    void iohcRxDutyCycle::task(void *arg) {
+        auto *self = static_cast<iohcRxDutyCycle *>(arg);
+        for (;;) {
+            if (!self->enabled()) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                continue;
+            }
+            if (self->keptAwake()) {
+                // Resumed from here only, the hooks are not called from the TX or session tasks
+                const int64_t start = esp_timer_get_time();
+                self->_hooks.resume();
+                self->_holding.store(true, std::memory_order_relaxed);
+                while (self->enabled() && self->keptAwake()) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IOHC_DUTY_HOLD_MS));
+                self->_holding.store(false, std::memory_order_relaxed);
+                self->_rxUs.fetch_add(esp_timer_get_time() - start, std::memory_order_relaxed);
+                continue;
+            }
+            const TickType_t sleepTicks = pdMS_TO_TICKS(sleepUs(self->_channels) / 1000);
+
+            self->_hooks.sleep();
+            int64_t start = esp_timer_get_time();
+            // An enable change or a hold notifies while sleeping
+            ulTaskNotifyTake(pdTRUE, sleepTicks);
+            int64_t now = esp_timer_get_time();
+            self->_sleepUs.fetch_add(now - start, std::memory_order_relaxed);
+            if (!self->enabled() || self->keptAwake()) continue;
+
+            self->_wakeups.fetch_add(1, std::memory_order_relaxed);
+            const bool seen = self->sniff();
+            start = now;
+            now = esp_timer_get_time();
+            self->_detectUs.fetch_add(now - start, std::memory_order_relaxed);
+            if (!seen) continue;
+
+            // Full RX until the frames stop, 2W exchanges keep the receiver on
+            self->_detections.fetch_add(1, std::memory_order_relaxed);
+            self->_hooks.resume();
+            self->_holding.store(true, std::memory_order_relaxed);
+            bool frame = false;
+            while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IOHC_DUTY_HOLD_MS)) && self->enabled()) frame = true;
+            self->_holding.store(false, std::memory_order_relaxed);
+            self->_rxUs.fetch_add(esp_timer_get_time() - now, std::memory_order_relaxed);
+            if (!frame) self->_falseWakes.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void iohcRxDutyCycle::received(const iohcPacket *iohc) {
+        if (!enabled()) return;
+        _frames.fetch_add(1, std::memory_order_relaxed);
+        track1W(iohc);
+        if (_holding.load(std::memory_order_relaxed)) xTaskNotifyGive(_task);
+    }
+
+    // A remote increments its sequence number once per command and repeats the frame, a jump means lost commands
+    void iohcRxDutyCycle::track1W(const iohcPacket *iohc) {
+        if (!(iohc->payload.packet.header.CtrlByte1.asByte & 0x20) || iohc->buffer_length < 9 + 8) return;
+        const uint8_t *seq = iohc->payload.buffer + iohc->buffer_length - 8;
+        const uint16_t sequence = (seq[0] << 8) | seq[1];
+        const uint8_t *source = iohc->payload.packet.header.source;
+
+        for (auto &r : _remotes)
+            if (r.used && !memcmp(r.address, source, 3)) {
+                const uint16_t gap = sequence - r.sequence;
+                if (!gap || gap >= 0x8000) return; // Repeat, or an old frame
+                if (gap < 64) _missed.fetch_add(gap - 1, std::memory_order_relaxed);
+                _commands.fetch_add(1, std::memory_order_relaxed);
+                r.sequence = sequence;
+                return;
+            }
+        remote &r = _remotes[_nextRemote];
+        _nextRemote = (_nextRemote + 1) % IOHC_DUTY_REMOTES;
+        memcpy(r.address, source, 3);
+        r.sequence = sequence;
+        r.used = true;
+        _commands.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void iohcRxDutyCycle::dump() const {
+        const uint64_t sleeping = _sleepUs.load(), detecting = _detectUs.load(), receiving = _rxUs.load();
+        const uint64_t total = sleeping + detecting + receiving;
+        printf("*RX duty cycle %s, preamble %u us, sleep %u us over %u channels%s\n", enabled() ? "on" : "off",
+               (unsigned) preambleUs(), (unsigned) sleepUs(_channels), (unsigned) _channels, keptAwake() ? ", kept awake" : "");
+        if (!total) return;
+        const uint32_t awake = (detecting + receiving) * 1000 / total;
+        const uint32_t radioUa = (sleeping * IOHC_RADIO_SLEEP_UA + (detecting + receiving) * IOHC_RADIO_RX_UA) / total;
+        const uint32_t commands = _commands.load(), missed = _missed.load();
+        const uint32_t expected = commands + missed;
+        printf("*  radio awake %u.%u%%, ~%u uA (continuous RX %u uA)\n", (unsigned) (awake / 10), (unsigned) (awake % 10),
+               (unsigned) radioUa, (unsigned) IOHC_RADIO_RX_UA);
+        printf("*  %u wakeups %u detections %u false, %u frames, %u 1W commands missed (%u.%u%%)\n",
+               (unsigned) _wakeups.load(), (unsigned) _detections.load(), (unsigned) _falseWakes.load(),
+               (unsigned) _frames.load(), (unsigned) missed, (unsigned) (expected ? missed * 100 / expected : 0),
+               (unsigned) (expected ? missed * 1000 / expected % 10 : 0));
+    }
+}
@@ -0,0 +1,122 @@
+#include <iohcRxPipeline.h>
+
+#include <cstdio>
+
+#include <esp_timer.h>
+#include <iohcStats.h>
+
+namespace IOHC {
+    iohcRxPipeline *iohcRxPipeline::_iohcRxPipeline = nullptr;
+
+    iohcRxPipeline *iohcRxPipeline::getInstance() {
+        if (!_iohcRxPipeline)
+            _iohcRxPipeline = new iohcRxPipeline();
+        return _iohcRxPipeline;
+    }
+
+    bool iohcRxPipeline::start(dispatchFunc dispatch, BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (_task) return true;
+        _dispatch = dispatch;
+        return startTask(task, "iohcRx", stackSize, this, priority, &_task, core);
+    }
+
+    /**
+     * Called by the radio on every received frame. Must stay short: copy into the ring and wake the task.
+     * Frames arriving while the ring is full are dropped and counted.
+     * Each radio has its own ring, so every ring keeps a single producer.
+     */
+    bool IRAM_ATTR iohcRxPipeline::enqueue(const iohcPacket *iohc, uint8_t radio) {
+        auto &ring = _rings[radio < IOHC_RADIO_COUNT ? radio : 0];
+        iohcRxRecord *slot = ring.back();
+        if (!slot) {
+            _overflows.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slot->set(iohc, esp_timer_get_time(), radio);
+        int64_t never = 0;
+        if (!_firstRx.load(std::memory_order_relaxed))
+            _firstRx.compare_exchange_strong(never, static_cast<int64_t>(slot->stamp), std::memory_order_relaxed);
+        ring.push();
+        _received.fetch_add(1, std::memory_order_relaxed);
+
+        size_t depth = ring.size();
+        if (depth > _highWater.load(std::memory_order_relaxed))
+            _highWater.store(depth, std::memory_order_relaxed);
+
+        if (!_task) return true;
+        if (xPortInIsrContext()) {
+            BaseType_t woken = pdFALSE;
+            vTaskNotifyGiveFromISR(_task, &woken);
+            if (woken) portYIELD_FROM_ISR();
+        } else {
+            xTaskNotifyGive(_task);
+        }
+        return true;
+    }
+
+    void iohcRxPipeline::release() {
+        _held.store(false, std::memory_order_release);
+        if (_task) xTaskNotifyGive(_task);
+    }
+
+    size_t iohcRxPipeline::depth() const {
+        size_t depth = 0;
+        for (const auto &ring : _rings) depth += ring.size();
+        return depth;
+    }
+
+    /**
+     * Radios parked on neighbouring channels may all hear the same frame. A frame already taken from
+     * another radio within IOHC_RX_DEDUP_US is a duplicate; repeats heard by the same radio are kept.
+     */
+    bool iohcRxPipeline::duplicate(const iohcRxRecord &record) {
+        if (IOHC_RADIO_COUNT < 2) return false;
+        uint32_t hash = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < record.length; i++)
+            hash = (hash ^ record.buffer[i]) * 16777619u;
+        const int64_t stamp = record.stamp;
+        for (const auto &seen : _recent)
+            if (seen.hash == hash && seen.radio != record.radio && stamp - seen.stamp < IOHC_RX_DEDUP_US)
+                return true;
+        _recent[_nextRecent] = {hash, stamp, record.radio};
+        _nextRecent = (_nextRecent + 1) % (sizeof(_recent) / sizeof(_recent[0]));
+        return false;
+    }
+
+    void iohcRxPipeline::task(void *arg) {
+        auto *self = static_cast<iohcRxPipeline *>(arg);
+        iohcStats *stats = iohcStats::getInstance();
+        for (;;) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            // Frames wait in the rings, release() wakes the task again
+            if (self->_held.load(std::memory_order_acquire)) continue;
+            // Slots are released once the frame is dispatched, the archive copies the record from there
+            bool pending = true;
+            while (pending) {
+                pending = false;
+                for (uint8_t radio = 0; radio < IOHC_RADIO_COUNT; radio++) {
+                    auto &ring = self->_rings[radio];
+                    const iohcRxRecord *slot = ring.front();
+                    if (!slot) continue;
+                    pending = true;
+                    if (self->duplicate(*slot)) {
+                        self->_duplicates.fetch_add(1, std::memory_order_relaxed);
+                    } else {
+                        stats->since(statMetric::rxToDispatch, slot->stamp);
+                        slot->toPacket(&self->_packet);
+                        self->_current = slot;
+                        if (self->_dispatch) self->_dispatch(&self->_packet);
+                        self->_current = nullptr;
+                    }
+                    ring.pop();
+                }
+            }
+        }
+    }
+
+    void iohcRxPipeline::dump() const {
+        printf("*RX queue %u/%u (high water %u) %u received %u overflows %u duplicates\n", (unsigned) depth(),
+               (unsigned) capacity(), (unsigned) highWater(), (unsigned) received(), (unsigned) overflows(),
+               (unsigned) duplicates());
+    }
+}
@@ -0,0 +1,270 @@
+#include <iohcScanEngine.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <LittleFS.h>
+#include <esp_timer.h>
+#include <iohcLog.h>
+#include <iohcMessages.h>
+#include <iohcTxQueue.h>
+
+namespace IOHC {
+    static constexpr uint32_t IOHC_SCAN_MAGIC = 0x4E414353; // "SCAN"
+    static constexpr uint8_t IOHC_CHALLENGE_0x3C = 0x3C;
+    static constexpr char IOHC_SCAN_TMP[] = IOHC_SCAN_FILE ".tmp";
+
+    struct __attribute__((packed)) scanHeader {
+        uint32_t magic;
+        uint16_t targetSize;
+        uint8_t count;
+        uint8_t gateway[3];
+    };
+
+    static inline bool testBit(const uint8_t *bits, uint8_t n) { return bits[n >> 3] & (1 << (n & 7)); }
+    static inline void setBit(uint8_t *bits, uint8_t n) { bits[n >> 3] |= 1 << (n & 7); }
+
+    iohcScanEngine *iohcScanEngine::_iohcScanEngine = nullptr;
+
+    iohcScanEngine *iohcScanEngine::getInstance() {
+        if (!_iohcScanEngine)
+            _iohcScanEngine = new iohcScanEngine();
+        return _iohcScanEngine;
+    }
+
+    bool iohcScanEngine::start(const uint8_t *gateway, const uint8_t (*targets)[3], size_t count, uint32_t frequency) {
+        if (!count || count > IOHC_SCAN_TARGETS) return false;
+        if (!_lock) _lock = xSemaphoreCreateMutex();
+        if (!_lock) return false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        memcpy(_gateway, gateway, 3);
+        memset(_targets, 0, sizeof(_targets));
+        for (size_t i = 0; i < count; i++) memcpy(_targets[i].address, targets[i], 3);
+        _count = count;
+        _frequency = frequency;
+        xSemaphoreGive(_lock);
+        return launch();
+    }
+
+    bool iohcScanEngine::resume(uint32_t frequency) {
+        if (!_lock) _lock = xSemaphoreCreateMutex();
+        if (!_lock) return false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        bool loaded = load();
+        _frequency = frequency;
+        xSemaphoreGive(_lock);
+        if (!loaded) {
+            printf("No scan to resume in %s\n", IOHC_SCAN_FILE);
+            return false;
+        }
+        return launch();
+    }
+
+    bool iohcScanEngine::launch() {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        memset(_probes, 0, sizeof(_probes));
+        _sinceCheckpoint = 0;
+        _running = true;
+        xSemaphoreGive(_lock);
+        if (!_task && !startTask(task, "iohcScan", IOHC_SCAN_TASK_STACK, this, IOHC_SCAN_TASK_PRIORITY, &_task,
+                                 IOHC_SCAN_TASK_CORE)) {
+            _running = false;
+            return false;
+        }
+        xTaskNotifyGive(_task);
+        return true;
+    }
+
+    void iohcScanEngine::stop() {
+        if (!_lock) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        if (_running) _flush = true;
+        _running = false;
+        xSemaphoreGive(_lock);
+        iohcTxQueue::getInstance()->cancel(txClass::background);
+        if (_task) xTaskNotifyGive(_task);
+    }
+
+    bool iohcScanEngine::scanning(const uint8_t *address) {
+        if (!_running) return false;
+        bool found = false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        for (size_t i = 0; i < _count && !found; i++)
+            found = !_targets[i].done && !memcmp(_targets[i].address, address, 3);
+        xSemaphoreGive(_lock);
+        return found;
+    }
+
+    // A frame from a probed device to the gateway answers the command pending for that device
+    void iohcScanEngine::received(const iohcPacket *iohc) {
+        if (!_running) return;
+        if (memcmp(iohc->payload.packet.header.target, _gateway, 3)) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        for (size_t i = 0; i < _count; i++) {
+            if (!_probes[i].pending || memcmp(_targets[i].address, iohc->payload.packet.header.source, 3)) continue;
+            const uint8_t cmd = iohc->payload.packet.header.cmd;
+            // A 0xFE too short for the refused command is kept as is
+            const bool refused = cmd == msg::unknownAnswer::cmd && iohc->buffer_length >= msg::unknownAnswer::frameSize;
+            record(i, _probes[i].cmd, true, refused ? *msg::unknownAnswer::refused::in(iohc) : cmd);
+            break;
+        }
+        xSemaphoreGive(_lock);
+        if (_task) xTaskNotifyGive(_task);
+    }
+
+    void iohcScanEngine::record(size_t target, uint8_t cmd, bool answered, uint8_t answer) {
+        iohcScanTarget &t = _targets[target];
+        setBit(t.tested, cmd);
+        if (answered) {
+            setBit(t.answered, cmd);
+            t.answer[cmd] = answer;
+            _answers.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            _silent.fetch_add(1, std::memory_order_relaxed);
+        }
+        _probes[target].pending = false;
+        if (cmd == 0xFF) t.done = 1;
+        else t.nextCmd = cmd + 1;
+        _sinceCheckpoint++;
+    }
+
+    // The timeout of the probe starts here, a background frame may wait long behind the others
+    void iohcScanEngine::sent(const iohcPacket *frame, void *arg) {
+        auto *self = static_cast<iohcScanEngine *>(arg);
+        const int64_t now = esp_timer_get_time();
+        xSemaphoreTake(self->_lock, portMAX_DELAY);
+        for (size_t i = 0; i < self->_count; i++) {
+            probe &p = self->_probes[i];
+            if (p.pending && !p.sentAt && p.cmd == frame->payload.packet.header.cmd &&
+                !memcmp(self->_targets[i].address, frame->payload.packet.header.target, 3)) {
+                p.sentAt = now;
+                break;
+            }
+        }
+        xSemaphoreGive(self->_lock);
+    }
+
+    bool iohcScanEngine::send(size_t target, uint8_t cmd) {
+        iohcPacket probe;
+        probe.payload.packet.header.CtrlByte1.asByte = frameHeaderSize - 1; // No parameters
+        probe.payload.packet.header.CtrlByte2.asByte = 0;
+        probe.payload.packet.header.cmd = cmd;
+        memcpy(probe.payload.packet.header.source, _gateway, 3);
+        memcpy(probe.payload.packet.header.target, _targets[target].address, 3);
+        probe.buffer_length = frameHeaderSize;
+        probe.frequency = _frequency;
+        probe.repeatTime = 25;
+        probe.repeat = 0;
+        probe.delayed = 0;
+        probe.lock = false;
+
+        std::vector<iohcPacket *> frames{&probe};
+        // Sent from the TX task while _lock is held here, sent() waits for it
+        if (!iohcTxQueue::getInstance()->submit(frames, txClass::background, 0, false, sent, this)) return false;
+        _probes[target] = {true, cmd, 0};
+        _sent.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Time out silent probes and start the next command on every idle target
+    void iohcScanEngine::step() {
+        const int64_t now = esp_timer_get_time();
+        bool done = true;
+        for (size_t i = 0; i < _count; i++) {
+            iohcScanTarget &t = _targets[i];
+            if (t.done) continue;
+            done = false;
+            probe &p = _probes[i];
+            if (p.pending && p.sentAt && now - p.sentAt > IOHC_SCAN_TIMEOUT_MS * 1000) record(i, p.cmd, false, 0);
+            if (!p.pending && !t.done) {
+                // A checkpoint taken mid probe may have been answered already
+                while (testBit(t.tested, t.nextCmd) && t.nextCmd != 0xFF) t.nextCmd++;
+                if (testBit(t.tested, t.nextCmd)) t.done = 1;
+                else if (!send(i, t.nextCmd)) break; // TX queue full, again next round
+            }
+        }
+        if (done) {
+            _flush = true;
+            _running = false;
+            IOHC_LOGI("Scan completed, type scanResults\n");
+        }
+    }
+
+    void iohcScanEngine::task(void *arg) {
+        auto *self = static_cast<iohcScanEngine *>(arg);
+        for (;;) {
+            xSemaphoreTake(self->_lock, portMAX_DELAY);
+            if (self->_running) self->step();
+            // Copied under the lock, written without it so the dispatch task never waits for the flash
+            size_t save = 0;
+            if (self->_flush || self->_sinceCheckpoint >= IOHC_SCAN_CHECKPOINT) {
+                save = self->_count;
+                memcpy(self->_saved, self->_targets, save * sizeof(iohcScanTarget));
+                memcpy(self->_savedGateway, self->_gateway, 3);
+                self->_sinceCheckpoint = 0;
+                self->_flush = false;
+            }
+            const bool running = self->_running;
+            xSemaphoreGive(self->_lock);
+            if (save) self->checkpoint(save);
+            ulTaskNotifyTake(pdTRUE, running ? pdMS_TO_TICKS(IOHC_SCAN_TICK_MS) : portMAX_DELAY);
+        }
+    }
+
+    // Renamed over the previous checkpoint once complete, a reset while writing leaves that one
+    bool iohcScanEngine::checkpoint(size_t count) {
+        File f = LittleFS.open(IOHC_SCAN_TMP, "w");
+        if (!f) return false;
+        scanHeader header{IOHC_SCAN_MAGIC, sizeof(iohcScanTarget), static_cast<uint8_t>(count), {}};
+        memcpy(header.gateway, _savedGateway, 3);
+        bool ok = f.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  f.write(reinterpret_cast<const uint8_t *>(_saved), count * sizeof(iohcScanTarget)) ==
+                  count * sizeof(iohcScanTarget);
+        f.close();
+        ok = ok && LittleFS.rename(IOHC_SCAN_TMP, IOHC_SCAN_FILE);
+        if (!ok) {
+            LittleFS.remove(IOHC_SCAN_TMP);
+            printf("*** Scan checkpoint %s not written\n", IOHC_SCAN_FILE);
+        }
+        return ok;
+    }
+
+    bool iohcScanEngine::load() {
+        File f = LittleFS.open(IOHC_SCAN_FILE, "r");
+        if (!f) return false;
+        scanHeader header{};
+        bool ok = f.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  header.magic == IOHC_SCAN_MAGIC && header.targetSize == sizeof(iohcScanTarget) &&
+                  header.count && header.count <= IOHC_SCAN_TARGETS;
+        ok = ok && f.read(reinterpret_cast<uint8_t *>(_targets), header.count * sizeof(iohcScanTarget)) ==
+                   header.count * sizeof(iohcScanTarget);
+        f.close();
+        if (!ok) return false;
+        memcpy(_gateway, header.gateway, 3);
+        _count = header.count;
+        return true;
+    }
+
+    void iohcScanEngine::dump() {
+        if (!_lock) _lock = xSemaphoreCreateMutex();
+        if (!_lock) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        // Results of a previous boot are read back from the checkpoint
+        if (!_count) load();
+        for (size_t i = 0; i < _count; i++) {
+            const iohcScanTarget &t = _targets[i];
+            unsigned tested = 0;
+            printf("%02X%02X%02X:", t.address[0], t.address[1], t.address[2]);
+            for (unsigned cmd = 0; cmd < 256; cmd++) {
+                if (!testBit(t.tested, cmd)) continue;
+                tested++;
+                if (testBit(t.answered, cmd)) printf(" %02X=%02X", cmd, t.answer[cmd]);
+            }
+            printf("\n  %u/256 probed%s\n", tested, t.done ? ", done" : "");
+        }
+        printf("*Scan %s, %u probes %u answers %u silent\n", _running ? "running" : "stopped",
+               (unsigned) _sent.load(), (unsigned) _answers.load(), (unsigned) _silent.load());
+        xSemaphoreGive(_lock);
+    }
+}
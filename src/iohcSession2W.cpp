@@ -0,0 +1,255 @@
+#include <iohcSession2W.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <iohcLog.h>
+#include <iohcRxDutyCycle.h>
+#include <iohcTxQueue.h>
+
+namespace IOHC {
+    static constexpr uint8_t IOHC_CHALLENGE_0x3C = 0x3C;
+    static constexpr uint8_t IOHC_UNKNOWN_0xFE = 0xFE;
+
+    // Devices answer a command with the next ID, or refuse it
+    static bool answers(uint8_t cmd, uint8_t answer) {
+        return answer == static_cast<uint8_t>(cmd + 1) || answer == IOHC_UNKNOWN_0xFE;
+    }
+
+    iohcSession2W *iohcSession2W::_iohcSession2W = nullptr;
+
+    iohcSession2W *iohcSession2W::getInstance() {
+        if (!_iohcSession2W)
+            _iohcSession2W = new iohcSession2W();
+        return _iohcSession2W;
+    }
+
+    bool iohcSession2W::start(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (_timer) return true;
+        for (auto &slot : _wheel) slot = none;
+        _lock = xSemaphoreCreateMutex();
+        if (!_lock) return false;
+        if (!startTask(task, "iohcSessions", stackSize, this, priority, &_task, core)) return false;
+        esp_timer_create_args_t args = {};
+        args.callback = tick;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "iohcSessions";
+        // Started by the first open session
+        return esp_timer_create(&args, &_timer) == ESP_OK;
+    }
+
+    void iohcSession2W::wake() {
+        if (_ticking) return;
+        _ticking = esp_timer_start_periodic(_timer, IOHC_SESSION_TICK_MS * 1000) == ESP_OK;
+    }
+
+    iohcSession *iohcSession2W::find(const uint8_t *peer) {
+        for (auto &session : _sessions)
+            if (session.state != iohcSession::free && !memcmp(session.peer, peer, 3)) return &session;
+        return nullptr;
+    }
+
+    void iohcSession2W::arm(uint8_t index, uint32_t timeoutMs) {
+        iohcSession &session = _sessions[index];
+        uint32_t ticks = std::max<uint32_t>(1, timeoutMs / IOHC_SESSION_TICK_MS);
+        session.slot = (_cursor + ticks) % IOHC_SESSION_WHEEL_SLOTS;
+        session.rounds = (ticks - 1) / IOHC_SESSION_WHEEL_SLOTS;
+        session.next = _wheel[session.slot];
+        _wheel[session.slot] = index;
+    }
+
+    void iohcSession2W::disarm(uint8_t index) {
+        for (uint8_t *link = &_wheel[_sessions[index].slot]; *link != none; link = &_sessions[*link].next)
+            if (*link == index) {
+                *link = _sessions[index].next;
+                return;
+            }
+    }
+
+    void iohcSession2W::release(uint8_t index) {
+        disarm(index);
+        _sessions[index].state = iohcSession::free;
+        if (!--_open) iohcRxDutyCycle::getInstance()->hold(false);
+    }
+
+    bool iohcSession2W::open(const uint8_t *peer, uint8_t cmd, const uint8_t *data, size_t len, const iohcPacket *frame,
+                             uint8_t retries, bool evict) {
+        if (!_timer) return false;
+        const int64_t now = esp_timer_get_time();
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        iohcSession *session = find(peer);
+        if (session) {
+            disarm(session - _sessions);
+        } else {
+            // Free entry, or the least recently active exchange once the table is full
+            for (auto &candidate : _sessions) {
+                if (candidate.state == iohcSession::free) {
+                    session = &candidate;
+                    break;
+                }
+                if (!session || candidate.lastActivity < session->lastActivity) session = &candidate;
+            }
+            if (session->state != iohcSession::free) {
+                if (!evict) {
+                    xSemaphoreGive(_lock);
+                    _refused.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                disarm(session - _sessions);
+                _full.fetch_add(1, std::memory_order_relaxed);
+            } else if (!_open++) {
+                iohcRxDutyCycle::getInstance()->hold(true);
+            }
+        }
+
+        memcpy(session->peer, peer, 3);
+        session->state = iohcSession::sent;
+        session->cmd = cmd;
+        session->dataLen = keep(peer, cmd, len);
+        if (session->dataLen) memcpy(session->data, data, session->dataLen);
+        session->retries = frame ? retries : 0;
+        if (frame) session->frame = *frame;
+        session->opened = session->lastActivity = now;
+        arm(session - _sessions, IOHC_SESSION_TIMEOUT_MS);
+        wake();
+        xSemaphoreGive(_lock);
+        _opened.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void iohcSession2W::remember(const uint8_t *peer, uint8_t cmd, const uint8_t *data, size_t len) {
+        if (!_timer) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        iohcSession *session = find(peer);
+        if (session) {
+            session->cmd = cmd;
+            session->dataLen = keep(peer, cmd, len);
+            if (session->dataLen) memcpy(session->data, data, session->dataLen);
+            session->lastActivity = esp_timer_get_time();
+        }
+        xSemaphoreGive(_lock);
+        if (!session) open(peer, cmd, data, len, nullptr, 0);
+    }
+
+    bool iohcSession2W::challenge(const uint8_t *peer, const uint8_t *challenge, uint8_t *ivData, size_t &len) {
+        if (!_timer) return false;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        iohcSession *session = find(peer);
+        if (session) {
+            memcpy(session->challenge, challenge, sizeof(session->challenge));
+            session->state = iohcSession::challenged;
+            session->lastActivity = esp_timer_get_time();
+            ivData[0] = session->cmd;
+            memcpy(ivData + 1, session->data, session->dataLen);
+            len = 1 + session->dataLen;
+            // Our answer restarts the wait for the device
+            const uint8_t index = session - _sessions;
+            disarm(index);
+            arm(index, IOHC_SESSION_TIMEOUT_MS);
+        }
+        xSemaphoreGive(_lock);
+        return session != nullptr;
+    }
+
+    // Called before the frame is dispatched, so a handler may open a new exchange with the same peer
+    void iohcSession2W::received(const iohcPacket *iohc) {
+        const uint8_t cmd = iohc->payload.packet.header.cmd;
+        if (!_timer || cmd == IOHC_CHALLENGE_0x3C) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        iohcSession *session = find(iohc->payload.packet.header.source);
+        if (session && answers(session->cmd, cmd)) {
+            release(session - _sessions);
+            _completed.fetch_add(1, std::memory_order_relaxed);
+        }
+        xSemaphoreGive(_lock);
+    }
+
+    void iohcSession2W::close(const uint8_t *peer) {
+        if (!_timer) return;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        if (iohcSession *session = find(peer)) release(session - _sessions);
+        xSemaphoreGive(_lock);
+    }
+
+    // esp_timer task, shared by every timer: only wake the session task
+    void iohcSession2W::tick(void *arg) {
+        xTaskNotifyGive(static_cast<iohcSession2W *>(arg)->_task);
+    }
+
+    void iohcSession2W::task(void *arg) {
+        auto *self = static_cast<iohcSession2W *>(arg);
+        for (;;) {
+            // Ticks missed while busy are caught up at once
+            const uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            self->advance(ticks);
+        }
+    }
+
+    // Advance the wheel, resend or drop the sessions whose peer stayed silent
+    void iohcSession2W::advance(uint32_t ticks) {
+        size_t resend = 0;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        // Caught up by less than a timeout, a session fires once per call and _resend is enough
+        ticks = std::min<uint32_t>(ticks, std::max<uint32_t>(1, IOHC_SESSION_TIMEOUT_MS / IOHC_SESSION_TICK_MS));
+        for (uint32_t t = 0; t < ticks; t++) {
+            _cursor = (_cursor + 1) % IOHC_SESSION_WHEEL_SLOTS;
+            uint8_t index = _wheel[_cursor];
+            while (index != none) {
+                iohcSession &session = _sessions[index];
+                const uint8_t next = session.next;
+                if (session.rounds) {
+                    session.rounds--;
+                } else if (session.retries) {
+                    session.retries--;
+                    session.state = iohcSession::sent;
+                    session.lastActivity = esp_timer_get_time();
+                    disarm(index);
+                    arm(index, IOHC_SESSION_TIMEOUT_MS);
+                    _resend[resend++] = session.frame;
+                } else {
+                    release(index);
+                    _timedOut.fetch_add(1, std::memory_order_relaxed);
+                }
+                index = next;
+            }
+        }
+        if (!_open && _ticking) {
+            esp_timer_stop(_timer);
+            _ticking = false;
+        }
+        xSemaphoreGive(_lock);
+
+        // The TX queue copies the frames
+        for (size_t i = 0; i < resend; i++) {
+            std::vector<iohcPacket *> frames{&_resend[i]};
+            iohcTxQueue::getInstance()->submit(frames, txClass::interactive);
+            _retried.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t iohcSession2W::size() {
+        if (!_timer) return 0;
+        size_t count = 0;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        for (const auto &session : _sessions) count += session.state != iohcSession::free;
+        xSemaphoreGive(_lock);
+        return count;
+    }
+
+    size_t iohcSession2W::keep(const uint8_t *peer, uint8_t cmd, size_t len) {
+        if (len <= IOHC_SESSION_MAX_DATA) return len;
+        _truncated.fetch_add(1, std::memory_order_relaxed);
+        IOHC_LOGE("*** %02X%02X%02X command %02X: %u parameter bytes, only %u memorized for its challenge\n", peer[0], peer[1],
+                  peer[2], cmd, (unsigned) len, (unsigned) IOHC_SESSION_MAX_DATA);
+        return IOHC_SESSION_MAX_DATA;
+    }
+
+    void iohcSession2W::dump() {
+        printf("*Sessions %u/%u open, %u opened %u completed %u retried %u timed out %u evicted %u refused %u truncated\n",
+               (unsigned) size(), (unsigned) IOHC_SESSION_COUNT, (unsigned) _opened.load(), (unsigned) _completed.load(),
+               (unsigned) _retried.load(), (unsigned) _timedOut.load(), (unsigned) _full.load(), (unsigned) _refused.load(),
+               (unsigned) _truncated.load());
+    }
+}
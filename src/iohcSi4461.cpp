@@ -0,0 +1,187 @@
+#include <iohcSi4461.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <board-config.h>
+
+// No patch in this configuration (RADIO_CONFIGURATION_DATA_RADIO_PATCH_INCLUDED 0), a NOP dropped by si4461Compile
+#define SI446X_PATCH_CMDS 0x01, IOHC::si4461Nop
+#include "../scripts/IDAPro/Somfy-CozyTouch-Si4461-RadioConfig.h"
+
+namespace IOHC {
+    namespace {
+        constexpr uint8_t wds[] = RADIO_CONFIGURATION_DATA_ARRAY;
+        constexpr auto compiled = si4461Compile(wds);
+        constexpr auto initTable = si4461Trim<compiled.size>(compiled);
+        static_assert(initTable.valid, "Si4461 configuration not understood");
+        static_assert(initTable.xo == RADIO_CONFIGURATION_DATA_RADIO_XO_FREQ, "POWER_UP and WDS disagree on the XO");
+
+        constexpr uint32_t channelFrequencies[] = {CHANNEL1, CHANNEL2, CHANNEL3};
+        constexpr size_t channelCount = sizeof(channelFrequencies) / sizeof(channelFrequencies[0]);
+        constexpr auto hopTable = si4461MakeHops(channelFrequencies, initTable);
+        // Channel the init table leaves the PLL on, channelCount when it is none of them
+        constexpr size_t initChannel = hopTable.find(initTable.freqControl);
+
+        constexpr uint8_t startRxCommand[] = {RF_START_RX};
+
+        // Commands and bytes of the WDS array, for dump
+        struct wdsSize {
+            size_t commands = 0;
+            size_t bytes = 1;
+        };
+        constexpr wdsSize wdsInput() {
+            wdsSize s{};
+            for (size_t i = 0; wds[i]; i += wds[i] + 1)
+                if (wds[i + 1] != si4461Nop) {
+                    s.commands++;
+                    s.bytes += wds[i] + 1;
+                }
+            return s;
+        }
+        constexpr wdsSize wdsUsed = wdsInput();
+
+        // DMA buffer: the init commands, the hops, START_RX, a full FREQ_CONTROL write computed at runtime
+        // and the CTS poll, everything word aligned
+        constexpr size_t hopSlot = (sizeof(si4461Hop::command) + 3) & ~size_t(3);
+        constexpr size_t hopsAt = initTable.aligned;
+        constexpr size_t startRxAt = hopsAt + (channelCount + 1) * channelCount * hopSlot;
+        constexpr size_t scratchAt = startRxAt + ((sizeof(startRxCommand) + 3) & ~size_t(3));
+        constexpr size_t ctsAt = scratchAt + hopSlot;
+        // READ_CMD_BUFF then CTS, 4 bytes for an RX length the DMA takes as is
+        constexpr size_t ctsLen = 4;
+        constexpr size_t dmaSize = ctsAt + 2 * ctsLen;
+    }
+
+    iohcSi4461 *iohcSi4461::_iohcSi4461 = nullptr;
+
+    iohcSi4461 *iohcSi4461::getInstance() {
+        if (!_iohcSi4461)
+            _iohcSi4461 = new iohcSi4461();
+        return _iohcSi4461;
+    }
+
+    bool iohcSi4461::begin(spi_host_device_t host, int sck, int miso, int mosi, int nsel, int sdn) {
+        const int64_t started = esp_timer_get_time();
+        spi_bus_config_t bus{};
+        bus.mosi_io_num = mosi;
+        bus.miso_io_num = miso;
+        bus.sclk_io_num = sck;
+        bus.quadwp_io_num = -1;
+        bus.quadhd_io_num = -1;
+        bus.max_transfer_sz = si4461MaxCommand;
+        spi_device_interface_config_t device{};
+        device.mode = 0;
+        device.clock_speed_hz = IOHC_SI4461_SPI_HZ;
+        device.spics_io_num = nsel;
+        device.queue_size = 1;
+        if (spi_bus_initialize(host, &bus, SPI_DMA_CH_AUTO) != ESP_OK || spi_bus_add_device(host, &device, &_spi) != ESP_OK) {
+            printf("*** Si4461 SPI host %d not available\n", (int) host);
+            _spi = nullptr;
+            return false;
+        }
+        _dma = static_cast<uint8_t *>(heap_caps_malloc(dmaSize, MALLOC_CAP_DMA));
+        if (!_dma) {
+            printf("*** Si4461 %u bytes of DMA memory not available\n", (unsigned) dmaSize);
+            return false;
+        }
+        memset(_dma, 0, dmaSize);
+        size_t at = 0;
+        for (size_t i = 0; initTable.bytes[i]; i += initTable.bytes[i] + 1) {
+            memcpy(_dma + at, &initTable.bytes[i + 1], initTable.bytes[i]);
+            at += (initTable.bytes[i] + 3) & ~size_t(3);
+        }
+        for (size_t from = 0; from <= channelCount; from++)
+            for (size_t to = 0; to < channelCount; to++) {
+                const si4461Hop &hop = hopTable.hops[from][to];
+                memcpy(_dma + hopsAt + (from * channelCount + to) * hopSlot, hop.command, hop.len);
+            }
+        memcpy(_dma + startRxAt, startRxCommand, sizeof(startRxCommand));
+        _dma[ctsAt] = si4461ReadCmdBuff;
+
+        // Shutdown pulse, then the power on reset before the chip takes commands
+        pinMode(sdn, OUTPUT);
+        digitalWrite(sdn, HIGH);
+        delay(1);
+        digitalWrite(sdn, LOW);
+        delay(10);
+
+        // The bus is ours for the whole sequence, no lock taken per command
+        spi_device_acquire_bus(_spi, portMAX_DELAY);
+        bool ok = true;
+        at = 0;
+        for (size_t i = 0; ok && initTable.bytes[i]; i += initTable.bytes[i] + 1) {
+            ok = send(at, initTable.bytes[i]);
+            at += (initTable.bytes[i] + 3) & ~size_t(3);
+        }
+        ok = ok && send(startRxAt, sizeof(startRxCommand));
+        spi_device_release_bus(_spi);
+
+        _channel = initChannel;
+        _frequency = initChannel < channelCount ? channelFrequencies[initChannel] : 0;
+        _bringUpUs = esp_timer_get_time() - started;
+        if (!ok) printf("*** Si4461 init failed at byte %u of %u\n", (unsigned) at, (unsigned) initTable.aligned);
+        return ok;
+    }
+
+    bool iohcSi4461::retune(uint32_t frequency) {
+        if (!_spi) return false;
+        size_t to = 0;
+        while (to < channelCount && channelFrequencies[to] != frequency) to++;
+        bool ok = true;
+        if (to == channelCount) {
+            // Off the channel list, computed here and written in full
+            const si4461Hop hop = si4461MakeHop({}, si4461Frequency(frequency, initTable.xo, initTable.clkgenBand), true);
+            memcpy(_dma + scratchAt, hop.command, hop.len);
+            ok = send(scratchAt, hop.len);
+            _fullWrites.fetch_add(1, std::memory_order_relaxed);
+        } else if (const si4461Hop &hop = hopTable.hops[_channel][to]; hop.len) {
+            ok = send(hopsAt + (_channel * channelCount + to) * hopSlot, hop.len);
+            (_channel == channelCount ? _fullWrites : _hops).fetch_add(1, std::memory_order_relaxed);
+        }
+        // PLL setting unknown after a failed write, the next retune writes it in full
+        _channel = ok ? to : channelCount;
+        _frequency = ok ? frequency : 0;
+        // START_RX recalibrates the VCO on the new setting
+        return ok && startRx();
+    }
+
+    bool iohcSi4461::startRx() {
+        return _spi && send(startRxAt, sizeof(startRxCommand));
+    }
+
+    bool iohcSi4461::waitCts() {
+        spi_transaction_t t{};
+        t.length = ctsLen * 8;
+        t.tx_buffer = _dma + ctsAt;
+        t.rx_buffer = _dma + ctsAt + ctsLen;
+        const int64_t deadline = esp_timer_get_time() + IOHC_SI4461_CTS_US;
+        do {
+            if (spi_device_polling_transmit(_spi, &t) != ESP_OK) break;
+            if (_dma[ctsAt + ctsLen + 1] == 0xFF) return true;
+        } while (esp_timer_get_time() < deadline);
+        _ctsTimeouts.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Polling transactions: the DMA still moves the bytes, but a 16 byte command is over before an interrupt
+    // would have woken the task
+    bool iohcSi4461::send(size_t offset, size_t len) {
+        if (!waitCts()) return false;
+        spi_transaction_t t{};
+        t.length = len * 8;
+        t.tx_buffer = _dma + offset;
+        return spi_device_polling_transmit(_spi, &t) == ESP_OK;
+    }
+
+    void iohcSi4461::dump() const {
+        printf("*Si4461 init %u commands %u bytes (WDS %u commands %u bytes), up in %u us\n",
+               (unsigned) initTable.commands, (unsigned) initTable.size, (unsigned) wdsUsed.commands, (unsigned) wdsUsed.bytes,
+               (unsigned) _bringUpUs);
+        printf("*Si4461 on %u, %u hops %u full writes %u CTS timeouts%s\n", (unsigned) _frequency, (unsigned) _hops.load(),
+               (unsigned) _fullWrites.load(), (unsigned) _ctsTimeouts.load(), _spi ? "" : ", not started");
+    }
+}
@@ -0,0 +1,140 @@
+#include <iohcSnapshot.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <LittleFS.h>
+#include <esp_timer.h>
+#include <iohcCrc.h>
+
+namespace IOHC {
+    static constexpr uint32_t IOHC_SNAPSHOT_MAGIC = 0x50414E53; // "SNAP"
+    static constexpr char IOHC_SNAPSHOT_TMP[] = IOHC_SNAPSHOT_FILE ".tmp";
+    static constexpr size_t snapshotMaxSize =
+        sizeof(iohcSnapshotHeader) + sizeof(iohcSnapshotSection) + IOHC_1W_AUTH_SIZE * sizeof(iohcRemoteState);
+
+    // Shared by load and save: load runs before the writer task starts, save only on it
+    static uint8_t snapshotBuffer[snapshotMaxSize];
+
+    iohcSnapshot *iohcSnapshot::_iohcSnapshot = nullptr;
+
+    iohcSnapshot *iohcSnapshot::getInstance() {
+        if (!_iohcSnapshot)
+            _iohcSnapshot = new iohcSnapshot();
+        return _iohcSnapshot;
+    }
+
+    bool iohcSnapshot::load() {
+        const int64_t start = esp_timer_get_time();
+        File f = LittleFS.open(IOHC_SNAPSHOT_FILE, "r");
+        if (!f) return false;
+        const size_t size = f.read(snapshotBuffer, sizeof(snapshotBuffer));
+        f.close();
+
+        iohcSnapshotHeader header{};
+        if (size >= sizeof(header)) memcpy(&header, snapshotBuffer, sizeof(header));
+        if (size < sizeof(header) || header.magic != IOHC_SNAPSHOT_MAGIC || header.version != snapshotVersion ||
+            header.length != size - sizeof(header) ||
+            crc16Kermit(snapshotBuffer + sizeof(header), header.length) != header.crc) {
+            printf("*** Snapshot %s invalid, ignored\n", IOHC_SNAPSHOT_FILE);
+            return false;
+        }
+
+        const uint8_t *p = snapshotBuffer + sizeof(header);
+        const uint8_t *end = p + header.length;
+        for (uint16_t s = 0; s < header.sections && p + sizeof(iohcSnapshotSection) <= end; s++) {
+            iohcSnapshotSection section{};
+            memcpy(&section, p, sizeof(section));
+            p += sizeof(section);
+            const size_t bytes = section.count * section.recordSize;
+            if (p + bytes > end) break;
+            if (section.type == snapshotSection::remotes1W && section.recordSize == sizeof(iohcRemoteState)) {
+                iohc1WAuth *auth = iohc1WAuth::getInstance();
+                for (uint16_t i = 0; i < section.count; i++) {
+                    iohcRemoteState state;
+                    memcpy(&state, p + i * sizeof(state), sizeof(state));
+                    auth->restore(state);
+                }
+                _remotes = section.count;
+            }
+            p += bytes;
+        }
+        _savedRevision = iohc1WAuth::getInstance()->revision();
+        _size = size;
+        _loaded = true;
+        _loadUs = esp_timer_get_time() - start;
+        return true;
+    }
+
+    bool iohcSnapshot::begin(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (_task) return true;
+        return startTask(task, "iohcSnapshot", stackSize, this, priority, &_task, core);
+    }
+
+    void iohcSnapshot::changed() {
+        _pending.store(true, std::memory_order_relaxed);
+        if (_task) xTaskNotifyGive(_task);
+    }
+
+    // Written to a temporary file then renamed, a reset while saving leaves the previous snapshot
+    bool iohcSnapshot::save() {
+        iohcSnapshotHeader header{IOHC_SNAPSHOT_MAGIC, snapshotVersion, 1, 0, 0, 0};
+        iohcSnapshotSection section{snapshotSection::remotes1W, sizeof(iohcRemoteState), 0, 0};
+        iohc1WAuth *auth = iohc1WAuth::getInstance();
+        const uint32_t revision = auth->revision();
+        auto *remotes = reinterpret_cast<iohcRemoteState *>(snapshotBuffer + sizeof(header) + sizeof(section));
+        section.count = auth->save(remotes, IOHC_1W_AUTH_SIZE);
+        memcpy(snapshotBuffer + sizeof(header), &section, sizeof(section));
+
+        header.length = sizeof(section) + section.count * sizeof(iohcRemoteState);
+        header.crc = crc16Kermit(snapshotBuffer + sizeof(header), header.length);
+        memcpy(snapshotBuffer, &header, sizeof(header));
+        const size_t size = sizeof(header) + header.length;
+
+        File f = LittleFS.open(IOHC_SNAPSHOT_TMP, "w");
+        bool ok = f && f.write(snapshotBuffer, size) == size;
+        if (f) f.close();
+        // The rename replaces the previous snapshot in one step, removing it first would open a window without any
+        ok = ok && LittleFS.rename(IOHC_SNAPSHOT_TMP, IOHC_SNAPSHOT_FILE);
+        if (!ok) {
+            LittleFS.remove(IOHC_SNAPSHOT_TMP);
+            _failures.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _savedRevision = revision;
+        _size = size;
+        _remotes = section.count;
+        _saves.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void iohcSnapshot::task(void *arg) {
+        auto *self = static_cast<iohcSnapshot *>(arg);
+        for (;;) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IOHC_SNAPSHOT_PERIOD_MS));
+            const bool pending = self->_pending.exchange(false, std::memory_order_relaxed);
+            if (pending || iohc1WAuth::getInstance()->revision() != self->_savedRevision) self->save();
+        }
+    }
+
+    // Same content as the binary file, keys included: for backups and the Python tools
+    void iohcSnapshot::exportJson() {
+        iohcRemoteState remotes[IOHC_1W_AUTH_SIZE];
+        const size_t count = iohc1WAuth::getInstance()->save(remotes, IOHC_1W_AUTH_SIZE);
+        printf("{\"version\":%u,\"remotes1W\":[", (unsigned) snapshotVersion);
+        for (size_t i = 0; i < count; i++) {
+            const iohcRemoteState &r = remotes[i];
+            printf("%s{\"address\":\"%02X%02X%02X\",\"key\":\"", i ? "," : "", r.address[0], r.address[1], r.address[2]);
+            for (uint8_t b : r.key) printf("%02X", b);
+            if (r.hasSequence) printf("\",\"sequence\":%u}", (unsigned) r.lastSequence);
+            else printf("\"}");
+        }
+        printf("]}\n");
+    }
+
+    void iohcSnapshot::dump() {
+        printf("*Snapshot %u bytes, %u 1W remotes, %s in %u us, %u saves %u failed\n", (unsigned) _size,
+               (unsigned) _remotes, _loaded ? "loaded" : "not loaded", (unsigned) _loadUs, (unsigned) _saves.load(),
+               (unsigned) _failures.load());
+    }
+}
@@ -0,0 +1,180 @@
+#include <iohcStats.h>
+
+#include <cstdio>
+
+#if !defined(IOHC_NATIVE)
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+}
+#include <iohcPublisher.h>
+#endif
+
+namespace IOHC {
+    iohcStats *iohcStats::_iohcStats = nullptr;
+
+    iohcStats *iohcStats::getInstance() {
+        if (!_iohcStats)
+            _iohcStats = new iohcStats();
+        return _iohcStats;
+    }
+
+    const char *statMetricName(statMetric metric) {
+        switch (metric) {
+            case statMetric::rxToDispatch: return "rxToDispatch";
+            case statMetric::dispatch: return "dispatch";
+            case statMetric::answer: return "answer";
+            case statMetric::aes: return "aes";
+            case statMetric::count: break;
+        }
+        return "?";
+    }
+
+    iohcStats::perCore &iohcStats::slot() {
+#if defined(IOHC_NATIVE)
+        return _cores[0];
+#else
+        return _cores[xPortGetCoreID() % IOHC_STATS_CORES];
+#endif
+    }
+
+    void iohcStats::record(statMetric metric, uint32_t us) {
+        histogram &h = slot().latency[static_cast<size_t>(metric)];
+        h.buckets[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+        h.count.fetch_add(1, std::memory_order_relaxed);
+        h.sum.fetch_add(us, std::memory_order_relaxed);
+        // Tasks of the same core may interleave here
+        uint32_t max = h.max.load(std::memory_order_relaxed);
+        while (us > max && !h.max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {}
+    }
+
+    uint32_t iohcStats::frames(uint8_t cmd) const {
+        uint32_t total = 0;
+        for (const auto &core : _cores) total += core.frames[cmd].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint32_t iohcStats::unknowns() const {
+        uint32_t total = 0;
+        for (const auto &core : _cores) total += core.unknown.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    void iohcStats::collect(statMetric metric, uint32_t *buckets, uint32_t &count, uint32_t &sum, uint32_t &max) const {
+        count = sum = max = 0;
+        for (size_t b = 0; b < IOHC_STATS_BUCKETS; b++) buckets[b] = 0;
+        for (const auto &core : _cores) {
+            const histogram &h = core.latency[static_cast<size_t>(metric)];
+            for (size_t b = 0; b < IOHC_STATS_BUCKETS; b++) buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+            count += h.count.load(std::memory_order_relaxed);
+            sum += h.sum.load(std::memory_order_relaxed);
+            uint32_t m = h.max.load(std::memory_order_relaxed);
+            if (m > max) max = m;
+        }
+    }
+
+    uint32_t iohcStats::percentile(statMetric metric, uint8_t pct) const {
+        uint32_t buckets[IOHC_STATS_BUCKETS], count, sum, max;
+        collect(metric, buckets, count, sum, max);
+        if (!count) return 0;
+        uint32_t rank = ((uint64_t) count * pct + 99) / 100, seen = 0;
+        for (size_t b = 0; b < IOHC_STATS_BUCKETS - 1; b++) {
+            seen += buckets[b];
+            if (seen >= rank) return b && (1u << b) < max ? 1u << b : max;
+        }
+        return max;
+    }
+
+    void iohcStats::reset() {
+        for (auto &core : _cores) {
+            for (auto &frames : core.frames) frames.store(0, std::memory_order_relaxed);
+            core.unknown.store(0, std::memory_order_relaxed);
+            for (auto &h : core.latency) {
+                for (auto &b : h.buckets) b.store(0, std::memory_order_relaxed);
+                h.count.store(0, std::memory_order_relaxed);
+                h.sum.store(0, std::memory_order_relaxed);
+                h.max.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void iohcStats::dump() const {
+        uint32_t total = 0;
+        printf("*Frames per command:");
+        for (size_t cmd = 0; cmd < 256; cmd++) {
+            uint32_t count = frames(cmd);
+            if (!count) continue;
+            total += count;
+            printf(" %02X:%u", (unsigned) cmd, (unsigned) count);
+        }
+        printf("\n*%u frames, %u unknown commands\n", (unsigned) total, (unsigned) unknowns());
+
+        for (size_t m = 0; m < metrics; m++) {
+            const auto metric = static_cast<statMetric>(m);
+            uint32_t buckets[IOHC_STATS_BUCKETS], count, sum, max;
+            collect(metric, buckets, count, sum, max);
+            printf("*%-12s %6u samples", statMetricName(metric), (unsigned) count);
+            if (count)
+                printf(" avg %u p50 <%u p99 <%u max %u us", (unsigned) (sum / count), (unsigned) percentile(metric, 50),
+                       (unsigned) percentile(metric, 99), (unsigned) max);
+            printf("\n");
+            if (!count) continue;
+            // Histogram lines only for the used buckets
+            printf("  ");
+            for (size_t b = 0; b < IOHC_STATS_BUCKETS; b++)
+                if (buckets[b]) printf(" <%u:%u", b == IOHC_STATS_BUCKETS - 1 ? max : 1u << b, (unsigned) buckets[b]);
+            printf("\n");
+        }
+    }
+
+    size_t iohcStats::toJson(char *out, size_t size) const {
+        size_t len = 0;
+        auto append = [&](const char *fmt, auto... args) {
+            if (len < size) len += snprintf(out + len, size - len, fmt, args...);
+        };
+        append("{\"unknown\":%u,\"frames\":{", (unsigned) unknowns());
+        bool first = true;
+        for (size_t cmd = 0; cmd < 256; cmd++) {
+            uint32_t count = frames(cmd);
+            if (!count) continue;
+            append("%s\"%02x\":%u", first ? "" : ",", (unsigned) cmd, (unsigned) count);
+            first = false;
+        }
+        append("}");
+        for (size_t m = 0; m < metrics; m++) {
+            const auto metric = static_cast<statMetric>(m);
+            uint32_t buckets[IOHC_STATS_BUCKETS], count, sum, max;
+            collect(metric, buckets, count, sum, max);
+            append(",\"%s\":{\"count\":%u,\"avg\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u}", statMetricName(metric),
+                   (unsigned) count, (unsigned) (count ? sum / count : 0), (unsigned) percentile(metric, 50),
+                   (unsigned) percentile(metric, 99), (unsigned) max);
+        }
+        append("}");
+        return len < size ? len : 0;
+    }
+
+#if defined(IOHC_NATIVE)
+    bool iohcStats::startPublishing(const char *, uint32_t) { return false; }
+    void iohcStats::publishTimer(void *) {}
+#else
+    bool iohcStats::startPublishing(const char *topic, uint32_t periodMs) {
+        if (_timer) return true;
+        _topic = topic;
+        esp_timer_create_args_t args = {};
+        args.callback = publishTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "iohcStats";
+        if (esp_timer_create(&args, &_timer) != ESP_OK) return false;
+        return esp_timer_start_periodic(_timer, (uint64_t) periodMs * 1000) == ESP_OK;
+    }
+
+    size_t iohcStats::buildJson(char *out, size_t size) { return getInstance()->toJson(out, size); }
+
+    // esp_timer task: only wakes the publisher, which builds the JSON and talks to the broker itself
+    void iohcStats::publishTimer(void *arg) {
+        auto *self = static_cast<iohcStats *>(arg);
+        iohcPublisher::getInstance()->report(self->_topic, buildJson);
+    }
+#endif
+}
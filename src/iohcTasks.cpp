@@ -0,0 +1,39 @@
+#include <iohcTasks.h>
+
+#include <cstdio>
+
+namespace IOHC {
+    struct iohcTaskEntry {
+        const char *name;
+        TaskHandle_t handle;
+        uint32_t stackSize;
+        BaseType_t core;
+    };
+
+    static iohcTaskEntry tasks[IOHC_TASKS_MAX];
+    static size_t taskCount = 0;
+    static portMUX_TYPE tasksMux = portMUX_INITIALIZER_UNLOCKED;
+
+    bool startTask(TaskFunction_t func, const char *name, uint32_t stackSize, void *arg, UBaseType_t priority,
+                   TaskHandle_t *handle, BaseType_t core) {
+        if (xTaskCreatePinnedToCore(func, name, stackSize, arg, priority, handle, core) != pdPASS) {
+            printf("*** Task %s not started (%u bytes stack)\n", name, (unsigned) stackSize);
+            return false;
+        }
+        portENTER_CRITICAL(&tasksMux);
+        if (taskCount < IOHC_TASKS_MAX) tasks[taskCount++] = {name, *handle, stackSize, core};
+        portEXIT_CRITICAL(&tasksMux);
+        return true;
+    }
+
+    void dumpTasks() {
+        printf("*Tasks: name core priority stack free/size\n");
+        for (size_t i = 0; i < taskCount; i++) {
+            const iohcTaskEntry &task = tasks[i];
+            printf("  %-12s %d %2u %5u/%u\n", task.name, (int) task.core, (unsigned) uxTaskPriorityGet(task.handle),
+                   (unsigned) uxTaskGetStackHighWaterMark(task.handle), (unsigned) task.stackSize);
+        }
+        printf("  %-12s %d %2u %5u\n", pcTaskGetName(nullptr), (int) xPortGetCoreID(),
+               (unsigned) uxTaskPriorityGet(nullptr), (unsigned) uxTaskGetStackHighWaterMark(nullptr));
+    }
+}
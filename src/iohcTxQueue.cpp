@@ -0,0 +1,219 @@
+#include <iohcTxQueue.h>
+
+#include <climits>
+#include <cstdio>
+
+#include <esp_timer.h>
+#include <iohcRxDutyCycle.h>
+#include <iohcStats.h>
+#include <iohcTxScheduler.h>
+
+namespace IOHC {
+    iohcTxQueue *iohcTxQueue::_iohcTxQueue = nullptr;
+
+    iohcTxQueue *iohcTxQueue::getInstance() {
+        if (!_iohcTxQueue)
+            _iohcTxQueue = new iohcTxQueue();
+        return _iohcTxQueue;
+    }
+
+    bool iohcTxQueue::start(BaseType_t core, UBaseType_t priority, uint32_t stackSize) {
+        if (_task) return true;
+        for (uint8_t i = 0; i < IOHC_TX_QUEUE_SIZE; i++)
+            _jobs[i].next = i + 1 < IOHC_TX_QUEUE_SIZE ? i + 1 : none;
+        _free = 0;
+        _onAirList.reserve(IOHC_TX_JOB_PACKETS);
+        _lock = xSemaphoreCreateMutex();
+        if (!_lock) return false;
+        return startTask(task, "iohcTx", stackSize, this, priority, &_task, core);
+    }
+
+    uint8_t iohcTxQueue::take(uint8_t &list) {
+        uint8_t index = list;
+        if (index != none) list = _jobs[index].next;
+        return index;
+    }
+
+    void iohcTxQueue::append(uint8_t &list, uint8_t index) {
+        uint8_t *link = &list;
+        while (*link != none) link = &_jobs[*link].next;
+        _jobs[index].next = none;
+        *link = index;
+    }
+
+    void iohcTxQueue::unlink(uint8_t &list, uint8_t index) {
+        for (uint8_t *link = &list; *link != none; link = &_jobs[*link].next)
+            if (*link == index) {
+                *link = _jobs[index].next;
+                return;
+            }
+    }
+
+    bool iohcTxQueue::linked(uint8_t list, uint8_t index, uint32_t id) const {
+        for (; list != none; list = _jobs[list].next)
+            if (list == index) return _jobs[index].id == id;
+        return false;
+    }
+
+    void iohcTxQueue::release(uint8_t index) {
+        if (_train == index) _train = none;
+        _jobs[index].next = _free;
+        _free = index;
+    }
+
+    bool iohcTxQueue::submit(const std::vector<iohcPacket *> &packets, txClass cls, int64_t deadline, bool agile,
+                             sentFunc sent, void *sentArg) {
+        if (!_task || packets.empty() || packets.size() > IOHC_TX_JOB_PACKETS) return false;
+        const int64_t now = esp_timer_get_time();
+        const uint8_t c = static_cast<uint8_t>(cls);
+
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        uint8_t index = take(_free);
+        if (index == none) {
+            xSemaphoreGive(_lock);
+            _full.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        job &j = _jobs[index];
+        for (size_t i = 0; i < packets.size(); i++) j.packets[i] = *packets[i];
+        j.count = packets.size();
+        j.remaining = packets[0]->repeat + 1u;
+        j.attempts = 0;
+        j.id = ++_ids;
+        j.gapUs = packets[0]->repeatTime * 1000;
+        j.notBefore = now + packets[0]->delayed * 1000;
+        j.deadline = deadline;
+        j.origin = cls == txClass::realtime ? iohcStats::getInstance()->dispatchStart() : 0;
+        j.agile = agile;
+        j.sent = sent;
+        j.sentArg = sentArg;
+        append(_heads[c], index);
+        xSemaphoreGive(_lock);
+
+        _submitted[c].fetch_add(1, std::memory_order_relaxed);
+        xTaskNotifyGive(_task);
+        return true;
+    }
+
+    void iohcTxQueue::cancel(txClass cls) {
+        const uint8_t c = static_cast<uint8_t>(cls);
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        for (uint8_t index = take(_heads[c]); index != none; index = take(_heads[c])) release(index);
+        xSemaphoreGive(_lock);
+    }
+
+    size_t iohcTxQueue::room() const {
+        if (!_task) return 0;
+        size_t count = 0;
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        for (uint8_t index = _free; index != none; index = _jobs[index].next) count++;
+        xSemaphoreGive(_lock);
+        return count;
+    }
+
+    uint8_t iohcTxQueue::pick(int64_t now, int64_t &wait, uint8_t &cls) {
+        wait = INT64_MAX;
+        for (uint8_t c = 0; c < classes; c++) {
+            uint8_t *link = &_heads[c];
+            while (*link != none) {
+                const uint8_t index = *link;
+                job &j = _jobs[index];
+                if (j.deadline && now > j.deadline) {
+                    *link = j.next;
+                    release(index);
+                    _expired.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                if (j.notBefore <= now) {
+                    cls = c;
+                    return index;
+                }
+                if (j.notBefore - now < wait) wait = j.notBefore - now;
+                link = &j.next;
+            }
+        }
+        return none;
+    }
+
+    void iohcTxQueue::task(void *arg) {
+        auto *self = static_cast<iohcTxQueue *>(arg);
+        iohcTxScheduler *scheduler = iohcTxScheduler::getInstance();
+        for (;;) {
+            int64_t wait;
+            uint8_t c = 0;
+            xSemaphoreTake(self->_lock, portMAX_DELAY);
+            const uint8_t index = self->pick(esp_timer_get_time(), wait, c);
+            if (index == none) {
+                xSemaphoreGive(self->_lock);
+                TickType_t ticks = wait == INT64_MAX ? portMAX_DELAY : pdMS_TO_TICKS((wait + 999) / 1000);
+                ulTaskNotifyTake(pdTRUE, ticks ? ticks : 1);
+                continue;
+            }
+
+            job &j = self->_jobs[index];
+            iohcPacket *onAir = self->_onAir;
+            self->_onAirList.clear();
+            for (uint8_t i = 0; i < j.count; i++) {
+                onAir[i] = j.packets[i];
+                onAir[i].repeat = 0; // The train is driven from here
+                onAir[i].delayed = 0;
+                self->_onAirList.push_back(&onAir[i]);
+            }
+            const bool agile = j.agile;
+            const int64_t deadline = j.deadline;
+            const uint8_t attempt = j.attempts;
+            const uint32_t id = j.id;
+            xSemaphoreGive(self->_lock);
+
+            // Listen before talk outside the lock, submitters are not held by the RSSI samples
+            const uint32_t backoff = agile ? scheduler->listen1W(self->_onAirList, attempt)
+                                           : scheduler->listen(self->_onAirList, deadline, attempt);
+
+            xSemaphoreTake(self->_lock, portMAX_DELAY);
+            // Cancelled meanwhile
+            if (!self->linked(self->_heads[c], index, id)) {
+                xSemaphoreGive(self->_lock);
+                continue;
+            }
+            if (backoff) {
+                j.attempts++;
+                j.notBefore = esp_timer_get_time() + backoff;
+                xSemaphoreGive(self->_lock);
+                self->_deferred.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (self->_train != none && self->_train != index && c < self->_trainClass)
+                self->_preempted.fetch_add(1, std::memory_order_relaxed);
+            const int64_t origin = j.origin;
+            const sentFunc sent = j.sent;
+            void *sentArg = j.sentArg;
+            j.origin = 0; // Repeats are not answers
+            j.attempts = 0;
+            if (--j.remaining) {
+                j.notBefore = esp_timer_get_time() + j.gapUs;
+                self->_train = index;
+                self->_trainClass = c;
+            } else {
+                self->unlink(self->_heads[c], index);
+                self->release(index);
+            }
+            xSemaphoreGive(self->_lock);
+
+            scheduler->transmit(self->_onAirList);
+            // The radio sends asynchronously from _onAir, the next job waits for it
+            scheduler->waitSent(self->_onAirList);
+            iohcRxDutyCycle::getInstance()->awake(IOHC_DUTY_TX_HOLD_MS);
+            if (sent) sent(&onAir[0], sentArg);
+            self->_sent[c].fetch_add(1, std::memory_order_relaxed);
+            if (origin) iohcStats::getInstance()->since(statMetric::answer, origin);
+        }
+    }
+
+    void iohcTxQueue::dump() const {
+        static const char *names[classes] = {"realtime", "interactive", "background"};
+        for (uint8_t c = 0; c < classes; c++)
+            printf("*TX %s %u submitted %u sent\t", names[c], (unsigned) _submitted[c].load(), (unsigned) _sent[c].load());
+        printf("\n*TX %u expired %u preempted %u deferred %u refused\n", (unsigned) _expired.load(),
+               (unsigned) _preempted.load(), (unsigned) _deferred.load(), (unsigned) _full.load());
+    }
+}
@@ -0,0 +1,144 @@
+#include <iohcTxScheduler.h>
+
+#include <cstdio>
+
+#include <Arduino.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <board-config.h>
+#include <iohcRadioSet.h>
+
+namespace IOHC {
+    iohcTxScheduler *iohcTxScheduler::_iohcTxScheduler = nullptr;
+
+    iohcTxScheduler *iohcTxScheduler::getInstance() {
+        if (!_iohcTxScheduler)
+            _iohcTxScheduler = new iohcTxScheduler();
+        return _iohcTxScheduler;
+    }
+
+    iohcTxScheduler::iohcTxScheduler() {
+        _channels[0].frequency = CHANNEL1;
+        _channels[1].frequency = CHANNEL2;
+        _channels[2].frequency = CHANNEL3;
+    }
+
+    int64_t iohcTxScheduler::replyDeadline() {
+        return esp_timer_get_time() + IOHC_2W_REPLY_BUDGET_US;
+    }
+
+    iohcTxScheduler::channelStats *iohcTxScheduler::stats(uint32_t frequency) {
+        for (auto &channel : _channels)
+            if (channel.frequency == frequency) return &channel;
+        return nullptr;
+    }
+
+    // Exponential moving average over the last ~16 observations
+    void iohcTxScheduler::update(channelStats &channel, bool busy) {
+        uint32_t occupancy = channel.occupancy.load(std::memory_order_relaxed);
+        occupancy = occupancy - occupancy / 16 + (busy ? occupancyScale / 16 : 0);
+        channel.occupancy.store(occupancy, std::memory_order_relaxed);
+    }
+
+    void iohcTxScheduler::noteReceived(const iohcPacket *iohc) {
+        if (!memcmp(iohc->payload.packet.header.target, _gateway, sizeof(_gateway))) return;
+        if (channelStats *channel = stats(iohc->frequency)) update(*channel, true);
+    }
+
+    bool iohcTxScheduler::clearChannel(uint32_t frequency) {
+        if (!_hooks.readRssi) return true;
+        bool busy = false;
+        for (uint8_t i = 0; i < IOHC_LBT_SAMPLES && !busy; i++) {
+            if (i) delayMicroseconds(IOHC_LBT_SAMPLE_US);
+            busy = _hooks.readRssi(frequency) > IOHC_LBT_THRESHOLD_DBM;
+        }
+        if (channelStats *channel = stats(frequency)) {
+            update(*channel, busy);
+            channel->assessments.fetch_add(1, std::memory_order_relaxed);
+            if (busy) channel->busy.fetch_add(1, std::memory_order_relaxed);
+        }
+        return !busy;
+    }
+
+    uint32_t iohcTxScheduler::leastBusy() const {
+        const channelStats *best = &_channels[0];
+        for (const auto &channel : _channels)
+            if (channel.occupancy.load(std::memory_order_relaxed) < best->occupancy.load(std::memory_order_relaxed))
+                best = &channel;
+        return best->frequency;
+    }
+
+    void iohcTxScheduler::setFrequency(std::vector<iohcPacket *> &packets, uint32_t frequency) {
+        for (auto *packet : packets) packet->frequency = frequency;
+    }
+
+    // Random slot in [1, IOHC_LBT_BACKOFF_MS << attempt] so colliding senders spread out
+    uint32_t iohcTxScheduler::backoffMs(uint8_t attempt) {
+        return 1 + esp_random() % (IOHC_LBT_BACKOFF_MS << attempt);
+    }
+
+    uint32_t iohcTxScheduler::listen(const std::vector<iohcPacket *> &packets, int64_t deadline, uint8_t attempt) {
+        if (packets.empty() || attempt >= IOHC_LBT_MAX_ATTEMPTS || clearChannel(packets[0]->frequency)) return 0;
+        const uint32_t wait = backoffMs(attempt) * 1000;
+        if (deadline && esp_timer_get_time() + wait >= deadline) {
+            // Late answers are ignored by the device, a collision still has a chance
+            _forced.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        _backoffs.fetch_add(1, std::memory_order_relaxed);
+        return wait;
+    }
+
+    uint32_t iohcTxScheduler::listen1W(std::vector<iohcPacket *> &packets, uint8_t attempt) {
+        uint32_t frequency = leastBusy();
+        if (attempt < IOHC_LBT_MAX_ATTEMPTS) {
+            for (size_t hop = 0; !clearChannel(frequency); hop++) {
+                // Busy: the assessment raised its occupancy, try the now least busy channel
+                const uint32_t next = leastBusy();
+                if (next == frequency || hop + 1 == channels) {
+                    _backoffs.fetch_add(1, std::memory_order_relaxed);
+                    return backoffMs(attempt) * 1000;
+                }
+                frequency = next;
+                _hops.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        setFrequency(packets, frequency);
+        return 0;
+    }
+
+    void iohcTxScheduler::transmit(std::vector<iohcPacket *> &packets) {
+        if (packets.empty()) return;
+        if (channelStats *channel = stats(packets[0]->frequency)) channel->sent.fetch_add(1, std::memory_order_relaxed);
+        iohcRadioSet::getInstance()->send(packets);
+    }
+
+    void iohcTxScheduler::waitSent(const std::vector<iohcPacket *> &packets) {
+        uint32_t airtime = 0;
+        for (const auto *packet : packets) airtime += frameAirtimeUs(packet->buffer_length);
+        const int64_t sent = esp_timer_get_time() + airtime;
+        if (!_hooks.txBusy) {
+            // Whole ticks, never less than the air time
+            vTaskDelay(pdMS_TO_TICKS((airtime + 999) / 1000) + 1);
+            return;
+        }
+        const int64_t giveUp = sent + IOHC_TX_DONE_MARGIN_US;
+        while (_hooks.txBusy()) {
+            if (esp_timer_get_time() > giveUp) {
+                _txTimeouts.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            vTaskDelay(1);
+        }
+    }
+
+    void iohcTxScheduler::dump() const {
+        for (const auto &channel : _channels)
+            printf("*Channel %u occupancy %u%% %u/%u busy %u sent\t", (unsigned) channel.frequency,
+                   (unsigned) (channel.occupancy.load() * 100 / occupancyScale), (unsigned) channel.busy.load(),
+                   (unsigned) channel.assessments.load(), (unsigned) channel.sent.load());
+        printf("\n*LBT %u backoffs %u hops %u sent past deadline%s, %u TX done timeouts\n", (unsigned) _backoffs.load(),
+               (unsigned) _hops.load(), (unsigned) _forced.load(), _hooks.readRssi ? "" : " (no RSSI hook, disabled)",
+               (unsigned) _txTimeouts.load());
+    }
+}
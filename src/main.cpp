@@ -6,12 +6,38 @@
 #include <iohcCryptoHelpers.h>
 #include <iohcRadio.h>
 
-#include <iohcSystemTable.h>
 #include <fileSystemHelpers.h>
-#include <ArduinoJson.h>
 #include <iohcRemote1W.h>
 #include <iohcCozyDevice2W.h>
 #include <iohcOtherDevice2W.h>
+#include <iohcRxPipeline.h>
+#include <iohcRadioSet.h>
+#include <iohcSi4461.h>
+#include <iohcPacketPool.h>
+#include <iohcDispatcher.h>
+#include <iohcGateway.h>
+#include <iohcKeyCache.h>
+#include <iohcBench.h>
+#include <iohcPublisher.h>
+#include <iohcPacketArchive.h>
+#include <iohcNodeIndex.h>
+#include <iohcTxScheduler.h>
+#include <iohcTxQueue.h>
+#include <iohcSession2W.h>
+#include <iohcScanEngine.h>
+#include <iohcGroupCommand.h>
+#include <iohcStats.h>
+#include <iohcLog.h>
+#include <iohcTrace.h>
+#include <iohcTasks.h>
+#include <iohcEventLoop.h>
+#include <iohcConsole.h>
+#include <iohcRxDutyCycle.h>
+#include <iohcSnapshot.h>
+
+#if defined(CONFIG_PM_ENABLE)
+    #include <esp_pm.h>
+#endif
 
 extern "C" {
 	#include "freertos/FreeRTOS.h"
@@ -55,14 +81,22 @@ extern "C" {
 //AsyncWebSocket ws("/ws"); // access at ws://[esp ip]/ws
 //AsyncEventSource events("/events"); // event source (Server-Sent events)
 
+// Light sleep between events (CONFIG_PM_ENABLE builds), the radio has to be able to wake the chip
+#ifndef IOHC_LIGHT_SLEEP
+    #define IOHC_LIGHT_SLEEP false
+#endif
+
 // Receiving buffer
 bool verbosity = true;
 bool pairMode = false;
 bool scanMode = false;
+bool archiveMode = false;
 
 void txUserBuffer(Tokens* cmd);
 void testKey();
 void scanDump();
+void listNodes();
+size_t hexToBytes(const std::string& hex, uint8_t* out, size_t max);
 
 uint8_t keyCap[16] = {};
 //uint8_t source_originator[3] = {0};
@@ -70,15 +104,28 @@ uint8_t keyCap[16] = {};
 
 //#define MAXPACKETS  199
 IOHC::iohcRadio* radioInstance;
-IOHC::iohcPacket* radioPackets[IOHC_INBOUND_MAX_PACKETS];
+IOHC::iohcRadioSet* radioSet;
+IOHC::iohcRxPipeline* rxPipeline;
+IOHC::iohcDispatcher* dispatcher;
+IOHC::iohcPacketArchive* archive;
+IOHC::iohcNodeIndex* nodeIndex;
+IOHC::iohcTxScheduler* txScheduler;
+IOHC::iohcTxQueue* txQueue;
+IOHC::iohcSession2W* sessions;
+IOHC::iohcEventLoop* eventLoop;
+IOHC::iohcRxDutyCycle* dutyCycle;
+IOHC::iohcConsole* console;
+IOHC::iohcSnapshot* snapshot;
+// Boot milestones, esp_timer us since reset: radio listening, device tables loaded
+int64_t radioUpUs = 0;
+int64_t devicesUpUs = 0;
+// All packets come from fixed pools, nothing is allocated on the heap once running
+outboundPoolType outboundPool;
+
 //IOHC::iohcPacket *packets2send[IOHC_OUTBOUND_MAX_PACKETS];
 //std::array<IOHC::iohcPacket *, 25> packets2send;
-std::vector<IOHC::iohcPacket*> packets2send{};
-std::vector<IOHC::iohcPacket*> packets2send_tmp{};
-
-uint8_t nextPacket = 0;
+outboundList packets2send{outboundPool};
 
-IOHC::iohcSystemTable* sysTable;
 IOHC::iohcRemote1W* remote1W;
 IOHC::iohcCozyDevice2W* cozyDevice2W;
 IOHC::iohcOtherDevice2W* otherDevice2W;
@@ -87,8 +134,13 @@ IOHC::iohcOtherDevice2W* otherDevice2W;
 uint32_t frequencies[] = FREQS2SCAN;
 
 bool publishMsg(IOHC::iohcPacket* iohc);
-bool IRAM_ATTR msgRcvd(IOHC::iohcPacket* iohc);
+bool mqttPublish(const char* topic, const char* payload, size_t len);
+bool msgRcvd(IOHC::iohcPacket* iohc);
+bool rxDispatch(IOHC::iohcPacket* iohc);
+bool IRAM_ATTR rxEnqueue(IOHC::iohcPacket* iohc);
 bool msgArchive(IOHC::iohcPacket* iohc);
+void msgList1W(const IOHC::iohcArchiveRecord& record);
+void msgList2W(const IOHC::iohcArchiveRecord& record);
 
 #if defined(ESP8266)
       Timers::TickerUs kbd_tick;
@@ -104,6 +156,8 @@ void setup() {
 #endif
 
     Serial.begin(115200); //SERIALSPEED);
+    // Receive path messages are buffered and written out by a low priority task
+    IOHC::iohcLog::getInstance()->start();
 
     pinMode(RX_LED, OUTPUT); // we are goning to blink this LED
     digitalWrite(RX_LED, 1);
@@ -137,6 +191,16 @@ void setup() {
 #elif defined(ESP32)
     LittleFS.begin();
 #endif
+    // Learned 1W keys and sequence numbers, one binary read instead of waiting for the remotes to push them again
+    snapshot = IOHC::iohcSnapshot::getInstance();
+    snapshot->load();
+    snapshot->begin();
+    // Received frames are kept on flash, list1W/list2W replay them from there
+    archive = IOHC::iohcPacketArchive::getInstance();
+    archive->begin();
+    // Paired nodes, sorted by address and saved through a journal
+    nodeIndex = IOHC::iohcNodeIndex::getInstance();
+    nodeIndex->begin();
 
     /*
         // Start MDNS
@@ -238,512 +302,363 @@ void setup() {
     //    server.onNotFound(onRequest);
     //    server.onRequestBody(onBody);
     //    server.begin();
+    // Received frames handlers, one table entry per command byte
+    dispatcher = IOHC::iohcDispatcher::getInstance();
+    IOHC::registerCozyDevice2WHandlers(dispatcher);
+    IOHC::registerOtherDevice2WHandlers(dispatcher);
+    IOHC::registerRemote1WHandlers(dispatcher);
+
+    #if defined(MQTT)
+        IOHC::iohcPublisher::getInstance()->start(mqttPublish, "iown/Frame");
+        IOHC::iohcStats::getInstance()->startPublishing("iown/Stats");
+    #endif
+    // Radio callback only queues the frame, msgRcvd runs on the pinned dispatch task
+    // Frames are held in the rings until the device tables below are loaded
+    rxPipeline = IOHC::iohcRxPipeline::getInstance();
+    rxPipeline->hold();
+    rxPipeline->start(rxDispatch);
     radioInstance = IOHC::iohcRadio::getInstance();
-    radioInstance->start(MAX_FREQS, frequencies, 0, msgRcvd, nullptr); //publishMsg); //msgArchive); //, msgRcvd);
+    // Transceiver hooks from user_config.h: listen before talk needs IOHC_RADIO_READ_RSSI,
+    // RX duty cycling IOHC_RADIO_SLEEP, IOHC_RADIO_RESUME and IOHC_RADIO_DETECT_PREAMBLE (or the RSSI),
+    // IOHC_RADIO_TX_BUSY ends the wait for a sent frame as soon as the transceiver is done
+    IOHC::iohcRadioHooks radioHooks;
+    #if defined(IOHC_RADIO_READ_RSSI)
+        radioHooks.readRssi = IOHC_RADIO_READ_RSSI;
+    #endif
+    #if defined(IOHC_RADIO_SLEEP) && defined(IOHC_RADIO_RESUME)
+        radioHooks.sleep = IOHC_RADIO_SLEEP;
+        radioHooks.resume = IOHC_RADIO_RESUME;
+    #endif
+    #if defined(IOHC_RADIO_DETECT_PREAMBLE)
+        radioHooks.detectPreamble = IOHC_RADIO_DETECT_PREAMBLE;
+    #endif
+    #if defined(IOHC_RADIO_TX_BUSY)
+        radioHooks.txBusy = IOHC_RADIO_TX_BUSY;
+    #endif
+    txScheduler = IOHC::iohcTxScheduler::getInstance();
+    txScheduler->setHooks(radioHooks);
+    // Frames are sent by priority class, 2W answers first
+    txQueue = IOHC::iohcTxQueue::getInstance();
+    txQueue->start();
+    // One 2W exchange per peer, timeouts and retries on an esp_timer wheel
+    sessions = IOHC::iohcSession2W::getInstance();
+    sessions->start();
+    radioInstance->start(MAX_FREQS, frequencies, 0, rxEnqueue, nullptr); //publishMsg); //msgArchive); //, msgRcvd);
+    // Extra transceivers parked on one channel each (board-config.h), frames go out on the radio owning the channel
+    radioSet = IOHC::iohcRadioSet::getInstance();
+    #if defined(IOHC_RADIO_PORTS)
+        static const IOHC::iohcRadioPort radioPorts[] = IOHC_RADIO_PORTS;
+        for (const auto& port : radioPorts) radioSet->add(port);
+    #endif
+    radioSet->start();
+    #if defined(IOHC_SI4461_NSEL)
+        // Si4461 on its own SPI bus (board-config.h), brought up from the CozyTouch configuration
+        IOHC::iohcSi4461::getInstance()->begin(IOHC_SI4461_SPI_HOST, IOHC_SI4461_SCK, IOHC_SI4461_MISO, IOHC_SI4461_MOSI,
+                                               IOHC_SI4461_NSEL, IOHC_SI4461_SDN);
+    #endif
+    // Sleeps the transceiver between preamble sniffs, for battery powered gateways
+    dutyCycle = IOHC::iohcRxDutyCycle::getInstance();
+    dutyCycle->setHooks(radioHooks);
+    dutyCycle->start(frequencies, MAX_FREQS);
+    #if defined(IOHC_RX_DUTY_CYCLE)
+        if (!dutyCycle->enable(true)) Serial.printf("*** RX duty cycling needs the radio sleep hooks\n");
+    #endif
 
-    sysTable = IOHC::iohcSystemTable::getInstance();
+    IOHC::iohcKeyCache::getInstance(); // Expand the transfer key once at boot
+    nodeIndex->forEach([](const IOHC::iohcNodeRecord& node)-> void {
+        if (node.flags & IOHC::iohcNodeRecord::hasKey) IOHC::iohcKeyCache::getInstance()->setSystemKey(node.node, node.key);
+    });
+    radioUpUs = esp_timer_get_time();
 
+    // Device tables parse their JSON config from LittleFS, the radio is already listening meanwhile
     remote1W = IOHC::iohcRemote1W::getInstance();
     cozyDevice2W = IOHC::iohcCozyDevice2W::getInstance();
     otherDevice2W = IOHC::iohcOtherDevice2W::getInstance();
-
-    //   AES_init_ctx(&ctx, transfert_key); // PreInit AES for cozy (1W use original version) TODO
-
-    Cmd::init(); // Initialize Serial commands reception and handlers
+    txScheduler->setGateway(cozyDevice2W->gateway); // Answers to us are not counted as busy channel
+    devicesUpUs = esp_timer_get_time();
+    rxPipeline->release();
+
+    // Serial commands run on the event loop task, woken by the UART receive callback
+    eventLoop = IOHC::iohcEventLoop::getInstance();
+    console = IOHC::iohcConsole::getInstance();
+    console->begin(eventLoop);
     // Cozybox Kizbox Conexoon 2W
-    Cmd::addHandler((char *)"powerOn", (char *)"Permit to retrieve paired devices", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::powerOn, nullptr);    });
-    Cmd::addHandler((char *)"setTemp", (char *)"7.0 to 28.0 - 0 get actual temp", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::setTemp, cmd /*cmd->at(1).c_str()*/);    });
-    Cmd::addHandler((char *)"setMode", (char *)"auto prog manual off - FF to get actual mode", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::setMode, cmd /*cmd->at(1).c_str()*/);    });
-    Cmd::addHandler((char *)"setPresence", (char *)"on off", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::setPresence, cmd /*cmd->at(1).c_str()*/);    });
-    Cmd::addHandler((char *)"setWindow", (char *)"open close", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::setWindow, cmd /*cmd->at(1).c_str()*/);    });
-    Cmd::addHandler((char *)"midnight", (char *)"Synchro Paired", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::midnight, nullptr);    });
-    Cmd::addHandler((char *)"associate", (char *)"Synchro Paired", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::associate, nullptr);    });
-    Cmd::addHandler((char *)"custom", (char *)"test unknown commands", [](Tokens* cmd)-> void {/*scanMode = true;*/       cozyDevice2W->cmd(IOHC::DeviceButton::custom, cmd /*cmd->at(1).c_str()*/);    });
-    Cmd::addHandler((char *)"custom60", (char *)"test 0x60 commands", [](Tokens* cmd)-> void {/*scanMode = true;*/ cozyDevice2W->cmd(IOHC::DeviceButton::custom60, cmd /*cmd->at(1).c_str()*/);    });
+    console->addHandler("powerOn", "Permit to retrieve paired devices", [](const IOHC::iohcArgs* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::powerOn, nullptr);    });
+    console->addHandler("setTemp", "7.0 to 28.0 - 0 get actual temp", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::setTemp, cmd /*cmd->at(1).c_str()*/);    });
+    console->addHandler("setMode", "auto prog manual off - FF to get actual mode", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::setMode, cmd /*cmd->at(1).c_str()*/);    });
+    console->addHandler("setPresence", "on off", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::setPresence, cmd /*cmd->at(1).c_str()*/);    });
+    console->addHandler("setWindow", "open close", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::setWindow, cmd /*cmd->at(1).c_str()*/);    });
+    console->addHandler("midnight", "Synchro Paired", [](const IOHC::iohcArgs* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::midnight, nullptr);    });
+    console->addHandler("associate", "Synchro Paired", [](const IOHC::iohcArgs* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::associate, nullptr);    });
+    console->addHandler("custom", "test unknown commands", [](Tokens* cmd)-> void {/*scanMode = true;*/       cozyDevice2W->cmd(IOHC::DeviceButton::custom, cmd /*cmd->at(1).c_str()*/);    });
+    console->addHandler("custom60", "test 0x60 commands", [](Tokens* cmd)-> void {/*scanMode = true;*/ cozyDevice2W->cmd(IOHC::DeviceButton::custom60, cmd /*cmd->at(1).c_str()*/);    });
     // 1W
-    Cmd::addHandler((char *)"pair", (char *)"1W put device in pair mode", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Pair);    });
-    Cmd::addHandler((char *)"add", (char *)"1W add controller to device", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Add);    });
-    Cmd::addHandler((char *)"remove", (char *)"1W remove controller from device", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Remove);    });
-    Cmd::addHandler((char *)"open", (char *)"1W open device", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Open);    });
-    Cmd::addHandler((char *)"close", (char *)"1W close device", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Close);    });
-    Cmd::addHandler((char *)"stop", (char *)"1W stop device", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Stop);    });
-    Cmd::addHandler((char *)"vent", (char *)"1W vent device", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Vent);    });
-    Cmd::addHandler((char *)"force", (char *)"1W force device open", [](Tokens* cmd)-> void {    remote1W->cmd(IOHC::RemoteButton::ForceOpen);    });
-    Cmd::addHandler((char *)"testKey", (char *)"Test keys generation", [](Tokens* cmd)-> void {    remote1W->cmd(IOHC::RemoteButton::testKey);    });
-
-        Cmd::addHandler((char *)"mode1", (char *)"1W Mode1", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Mode1);    });
-        Cmd::addHandler((char *)"mode2", (char *)"1W Mode2", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Mode2);    });
-        Cmd::addHandler((char *)"mode3", (char *)"1W Mode3", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Mode3);    });
-        Cmd::addHandler((char *)"mode4", (char *)"1W Mode4", [](Tokens* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Mode4);    });
+    console->addHandler("pair", "1W put device in pair mode", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Pair);    });
+    console->addHandler("add", "1W add controller to device", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Add);    });
+    console->addHandler("remove", "1W remove controller from device", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Remove);    });
+    console->addHandler("open", "1W open device", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Open);    });
+    console->addHandler("close", "1W close device", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Close);    });
+    console->addHandler("stop", "1W stop device", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Stop);    });
+    console->addHandler("vent", "1W vent device", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Vent);    });
+    console->addHandler("force", "1W force device open", [](const IOHC::iohcArgs* cmd)-> void {    remote1W->cmd(IOHC::RemoteButton::ForceOpen);    });
+    console->addHandler("testKey", "Test keys generation", [](const IOHC::iohcArgs* cmd)-> void {    remote1W->cmd(IOHC::RemoteButton::testKey);    });
+
+        console->addHandler("mode1", "1W Mode1", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Mode1);    });
+        console->addHandler("mode2", "1W Mode2", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Mode2);    });
+        console->addHandler("mode3", "1W Mode3", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Mode3);    });
+        console->addHandler("mode4", "1W Mode4", [](const IOHC::iohcArgs* cmd)-> void {        remote1W->cmd(IOHC::RemoteButton::Mode4);    });
     // Other 2W
-    Cmd::addHandler((char *)"discovery", (char *)"Send discovery on air", [](Tokens* cmd)-> void {    otherDevice2W->cmd(IOHC::Other2WButton::discovery, nullptr);    });
-    Cmd::addHandler((char *)"getName", (char *)"Name Of A Device", [](Tokens* cmd)-> void {    otherDevice2W->cmd(IOHC::Other2WButton::getName, cmd);    });
+    console->addHandler("discovery", "Send discovery on air", [](const IOHC::iohcArgs* cmd)-> void {    otherDevice2W->cmd(IOHC::Other2WButton::discovery, nullptr);    });
+    console->addHandler("getName", "Name Of A Device", [](Tokens* cmd)-> void {    otherDevice2W->cmd(IOHC::Other2WButton::getName, cmd);    });
     // Utils
-    Cmd::addHandler((char *)"dump", (char *)"Dump Transceiver registers", [](Tokens* cmd)-> void {
+    console->addHandler("dump", "Dump Transceiver registers", [](const IOHC::iohcArgs* cmd)-> void {
         Radio::dump();
-        Serial.printf("*%d packets in memory\t", nextPacket);
-        Serial.printf("*%d devices discovered\n\n", sysTable->size());
+        Serial.printf("*%u devices discovered\n\n", (unsigned) nodeIndex->size());
+        rxPipeline->dump();
+        radioSet->dump();
+        #if defined(IOHC_SI4461_NSEL)
+            IOHC::iohcSi4461::getInstance()->dump();
+        #endif
+        IOHC::iohcLog::getInstance()->dump();
+        eventLoop->dump();
+        console->dump();
+        IOHC::iohcPublisher::getInstance()->dump();
+        archive->dump();
+        nodeIndex->dump();
+        txScheduler->dump();
+        txQueue->dump();
+        sessions->dump();
+        snapshot->dump();
+        IOHC::iohcGroupCommand::getInstance()->dump();
+        Serial.printf("*Boot radio listening at %u ms, devices loaded at %u ms, first frame at %u ms\n",
+                      (unsigned) (radioUpUs / 1000), (unsigned) (devicesUpUs / 1000), (unsigned) (rxPipeline->firstRx() / 1000));
+        Serial.printf("*Outbound pool %d/%d (high water %d) %d exhausted\n", outboundPool.inUse(), outboundPool.capacity(),
+                      outboundPool.highWater(), outboundPool.failures());
     });
-    //    Cmd::addHandler((char *)"dump2", (char *)"Dump Transceiver registers 1Col", [](Tokens*cmd)->void {Radio::dump2(); Serial.printf("*%d packets in memory\t", nextPacket); Serial.printf("*%d devices discovered\n\n", sysTable->size());});
-    Cmd::addHandler((char *)"list1W", (char *)"List received packets", [](Tokens* cmd)-> void {
-        for (uint8_t i = 0; i < nextPacket; i++) msgRcvd(radioPackets[i]);
-        sysTable->dump1W();
+    //    console->addHandler("dump2", "Dump Transceiver registers 1Col", [](Tokens*cmd)->void {Radio::dump2(); Serial.printf("*%d packets in memory\t", nextPacket); Serial.printf("*%d devices discovered\n\n", sysTable->size());});
+    console->addHandler("list1W", "List received packets", [](const IOHC::iohcArgs* cmd)-> void {
+        archive->forEach(msgList1W);
+        listNodes();
+    }, IOHC::commandMode::background);
+    console->addHandler("save", "Saves Objects table", [](const IOHC::iohcArgs* cmd)-> void { nodeIndex->save(true); });
+    console->addHandler("nodes", "List indexed nodes", [](const IOHC::iohcArgs* cmd)-> void { listNodes(); });
+    console->addHandler("snapshot", "Boot snapshot as JSON - save to write it now", [](const IOHC::iohcArgs* cmd)-> void {
+        if (cmd->size() > 1 && cmd->at(1) == "save") snapshot->changed();
+        snapshot->exportJson();
+        snapshot->dump();
     });
-    Cmd::addHandler((char *)"save", (char *)"Saves Objects table", [](Tokens* cmd)-> void { sysTable->save(true); });
-    Cmd::addHandler((char *)"erase", (char *)"Erase received packets", [](Tokens* cmd)-> void {
-        for (uint8_t i = 0; i < nextPacket; i++) free(radioPackets[i]);
-        nextPacket = 0;
+    console->addHandler("erase", "Erase received packets", [](const IOHC::iohcArgs* cmd)-> void { archive->clear(); }, IOHC::commandMode::background);
+    console->addHandler("archive", "Toggle received packets archiving", [](const IOHC::iohcArgs* cmd)-> void {
+        archiveMode = !archiveMode;
+        if (!archiveMode) archive->flush();
+        Serial.printf("Archiving %s\n", archiveMode ? "on" : "off");
     });
-    Cmd::addHandler((char *)"send", (char *)"Send packet from cmd line", [](Tokens* cmd)-> void { txUserBuffer(cmd); });
-    Cmd::addHandler((char *)"verbose", (char *)"Toggle verbose output on packets list", [](Tokens* cmd)-> void { verbosity = !verbosity; });
-    Cmd::addHandler((char *)"ls", (char *)"List filesystem", [](Tokens* cmd)-> void { listFS(); });
-    Cmd::addHandler((char *)"cat", (char *)"Print file content", [](Tokens* cmd)-> void { cat(cmd->at(1).c_str()); });
-    Cmd::addHandler((char *)"rm", (char *)"Remove file", [](Tokens* cmd)-> void { rm(cmd->at(1).c_str()); });
-    Cmd::addHandler((char *)"list2W", (char *)"List received packets", [](Tokens* cmd)-> void {
-        for (uint8_t i = 0; i < nextPacket; i++) msgRcvd(radioPackets[i]);
-        sysTable->dump2W();
+    console->addHandler("send", "Send packet from cmd line", [](Tokens* cmd)-> void { txUserBuffer(cmd); });
+    console->addHandler("verbose", "Toggle verbose output on packets list", [](const IOHC::iohcArgs* cmd)-> void { verbosity = !verbosity; });
+    console->addHandler("trace", "Byte dumps as text, uart or file binary records (scripts/Iown-IoTraceDecoder.py)", [](const IOHC::iohcArgs* cmd)-> void {
+        if (cmd->size() < 2) {
+            IOHC::iohcLog::getInstance()->dump();
+            return;
+        }
+        if (cmd->at(1) == "uart") IOHC::iohcLog::getInstance()->setTraceMode(IOHC::traceMode::uart);
+        else if (cmd->at(1) == "file") IOHC::iohcLog::getInstance()->setTraceMode(IOHC::traceMode::file);
+        else IOHC::iohcLog::getInstance()->setTraceMode(IOHC::traceMode::text);
     });
+    console->addHandler("ls", "List filesystem", [](const IOHC::iohcArgs* cmd)-> void { listFS(); });
+    console->addHandler("cat", "Print file content", [](const IOHC::iohcArgs* cmd)-> void { cat(cmd->c_str(1)); }, IOHC::commandMode::background);
+    console->addHandler("rm", "Remove file", [](const IOHC::iohcArgs* cmd)-> void { rm(cmd->c_str(1)); });
+    console->addHandler("list2W", "List received packets", [](const IOHC::iohcArgs* cmd)-> void {
+        archive->forEach(msgList2W);
+        listNodes();
+    }, IOHC::commandMode::background);
     // Unnecessary just for test
-    Cmd::addHandler((char *)"discover28", (char *)"discover28", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::discover28, nullptr);    });
-    Cmd::addHandler((char *)"discover2A", (char *)"discover2A", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::discover2A, nullptr);    });
-    Cmd::addHandler((char *)"fake0", (char *)"fake0", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::fake0, nullptr);    });
-    Cmd::addHandler((char *)"ack", (char *)"ack33", [](Tokens* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::ack, nullptr);    });
-    Cmd::addHandler((char *)"pairMode", (char *)"pairMode", [](Tokens* cmd)-> void { pairMode = !pairMode; });
-
-    Cmd::addHandler((char *)"scanMode", (char *)"scanMode", [](Tokens* cmd)-> void {scanMode = true; cozyDevice2W->cmd(IOHC::DeviceButton::checkCmd, nullptr);});
-    Cmd::addHandler((char *)"scanDump", (char *)"Dump Scan Results", [](Tokens* cmd)-> void {scanMode = false;  cozyDevice2W->scanDump(); });
+    console->addHandler("discover28", "discover28", [](const IOHC::iohcArgs* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::discover28, nullptr);    });
+    console->addHandler("discover2A", "discover2A", [](const IOHC::iohcArgs* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::discover2A, nullptr);    });
+    console->addHandler("fake0", "fake0", [](const IOHC::iohcArgs* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::fake0, nullptr);    });
+    console->addHandler("ack", "ack33", [](const IOHC::iohcArgs* cmd)-> void {        cozyDevice2W->cmd(IOHC::DeviceButton::ack, nullptr);    });
+    console->addHandler("pairMode", "pairMode", [](const IOHC::iohcArgs* cmd)-> void { pairMode = !pairMode; });
+
+    console->addHandler("scanMode", "scanMode", [](const IOHC::iohcArgs* cmd)-> void {scanMode = true; cozyDevice2W->cmd(IOHC::DeviceButton::checkCmd, nullptr);}, IOHC::commandMode::background);
+    console->addHandler("scanDump", "Dump Scan Results", [](const IOHC::iohcArgs* cmd)-> void {scanMode = false;  cozyDevice2W->scanDump(); });
+    console->addHandler("scan", "Probe all commands of devices in parallel - addr1 [addr2 ...], none to resume", [](Tokens* cmd)-> void {
+        IOHC::iohcScanEngine* scanEngine = IOHC::iohcScanEngine::getInstance();
+        if (cmd->size() < 2) {
+            scanEngine->resume(CHANNEL2);
+            return;
+        }
+        uint8_t targets[IOHC_SCAN_TARGETS][3];
+        size_t count = 0;
+        for (size_t i = 1; i < cmd->size() && count < IOHC_SCAN_TARGETS; i++)
+            if (hexToBytes(cmd->at(i), targets[count], 3) == 3) count++;
+        if (!scanEngine->start(cozyDevice2W->gateway, targets, count, CHANNEL2))
+            Serial.printf("Give 1 to %d device addresses\n", IOHC_SCAN_TARGETS);
+    });
+    console->addHandler("scanStop", "Stop the scan, resumed later by scan", [](const IOHC::iohcArgs* cmd)-> void { IOHC::iohcScanEngine::getInstance()->stop(); });
+    console->addHandler("scanResults", "Dump parallel scan results", [](const IOHC::iohcArgs* cmd)-> void { IOHC::iohcScanEngine::getInstance()->dump(); });
+    console->addHandler("group", "Send a 2W command to many devices - cmd params|- addr1 [addr2 ...]", [](Tokens* cmd)-> void {
+        if (cmd->size() < 4) {
+            Serial.printf("group <cmd> <params or -> <addr1> [addr2 ...]\n");
+            return;
+        }
+        uint8_t command;
+        uint8_t data[IOHC_GROUP_MAX_DATA];
+        size_t len = 0;
+        if (hexToBytes(cmd->at(1), &command, 1) != 1) {
+            Serial.printf("Command is one hex byte\n");
+            return;
+        }
+        if (cmd->at(2) != "-" && !(len = hexToBytes(cmd->at(2), data, sizeof(data)))) {
+            Serial.printf("Parameters are 1 to %u hex bytes\n", (unsigned) sizeof(data));
+            return;
+        }
+        uint8_t targets[IOHC_GROUP_TARGETS][3];
+        size_t count = 0;
+        for (size_t i = 3; i < cmd->size() && count < IOHC_GROUP_TARGETS; i++)
+            if (hexToBytes(cmd->at(i), targets[count], 3) == 3) count++;
+        if (!IOHC::iohcGroupCommand::getInstance()->start(cozyDevice2W->gateway, targets, count, command, data, len, CHANNEL2,
+                [](const IOHC::iohcGroupTarget& t) {
+                    Serial.printf("Group %02X%02X%02X %s %02X\n", t.address[0], t.address[1], t.address[2],
+                                  IOHC::groupResultName(t.result), t.answer);
+                }))
+            Serial.printf("Group busy or not 1 to %d device addresses\n", IOHC_GROUP_TARGETS);
+    });
+    console->addHandler("groupStop", "Stop the group command, pending devices fail", [](const IOHC::iohcArgs* cmd)-> void { IOHC::iohcGroupCommand::getInstance()->stop(); });
+    console->addHandler("groupStatus", "Per device results of the group command", [](const IOHC::iohcArgs* cmd)-> void { IOHC::iohcGroupCommand::getInstance()->dump(); });
+    console->addHandler("duty", "RX duty cycling on off", [](const IOHC::iohcArgs* cmd)-> void {
+        bool on = cmd->size() > 1 && cmd->at(1) == "on";
+        if (!dutyCycle->enable(on)) Serial.printf("RX duty cycling needs the radio sleep hooks and a long enough preamble\n");
+        dutyCycle->dump();
+    });
+    console->addHandler("tasks", "Tasks placement and stack use", [](const IOHC::iohcArgs* cmd)-> void { IOHC::dumpTasks(); });
+    console->addHandler("stats", "Frames per command and hot path latencies - reset to clear", [](const IOHC::iohcArgs* cmd)-> void {
+        IOHC::iohcStats::getInstance()->dump();
+        dutyCycle->dump();
+        if (cmd->size() > 1 && cmd->at(1) == "reset") IOHC::iohcStats::getInstance()->reset();
+    });
+    console->addHandler("crcBench", "Benchmark frame CRC implementations", [](const IOHC::iohcArgs* cmd)-> void { IOHC::crcBench(); }, IOHC::commandMode::background);
+    console->addHandler("cryptoBench", "Benchmark crypto helpers and check test vectors", [](const IOHC::iohcArgs* cmd)-> void { IOHC::cryptoBench(); }, IOHC::commandMode::background);
 
     esp_timer_dump(stdout);
 
-    printf("Startup completed. type help to see what you can do!\n");
+    #if defined(CONFIG_PM_ENABLE)
+        // Nothing polls anymore: the CPU scales down between events. Light sleep also needs the radio DIO
+        // as GPIO wakeup source, enable it with IOHC_LIGHT_SLEEP once the board is wired for it.
+        esp_pm_config_t pm = {};
+        pm.max_freq_mhz = 240;
+        pm.min_freq_mhz = 80;
+        pm.light_sleep_enable = IOHC_LIGHT_SLEEP;
+        esp_pm_configure(&pm);
+    #endif
+    eventLoop->start();
+    eventLoop->post(IOHC::loopEvent::console); // Input typed during boot
+
+    printf("Startup completed in %u ms: radio listening at %u ms, devices loaded at %u ms, snapshot %s in %u us\n",
+           (unsigned) (esp_timer_get_time() / 1000), (unsigned) (radioUpUs / 1000), (unsigned) (devicesUpUs / 1000),
+           snapshot->loaded() ? "loaded" : "missing", (unsigned) snapshot->loadUs());
+    printf("Type help to see what you can do!\n");
     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
     //Serial.println("SPI Speed:" + String(SPI.))
 }
 
-bool IRAM_ATTR msgRcvd(IOHC::iohcPacket* iohc) {
-    // iohc->decode(verbosity);
-
-    DynamicJsonDocument doc(1280);
-    doc["type"] = "Unk";
-    switch (iohc->payload.packet.header.cmd) {
-        case IOHC::iohcDevice::RECEIVED_DISCOVER_0x28: {
-            printf("Pairing Asked\n");
-            if (!pairMode) break;
-
-            packets2send.clear();
-            digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-            std::vector<uint8_t> toSend = {0xff, 0xc0, 0xba, 0x11, 0xad, 0x0b, 0xcc, 0x00, 0x00}; // 0x0b OverKiz 0x0c Atlantic
-
-            //Easy way to copy array to struct
-            //_p0x2b _p_0x29;
-            //std::copy(toSend.begin(), toSend.begin() + sizeof(_p_0x29), reinterpret_cast<uint8_t*>(&_p_0x29));
-
-            packets2send.push_back(new IOHC::iohcPacket);
-            packets2send.back()->payload.packet.header.CtrlByte1.asByte = 8;
-            // Header len if protocol version is 8 else 10 ;)
-            packets2send.back()->payload.packet.header.CtrlByte2.asByte = 0;
-            packets2send.back()->payload.packet.header.CtrlByte1.asByte += toSend.size();
-            packets2send.back()->payload.packet.header.cmd = IOHC::iohcDevice::SEND_DISCOVER_ANSWER_0x29;
-            /* Swap */
-            memcpy(packets2send.back()->payload.packet.header.source, cozyDevice2W->gateway, 3);
-            memcpy(packets2send.back()->payload.packet.header.target, iohc->payload.packet.header.source, 3);
-
-            memcpy(packets2send.back()->payload.buffer + 9, toSend.data(), toSend.size());
-
-            // packets2send[i]->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-            // packets2send[i]->payload.packet.header.CtrlByte1.asStruct.EndFrame = 1;
-
-            packets2send.back()->buffer_length = toSend.size() + 9; //packet2send[0]->payload.packet.header.framelength +1;
-            packets2send.back()->frequency = CHANNEL2;
-            packets2send.back()->repeatTime = 25;
-            packets2send.back()->delayed = 250;
-            IOHC::packetStamp = esp_timer_get_time(); //
-            packets2send.back()->repeat = 0; // Need to stop txMode
-            packets2send.back()->lock = false; //true; // Need to received ASAP
-
-            radioInstance->send(packets2send);
-            digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-        break;
-        }
-        case IOHC::iohcDevice::RECEIVED_DISCOVER_ACTUATOR_0x2C: {
-            printf("Actuator Ack Asked\n");
-            if (!pairMode) break;
-            
-            packets2send.clear();
-            digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-            std::vector<uint8_t> toSend = {};
-
-            packets2send.push_back(new IOHC::iohcPacket);
-            packets2send.back()->payload.packet.header.CtrlByte1.asByte = 8;
-            // Header len if protocol version is 8 else 10 ;)
-            packets2send.back()->payload.packet.header.CtrlByte2.asByte = 0;
-            packets2send.back()->payload.packet.header.CtrlByte1.asByte += toSend.size();
-            packets2send.back()->payload.packet.header.cmd = IOHC::iohcDevice::SEND_DISCOVER_ACTUATOR_ACK_0x2D;
-            /* Swap */
-            memcpy(packets2send.back()->payload.packet.header.source, iohc->payload.packet.header.target, 3);
-            memcpy(packets2send.back()->payload.packet.header.target, iohc->payload.packet.header.source, 3);
-
-            memcpy(packets2send.back()->payload.buffer + 9, toSend.data(), toSend.size());
-
-            // packets2send[0]->payload.packet.header.CtrlByte1.asStruct.StartFrame = 0;
-            // packets2send[0]->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-
-            packets2send.back()->buffer_length = toSend.size() + 9; 
-            packets2send.back()->frequency = CHANNEL2;
-            packets2send.back()->repeatTime = 25;
-            packets2send.back()->delayed = 250;
-            IOHC::packetStamp = esp_timer_get_time(); //
-            packets2send.back()->repeat = 0; // Need to stop txMode
-            packets2send.back()->lock = false; //true; // Need to received ASAP
-
-            radioInstance->send(packets2send);
-            digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-        break;
-        }
-        case IOHC::iohcDevice::SEND_LAUNCH_KEY_TRANSFERT_0x38: {
-            printf("Key Transfert Asked after Command %2.2X\n", iohc->payload.packet.header.cmd);
-            if (!pairMode) break;
-            
-            packets2send.clear();
-            digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-            std::vector<uint8_t> key_transfert;
-            key_transfert.assign(iohc->payload.buffer + 9, iohc->payload.buffer + 15);
-
-            for (unsigned char i: key_transfert) {
-                printf("%02X ", i);
-            }
-            printf("\n");
-            std::vector<uint8_t> data = {IOHC::iohcDevice::SEND_ASK_CHALLENGE_0x31}; //0x38
-            unsigned char initial_value[16];
-            constructInitialValue(data, initial_value, data.size(), key_transfert, nullptr);
-            Serial.printf("2) Initial value used for key encryption: ");
-            for (unsigned char i: initial_value) {
-                printf("%02X ", i);
-            }
-            printf("\n");
-
-            AES_init_ctx(&ctx, transfert_key);
-            uint8_t encrypted_key[16];
-            AES_ECB_encrypt(&ctx, initial_value);
-            // Appliquer le XOR avec la clé du système
-            for (int i = 0; i < 16; i++) {
-                encrypted_key[i] = initial_value[i] ^ transfert_key[i];
-            }
-            printf("2) Encrypted 2-way key to be sent with 0x32: ");
-            for (unsigned char i: encrypted_key) {
-                printf("%02X ", i);
-            }
-            printf("\n");
-            std::vector<uint8_t> toSend;
-            toSend.assign(encrypted_key, encrypted_key + 16);
-
-            packets2send.push_back(new IOHC::iohcPacket);
-            packets2send.back()->payload.packet.header.CtrlByte1.asByte = 8;
-            // Header len if protocol version is 8 else 10 ;)
-            packets2send.back()->payload.packet.header.CtrlByte2.asByte = 0;
-            packets2send.back()->payload.packet.header.CtrlByte1.asByte += toSend.size();
-            packets2send.back()->payload.packet.header.cmd = IOHC::iohcDevice::SEND_KEY_TRANSFERT_0x32;
-            cozyDevice2W->memorizeSend.memorizedCmd = IOHC::iohcDevice::SEND_KEY_TRANSFERT_0x32;
-
-            /* Swap */
-            memcpy(packets2send.back()->payload.packet.header.source, iohc->payload.packet.header.target, 3);
-            memcpy(packets2send.back()->payload.packet.header.target, iohc->payload.packet.header.source, 3);
-
-            memcpy(packets2send.back()->payload.buffer + 9, toSend.data(), toSend.size());
-
-            // packets2send[0]->payload.packet.header.CtrlByte1.asStruct.StartFrame = 0;
-            // packets2send[0]->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-
-            packets2send.back()->buffer_length = toSend.size() + 9; 
-            packets2send.back()->frequency = CHANNEL2;
-            packets2send.back()->repeatTime = 25;
-            IOHC::packetStamp = esp_timer_get_time(); //
-            packets2send.back()->repeat = 0; // Need to stop txMode
-            packets2send.back()->lock = false; //true; // Need to received ASAP
-
-            radioInstance->send(packets2send);
-            digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-        break;
-        }
-        case 0x20:
-            cozyDevice2W->memorizeSend.memorizedCmd = iohc->payload.packet.header.cmd;
-            IOHC::lastSendCmd = iohc->payload.packet.header.cmd;
-            break;
-        case 0x21: {
-            // Answer of 0x20, publish the confirmed command
-            // doc["type"] = "Cozy";
-            // doc["from"] = bytesToHexString(iohc->payload.packet.header.target, 3);
-            // doc["to"] = bytesToHexString(iohc->payload.packet.header.source, 3);
-            // doc["cmd"] = to_hex_str(iohc->payload.packet.header.cmd).c_str();
-            // doc["_data"] = bytesToHexString(iohc->payload.buffer + 9, iohc->buffer_length - 9);
-            // std::string message;
-            // size_t messageSize = serializeJson(doc, message);
-            // mqttClient.publish("iown/Frame", 0, false, message.c_str(), messageSize);
-            break;
-        }
-        case 0x3C: {
-            // Answer only to our gateway, not to others devices
-            if (cozyDevice2W->isFake(iohc->payload.packet.header.source, iohc->payload.packet.header.target)) { // (true) { //
-                packets2send_tmp.clear();
-               
-                digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-
-                doc["type"] = "Gateway";
-                if (!cozyDevice2W->isFake(iohc->payload.packet.header.source, iohc->payload.packet.header.target)) {
-                    //                        AES_init_ctx(&ctx, setgo); // PreInit AES for other2W (1W use original version) TODO
-                }
-                //                    else
-                AES_init_ctx(&ctx, transfert_key);
-
-                // IVdata is the challenge with commandId put on start
-                std::vector<uint8_t> challengeAsked;
-                //                    challengeAsked.assign(iohc->payload.packet.msg.variableData.data, iohc->payload.packet.msg.variableData.data + iohc->payload.packet.msg.variableData.size);
-                challengeAsked.assign(iohc->payload.buffer + 9, iohc->payload.buffer + 15);
-                printf("Challenge asked after LastSend Command %2.2X\n", IOHC::lastSendCmd);
-                printf("Challenge asked after Memorized Command %2.2X\n", cozyDevice2W->memorizeSend.memorizedCmd);
-               
-if(scanMode) {cozyDevice2W->mapValid[IOHC::lastSendCmd] = 0x3C; break;}
-
-                std::vector<uint8_t> IVdata = cozyDevice2W->memorizeSend.memorizedData;
-                IVdata.insert(IVdata.begin(), cozyDevice2W->memorizeSend.memorizedCmd);
-                
-                packets2send_tmp.push_back(new IOHC::iohcPacket);
- 
-                packets2send_tmp.back()->payload.packet.header.cmd = IOHC::iohcDevice::SEND_CHALLENGE_ANSWER_0x3D;
-
-                unsigned char initial_value[16];
-                constructInitialValue(IVdata, initial_value, IVdata.size(), challengeAsked, nullptr);
-                AES_ECB_encrypt(&ctx, initial_value);
-                uint8_t dataLen = 6;
-
-                if (cozyDevice2W->memorizeSend.memorizedCmd == IOHC::iohcDevice::RECEIVED_ASK_CHALLENGE_0x31) {
-                    packets2send_tmp.back()->payload.packet.header.cmd = IOHC::iohcDevice::SEND_KEY_TRANSFERT_0x32;
-                    dataLen = 16;
-                    IVdata = {0x31};
-                    constructInitialValue(IVdata, initial_value, 1, challengeAsked, nullptr);
-                    AES_ECB_encrypt(&ctx, initial_value);
-                    for (int i = 0; i < dataLen; i++)
-                        initial_value[i] = initial_value[i] ^ transfert_key[i];
-                    cozyDevice2W->memorizeSend.memorizedCmd = IOHC::iohcDevice::SEND_KEY_TRANSFERT_0x32;
-                    cozyDevice2W->memorizeSend.memorizedData.assign(initial_value, initial_value + 16);
-                }
-
-                packets2send_tmp.back()->payload.packet.header.CtrlByte1.asByte = 8;
-                // Header len if protocol version is 8 else 10 ;)
-                packets2send_tmp.back()->payload.packet.header.CtrlByte2.asByte = 0;
-                packets2send_tmp.back()->payload.packet.header.CtrlByte1.asByte += dataLen;
-                /* Swap */
-                memcpy(packets2send_tmp.back()->payload.packet.header.source, iohc->payload.packet.header.target, 3);
-                memcpy(packets2send_tmp.back()->payload.packet.header.target, iohc->payload.packet.header.source, 3);
-
-                memcpy(packets2send_tmp.back()->payload.buffer + 9, initial_value, dataLen);
-
-                packets2send_tmp.back()->buffer_length = dataLen/*challengeAsked.size()*/ + 9;
-                
-                packets2send_tmp.back()->frequency = CHANNEL2;
-                packets2send_tmp.back()->repeatTime = 6;
-                IOHC::packetStamp = esp_timer_get_time(); //
-                packets2send_tmp.back()->repeat = 1; // Need to stop txMode
-                packets2send_tmp.back()->lock = false; //true; // Need to received ASAP
-                
-                radioInstance->send(packets2send_tmp);
-
-                // Serial.print("IV used for key encryption: ");
-                // for (int i = 0; i < 16; i++)
-                //     Serial.printf("%02X ", initial_value[i]);
-                // Serial.println();
-                printf("Key to be sent with %2.2X: ", packets2send_tmp[0]->payload.packet.header.cmd);
-                for (int i = 0; i < dataLen; i++)
-                    printf("%02X ", initial_value[i]);
-                printf("\n");
-
-                //                sysTable->addObject(iohc);
-                digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-            }
-        break;
-        }
-        case 0X00:
-        case 0x01:
-        case 0x03:
-        case 0x19: {
-            //                memorizeSend.memorizedData = toSend;
-            doc["type"] = "Other";
-            otherDevice2W->memorizeOther2W.memorizedCmd = iohc->payload.packet.header.cmd;
-            cozyDevice2W->memorizeSend.memorizedCmd = iohc->payload.packet.header.cmd;
-            break;
-        }
-        case 0x51: {
-            std::vector<uint8_t> nameReceived;
-            nameReceived.assign(iohc->payload.buffer + 9, iohc->payload.buffer + 25);
-//            std::string asciiName;
-
-for (char byte : nameReceived) {
-//    asciiName += std::toupper(byte);
-    printf("%c", std::toupper(byte));
+bool IRAM_ATTR rxEnqueue(IOHC::iohcPacket* iohc) {
+    return rxPipeline->enqueue(iohc, 0);
 }
-//            printf("%s\n", asciiName.c_str());
-            printf("\n");
-            break;
-        }
-        case 0x04:
-        case 0x0D:
-        case 0x2D:
-        case 0x4B:
-        case 0x55:
-        case 0x57:
-        case 0x59:            
-            if (scanMode) { 
-                otherDevice2W->memorizeOther2W = {};
-                    // printf(" Answer %X Cmd %X ", iohc->payload.packet.header.cmd, IOHC::lastSendCmd);
-                    cozyDevice2W->mapValid[IOHC::lastSendCmd] = iohc->payload.packet.header.cmd; 
-            }
-            break;
-        case 0xFE: {
-            if (scanMode) { 
-                otherDevice2W->memorizeOther2W = {};
-                    // printf(" Unknown %X Cmd %X ", iohc->payload.buffer[9], IOHC::lastSendCmd);
-                    cozyDevice2W->mapValid[IOHC::lastSendCmd] = iohc->payload.buffer[9]; 
-            }
-            break;
-        }
-         case 0x29: {
-            printf("A Device want to be paired\n");
-            if (!pairMode) break;
-
-            std::vector<uint8_t> deviceAsked;
-            deviceAsked.assign(iohc->payload.buffer + 9, iohc->payload.buffer + 18);
-            for (unsigned char i: deviceAsked) {
-                printf("%02X ", i);
-            }
-            printf("\n");
-
-            // printf("Sending 0x38 \n");
-            printf("Sending 0x2C \n");
-            digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-            // std::vector<uint8_t> toSend = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06}; // 38
-            std::vector<uint8_t> toSend = {}; // 2C
-
-            packets2send.clear();
-            packets2send.push_back(new IOHC::iohcPacket);
-
-            // init(packets2send[0]);
-            // packets2send.back()->payload.packet.header.cmd = 0x38;
-            packets2send.back()->payload.packet.header.cmd = 0x2C;
-            // cozyDevice2W->memorizeSend.memorizedData = toSend;
-            // cozyDevice2W->memorizeSend.memorizedCmd = 0x2C;
-
-            packets2send.back()->payload.packet.header.CtrlByte1.asStruct.StartFrame = 1;
-            packets2send.back()->payload.packet.header.CtrlByte1.asStruct.EndFrame = 0;
-            packets2send.back()->payload.packet.header.CtrlByte1.asByte += toSend.size();
-
-            /* Swap */
-            memcpy(packets2send.back()->payload.packet.header.source, iohc->payload.packet.header.target, 3);
-            memcpy(packets2send.back()->payload.packet.header.target, iohc->payload.packet.header.source, 3);
-
-            memcpy(packets2send.back()->payload.buffer + 9, toSend.data(), toSend.size());
-
-            packets2send.back()->buffer_length = toSend.size() + 9;
-            packets2send.back()->frequency = CHANNEL2;
-            packets2send.back()->repeatTime = 25;
-            IOHC::packetStamp = esp_timer_get_time(); //
-            packets2send.back()->repeat = 1; // Need to stop txMode
-            packets2send.back()->lock = false; //true; // Need to received ASAP
-
-            radioInstance->send(packets2send);
-            digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-        break;
-        }
 
-        case 0x2B: {
-            sysTable->addObject(iohc->payload.packet.header.source, iohc->payload.packet.msg.p0x2b.backbone,
-                                iohc->payload.packet.msg.p0x2b.actuator, iohc->payload.packet.msg.p0x2b.manufacturer,
-                                iohc->payload.packet.msg.p0x2b.info);
-            break;
-        }
- 
-        case 0x30: {
-            for (uint8_t idx = 0; idx < 16; idx++)
-                keyCap[idx] = iohc->payload.packet.msg.p0x30.enc_key[idx];
-
-            iohcCrypto::encrypt_1W_key((const uint8_t *)iohc->payload.packet.header.source, (uint8_t *)keyCap);
-            printf("CLEAR KEY: ");
-            for (unsigned char idx: keyCap)
-                printf("%2.2X", idx);
-            printf("\n");
-            break;
-        }
-        case 0X2E:
-            printf("1W Learning mode\n");
-            break;
-            
-        case 0x39: {
-            if (keyCap[0] == 0) break;
-            uint8_t hmac[16];
-            std::vector<uint8_t> frame(&iohc->payload.packet.header.cmd, &iohc->payload.packet.header.cmd + 2); // frame = {0x39, 0x00}; // 
-            iohcCrypto::create_1W_hmac(hmac, iohc->payload.packet.msg.p0x39.sequence, keyCap, frame);
-            printf("MAC: ");
-            for (uint8_t idx = 0; idx < 6; idx++)
-                printf("%2.2X", hmac[idx]);
-            printf("\n");
-        break;
-        }
-        case 0x48:
-        case 0x49:
-        case 0x4A:
-        case 0X3D:
-        case 0X05: break;
-        default:
-            printf("Received Unknown command %02X ", iohc->payload.packet.header.cmd);
-            return false;
-            break;
+// Runs on the dispatch task for every frame coming from the radio
+bool rxDispatch(IOHC::iohcPacket* iohc) {
+    #if defined(MQTT)
+        publishMsg(iohc);
+    #endif
+    if (archiveMode) msgArchive(iohc);
+    txScheduler->noteReceived(iohc);
+    sessions->received(iohc);
+    IOHC::iohcScanEngine::getInstance()->received(iohc);
+    IOHC::iohcGroupCommand::getInstance()->received(iohc);
+    dutyCycle->received(iohc);
+
+    static bool firstFrame = true;
+    if (firstFrame) {
+        firstFrame = false;
+        IOHC_LOGI("First frame %u ms after boot\n", (unsigned) (rxPipeline->firstRx() / 1000));
     }
 
-    return true;
+    IOHC::iohcStats* stats = IOHC::iohcStats::getInstance();
+    stats->frame(iohc->payload.packet.header.cmd);
+    const int64_t start = esp_timer_get_time();
+    stats->dispatching(start); // 2W answers submitted by the handler are timed from here
+    bool handled = msgRcvd(iohc);
+    stats->since(IOHC::statMetric::dispatch, start);
+    stats->dispatching(0);
+    return handled;
+}
+
+bool msgRcvd(IOHC::iohcPacket* iohc) {
+    // iohc->decode(verbosity);
+    return dispatcher->dispatch(iohc);
 }
 
 
 /*TODO Merge with decode here (radio.cpp line 168)*/
 bool publishMsg(IOHC::iohcPacket* iohc) {
     //                if(iohc->payload.packet.header.cmd == 0x20 || iohc->payload.packet.header.cmd == 0x00) {
-    DynamicJsonDocument doc(512);
-    doc["type"] = "Cozy";
-    doc["from"] = bytesToHexString(iohc->payload.packet.header.target, 3);
-    doc["to"] = bytesToHexString(iohc->payload.packet.header.source, 3);
-    doc["cmd"] = to_hex_str(iohc->payload.packet.header.cmd).c_str();
-    doc["_data"] = bytesToHexString(iohc->payload.buffer + 9, iohc->buffer_length - 9);
-    std::string message;
-    size_t messageSize = serializeJson(doc, message);
+    // Queued for the publisher task, which coalesces repeats and batches frames per message
+    return IOHC::iohcPublisher::getInstance()->offer(iohc);
+    // }
+}
+
+bool mqttPublish(const char* topic, const char* payload, size_t len) {
     #if defined(MQTT)
-        mqttClient.publish("iown/Frame", 1, false, message.c_str(), messageSize);
+        return mqttClient.publish(topic, 1, false, payload, len) != 0;
+    #else
+        return true;
     #endif
-    // }
-    return false;
 }
 
 bool msgArchive(IOHC::iohcPacket* iohc) {
-    radioPackets[nextPacket] = new IOHC::iohcPacket; //(IOHC::iohcPacket *)malloc(sizeof(IOHC::iohcPacket));
-    if (!radioPackets[nextPacket]) {
-        Serial.printf("*** Malloc failed!\n");
+    // Frames from the radio are archived from their RX record, stamp and radio included
+    const IOHC::iohcRxRecord* record = rxPipeline->current();
+    if (!(record ? archive->append(*record) : archive->append(iohc))) {
+        IOHC_LOGE("*** Archive busy, packet dropped\n");
         return false;
     }
+    return true;
+}
 
-    radioPackets[nextPacket]->buffer_length = iohc->buffer_length;
-    radioPackets[nextPacket]->frequency = iohc->frequency;
-    //    radioPackets[nextPacket]->stamp = iohc->stamp;
-    radioPackets[nextPacket]->rssi = iohc->rssi;
+// Archived frames are only printed: the handlers run on the dispatch task and own packets2send
+void msgList(const IOHC::iohcArchiveRecord& record) {
+    const IOHC::iohcFrameView frame = record.view();
+    if (!frame.valid()) return;
+    const uint8_t* from = frame.source();
+    const uint8_t* to = frame.target();
+    Serial.printf("%10u ms %u %4d dBm %s %02X%02X%02X > %02X%02X%02X %02X ", (unsigned) (record.stamp / 1000),
+                  (unsigned) record.frequency, record.rssi, frame.oneWay() ? "1W" : "2W", from[0], from[1], from[2],
+                  to[0], to[1], to[2], frame.cmd());
+    for (uint8_t b : frame.params()) Serial.printf("%02X", b);
+    Serial.printf("\n");
+}
 
-    for (uint8_t i = 0; i < iohc->buffer_length; i++)
-        radioPackets[nextPacket]->payload.buffer[i] = iohc->payload.buffer[i];
+void msgList1W(const IOHC::iohcArchiveRecord& record) {
+    if (record.view().oneWay()) msgList(record);
+}
 
-    nextPacket += 1;
-    Serial.printf("-> %d\r", nextPacket);
-    if (nextPacket >= IOHC_INBOUND_MAX_PACKETS) {
-        nextPacket = IOHC_INBOUND_MAX_PACKETS - 1;
-        Serial.printf("*** Not enough buffers available. Please erase current ones\n");
-        return false;
-    }
+void msgList2W(const IOHC::iohcArchiveRecord& record) {
+    if (!record.view().oneWay()) msgList(record);
+}
 
-    return true;
+// hexStringToBytes writes as many bytes as the string holds, 0 when they would not fit in max
+size_t hexToBytes(const std::string& hex, uint8_t* out, size_t max) {
+    if (hex.empty() || hex.size() > 2 * max) return 0;
+    return hexStringToBytes(hex, out);
+}
+
+// The node index is the device table, discovered and paired nodes
+void listNodes() {
+    nodeIndex->forEach([](const IOHC::iohcNodeRecord& node)-> void {
+        Serial.printf("%02X%02X%02X backbone %02X%02X%02X actuator %02X%02X manufacturer %02X info %02X %s %.16s\n",
+                      node.node[0], node.node[1], node.node[2], node.backbone[0], node.backbone[1], node.backbone[2],
+                      node.actuator[0], node.actuator[1], node.manufacturer, node.info,
+                      node.flags & IOHC::iohcNodeRecord::hasKey ? "key" : "-", node.name);
+    });
 }
 
 void txUserBuffer(Tokens* cmd) {
@@ -751,31 +666,41 @@ void txUserBuffer(Tokens* cmd) {
         Serial.printf("No packet to be sent!\n");
         return;
     }
+    // Console task: packets2send belongs to the handlers on the dispatch task, the TX queue copies this frame
+    IOHC::iohcPacket frame;
+    frame.buffer_length = hexToBytes(cmd->at(1), frame.payload.buffer, sizeof(frame.payload.buffer));
+    if (!frame.buffer_length) {
+        Serial.printf("Packet is 1 to %u hex bytes\n", (unsigned) sizeof(frame.payload.buffer));
+        return;
+    }
     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-    if (!packets2send[0])
-        packets2send[0] = new IOHC::iohcPacket;
-
-    if (cmd->size() == 3)
-        packets2send[0]->frequency = frequencies[atoi(cmd->at(2).c_str()) - 1];
-    else
-        packets2send[0]->frequency = 0;
-
-    packets2send[0]->buffer_length = hexStringToBytes(cmd->at(1), packets2send[0]->payload.buffer);
-    packets2send[0]->repeatTime = 35;
-    packets2send[0]->repeat = 1;
-    packets2send[1] = nullptr;
-
-    radioInstance->send(packets2send);
+    frame.repeatTime = 35;
+    frame.repeat = 1;
+    frame.delayed = 0;
+    frame.lock = false;
+    // Without an explicit channel the frame goes out on the least busy one: a 1W frame hops at send time, a 2W
+    // frame is placed now so the session below resends it on the same channel
+    const bool oneWay = frame.payload.buffer[0] & 0x20;
+    const bool explicitChannel = cmd->size() == 3;
+    const bool agile = oneWay && !explicitChannel;
+    if (explicitChannel) frame.frequency = frequencies[atoi(cmd->at(2).c_str()) - 1];
+    else frame.frequency = agile ? CHANNEL2 : txScheduler->leastBusy();
+    // 2W only: keeps the context for a challenge of the target, resent while the target stays silent
+    if (!oneWay && frame.buffer_length >= 9)
+        sessions->open(frame.payload.packet.header.target, frame.payload.packet.header.cmd, frame.payload.buffer + 9,
+                       frame.buffer_length - 9, &frame);
+
+    std::vector<IOHC::iohcPacket*> frames{&frame};
+    if (!txQueue->submit(frames, IOHC::txClass::interactive, 0, agile)) Serial.printf("*** TX queue full, packet dropped\n");
     digitalWrite(RX_LED, digitalRead(RX_LED) ^ 1);
-
-    // Do not deallocate buffers as send is asynchronous
-    //        free(packets2send[0]);
-    //        packets2send[0] = nullptr;
 }
 void loop() {
     //    wm.process();
 #if defined(ESP8266)
         MDNS.update();
+#else
+    // Everything runs on the gateway tasks, the Arduino loop task would only spin
+    vTaskDelete(nullptr);
 #endif
 
     //    return;